@@ -0,0 +1,88 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Exponential backoff with full jitter for the reconnections.
+ */
+
+#include "Backoff.h"
+#include "Config.h"
+#include "Hal.h"
+
+/*------------------------------------------------------------------------------
+ */
+Backoff::Backoff(const uint32_t inBase, const uint32_t inCap,
+                 const uint32_t inBudget)
+    : mBase(inBase), mCap(inCap), mBudget(inBudget), mRandom(1ul),
+      mAttemptCount(0ul), mSeriesDate(0ul), mAttemptDate(0ul), mDelay(0ul),
+      mConnectedDate(0ul), mConnected(false), mLossDated(false),
+      mTotalCount(0ul) {}
+
+/*------------------------------------------------------------------------------
+ * xorshift32, enough to spread the attempts. Its state must not be 0.
+ */
+void Backoff::seed(const uint32_t inSeed) {
+  mRandom = inSeed != 0 ? inSeed : 1ul;
+}
+
+uint32_t Backoff::random() {
+  mRandom ^= mRandom << 13;
+  mRandom ^= mRandom >> 17;
+  mRandom ^= mRandom << 5;
+  return mRandom;
+}
+
+/*------------------------------------------------------------------------------
+ * The first call after a success sees the loss of the connection, the delay
+ * drawn by succeeded() starts then.
+ */
+bool Backoff::isDue() {
+  const uint32_t currentDate = Hal::millis();
+  if (mConnected && !mLossDated) {
+    mLossDated = true;
+    mAttemptDate = currentDate;
+  }
+  return currentDate - mAttemptDate >= mDelay;
+}
+
+/*------------------------------------------------------------------------------
+ * Starts a new series if the connection was stable, draws the delay before
+ * the next attempt and checks the budget.
+ */
+void Backoff::attempted() {
+  const uint32_t currentDate = Hal::millis();
+  if (mConnected) {
+    mConnected = false;
+    if (currentDate - mConnectedDate >= kBackoffStableTime) {
+      mAttemptCount = 0;
+    }
+  }
+  if (mAttemptCount == 0) {
+    mSeriesDate = currentDate;
+  }
+
+  uint32_t ceiling = mCap;
+  if (mAttemptCount < 32 && mBase <= (mCap >> mAttemptCount)) {
+    ceiling = mBase << mAttemptCount;
+  }
+  mDelay = random() % (ceiling + 1);
+  mAttemptDate = currentDate;
+  mAttemptCount++;
+  mTotalCount++;
+
+  if (currentDate - mSeriesDate > mBudget) {
+    Hal::restart();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Draws the delay of the first attempt after a loss of the connection in
+ * [0, base].
+ */
+void Backoff::succeeded() {
+  if (!mConnected) {
+    mConnected = true;
+    mConnectedDate = Hal::millis();
+  }
+  mLossDated = false;
+  mDelay = random() % (mBase + 1);
+}
@@ -0,0 +1,55 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Exponential backoff with full jitter for the reconnections.
+ *
+ * After the n-th consecutive attempt, the next one is allowed after a random
+ * delay in [0, min(cap, base * 2^n)]. The random generator is seeded per
+ * node (MAC address) so that the heaters restarted together by an outage of
+ * the broker spread their attempts instead of retrying in lockstep.
+ *
+ * The first retry after a loss of the connection is drawn in [0, base] from
+ * the moment the loss is seen, so that the nodes losing the broker together
+ * do not all retry at once.
+ *
+ * A series of attempts ends when the connection has been up for
+ * kBackoffStableTime. A connection that drops sooner continues the series,
+ * so that a flapping link backs off too. The ESP is restarted only when a
+ * series lasts more than the budget.
+ */
+
+#ifndef __BACKOFF_H__
+#define __BACKOFF_H__
+
+#include <stdint.h>
+
+class Backoff {
+  uint32_t mBase;
+  uint32_t mCap;
+  uint32_t mBudget;
+  uint32_t mRandom;
+  uint32_t mAttemptCount;  /* in the current series */
+  uint32_t mSeriesDate;    /* first attempt of the series */
+  uint32_t mAttemptDate;
+  uint32_t mDelay;         /* before the next attempt */
+  uint32_t mConnectedDate;
+  bool mConnected;
+  bool mLossDated;         /* the first retry is counted from the loss */
+  uint32_t mTotalCount;
+
+  uint32_t random();
+
+public:
+  Backoff(const uint32_t inBase, const uint32_t inCap, const uint32_t inBudget);
+  void seed(const uint32_t inSeed);
+  /* true when a new attempt is allowed */
+  bool isDue();
+  /* To be called at each attempt. Restarts the ESP past the budget */
+  void attempted();
+  void succeeded();
+  uint32_t count() const { return mAttemptCount; }
+  uint32_t totalCount() const { return mTotalCount; }
+  uint32_t delay() const { return mDelay; }
+};
+
+#endif
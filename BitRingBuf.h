@@ -20,9 +20,13 @@
  * S is the maximum number of bits in the bit ring buffer.
  */
 template <size_t S> class BitRingBuf {
-  uint32_t mBits[S / 32 + ((S % 32) != 0)];
+  static const uint32_t kWordCount = S / 32 + ((S % 32) != 0);
+
+  uint32_t mBits[kWordCount];
   uint32_t mSize;
   uint32_t mWriteIndex;
+  /* Number of bits set to one, maintained by push */
+  uint32_t mOnCount;
 
   /*
    * Write a bit at the inIdex location
@@ -31,43 +35,72 @@ template <size_t S> class BitRingBuf {
     if (inIndex < mSize) {
       uint32_t arrayIdx = inIndex / 32;
       uint32_t bitIdx = inIndex % 32;
-      mBits[arrayIdx] &= ~(1 << bitIdx);
-      mBits[arrayIdx] |= (inBit & 1) << bitIdx;
+      mBits[arrayIdx] &= ~(1ul << bitIdx);
+      mBits[arrayIdx] |= (inBit & 1ul) << bitIdx;
     }
   }
 
   /*
    * Count the number of bits set to one in a word
    */
-  uint32_t onBitCount(uint32_t inWord) const {
+  static uint32_t onBitCount(const uint32_t inWord) {
+    return __builtin_popcount(inWord);
+  }
+
+  /*
+   * Count the number of bits set to one between inStart (included) and inEnd
+   * (excluded), inEnd <= S. Whole words are counted at once.
+   */
+  uint32_t rangeOnCount(uint32_t inStart, const uint32_t inEnd) const {
     uint32_t count = 0;
-    if (inWord != 0) {
-      for (uint32_t i = 0; i < 32; i++) {
-        count += inWord & 1;
-        inWord >>= 1;
+    while (inStart < inEnd) {
+      const uint32_t bitIdx = inStart % 32;
+      uint32_t length = 32 - bitIdx;
+      if (length > inEnd - inStart) {
+        length = inEnd - inStart;
       }
+      const uint32_t mask =
+          length == 32 ? 0xFFFFFFFFul : ((1ul << length) - 1) << bitIdx;
+      count += onBitCount(mBits[inStart / 32] & mask);
+      inStart += length;
     }
     return count;
   }
 
+public:
   /*
-   * Count the number of bits set to one in the buffer
+   * At start all the bits are set to 0
+   */
+  BitRingBuf() : mSize(0), mWriteIndex(0), mOnCount(0) {
+    for (uint32_t i = 0; i < kWordCount; i++) {
+      mBits[i] = 0;
+    }
+  }
+
+  /*
+   * Count the number of bits set to one in the buffer by a full recount
    */
   uint32_t onCount() const {
     uint32_t count = 0;
-    for (uint32_t i = 0; i < S / 32 + ((S % 32) != 0); i++) {
+    for (uint32_t i = 0; i < kWordCount; i++) {
       count += onBitCount(mBits[i]);
     }
     return count;
   }
 
-public:
   /*
-   * At start all the bits are set to 0
+   * Count the number of bits set to one among the inLength last pushed bits
    */
-  BitRingBuf() : mSize(0), mWriteIndex(0) {
-    for (uint32_t i = 0; i < S / 32 + ((S % 32) != 0); i++) {
-      mBits[i] = 0;
+  uint32_t onCount(uint32_t inLength) const {
+    if (inLength > mSize) {
+      inLength = mSize;
+    }
+    if (inLength <= mWriteIndex) {
+      return rangeOnCount(mWriteIndex - inLength, mWriteIndex);
+    } else {
+      /* The window wraps around the end of the buffer */
+      return rangeOnCount(S - (inLength - mWriteIndex), S) +
+             rangeOnCount(0, mWriteIndex);
     }
   }
 
@@ -94,7 +127,11 @@ public:
   void push(const uint32_t inBit) {
     if (mSize < S) {
       mSize++;
+    } else {
+      /* The oldest bit is evicted */
+      mOnCount -= readBit(mWriteIndex);
     }
+    mOnCount += inBit & 1;
     writeBit(mWriteIndex, inBit);
     mWriteIndex++;
     if (mWriteIndex == S) {
@@ -102,9 +139,26 @@ public:
     }
   }
 
+  /*
+   * % of bits set to one in the buffer
+   */
   float loadAverage() const {
     if (mSize > 0) {
-      return 100.0 * (float)onCount() / (float)mSize;
+      return 100.0 * (float)mOnCount / (float)mSize;
+    } else {
+      return 0;
+    }
+  }
+
+  /*
+   * % of bits set to one among the inLength last pushed bits
+   */
+  float loadAverage(uint32_t inLength) const {
+    if (inLength > mSize) {
+      inLength = mSize;
+    }
+    if (inLength > 0) {
+      return 100.0 * (float)onCount(inLength) / (float)inLength;
     } else {
       return 0;
     }
@@ -0,0 +1,180 @@
+#include "Checkpoint.h"
+#include "Crc.h"
+#include "Debug.h"
+#include "Hal.h"
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#endif
+
+static const uint32_t kCheckpointMagic = 0x31544B43; /* "CKT1" */
+static const uint8_t kLogModule = Logger::STORAGE; /* of the log messages */
+
+Checkpoint::Source Checkpoint::sSource = Checkpoint::NONE;
+uint32_t Checkpoint::sDate = 0;
+bool Checkpoint::sAgeChecked = false;
+
+/*------------------------------------------------------------------------------
+ * Copy in RTC memory. It is not initialized at start so that it keeps the
+ * content written before a software restart. After a power on, it contains
+ * garbage that the CRC rejects. On the host, it is a plain static variable.
+ */
+#ifdef ARDUINO
+RTC_NOINIT_ATTR static uint32_t sRTCRecord[sizeof(Checkpoint::Data) / 4 + 4];
+#else
+static uint32_t sRTCRecord[sizeof(Checkpoint::Data) / 4 + 4];
+static uint32_t sNVSRecord[sizeof(Checkpoint::Data) / 4 + 4];
+static bool sNVSWritten = false;
+#endif
+
+/*------------------------------------------------------------------------------
+ * CRC of the record without its crc field
+ */
+uint32_t Checkpoint::crc(const Record &inRecord) {
+  return crc32(&inRecord, offsetof(Record, crc));
+}
+
+/*------------------------------------------------------------------------------
+ * ioRecord is in storage zeroed by the caller, so that the padding covered
+ * by the CRC is 0.
+ */
+void Checkpoint::seal(Record &ioRecord, const Data &inData) {
+  ioRecord.magic = kCheckpointMagic;
+  ioRecord.size = sizeof(Record);
+  ioRecord.date = Hal::epoch();
+  ioRecord.data = inData;
+  ioRecord.crc = crc(ioRecord);
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool Checkpoint::isValid(const Record &inRecord) {
+  return inRecord.magic == kCheckpointMagic &&
+         inRecord.size == sizeof(Record) && inRecord.crc == crc(inRecord);
+}
+
+/*------------------------------------------------------------------------------
+ * A record is too old if both its date and the current one are known and
+ * if they differ by more than kCheckpointMaxAge.
+ */
+bool Checkpoint::isTooOld(const uint32_t inDate) {
+  const uint32_t now = Hal::epoch();
+  return inDate != 0 && now != 0 &&
+         (now < inDate || now - inDate > kCheckpointMaxAge);
+}
+
+/*------------------------------------------------------------------------------
+ * Writes the RTC copy
+ */
+void Checkpoint::save(const Data &inData) {
+  static_assert(sizeof(Record) <= sizeof(sRTCRecord), "RTC record too small");
+  memset(sRTCRecord, 0, sizeof(sRTCRecord));
+  seal(*(Record *)sRTCRecord, inData);
+}
+
+/*------------------------------------------------------------------------------
+ * Writes the RTC copy and the Preferences one
+ */
+void Checkpoint::savePersistent(const Data &inData) {
+  save(inData);
+#ifdef ARDUINO
+  Preferences prefs;
+  prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
+  prefs.putBytes(kCheckpointKey, sRTCRecord, sizeof(Record));
+  prefs.end();
+#else
+  memcpy(sNVSRecord, sRTCRecord, sizeof(Record));
+  sNVSWritten = true;
+#endif
+}
+
+/*------------------------------------------------------------------------------
+ * Gets the most recent valid copy. Returns false if there is none or if it
+ * is too old.
+ */
+bool Checkpoint::restore(Data &outData) {
+  Record record;
+  sSource = NONE;
+
+#ifdef ARDUINO
+  const esp_reset_reason_t reason = esp_reset_reason();
+  if (reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT) {
+    memcpy(&record, sRTCRecord, sizeof(Record));
+    if (isValid(record)) {
+      sSource = RTC;
+    }
+  }
+  if (sSource == NONE) {
+    Preferences prefs;
+    prefs.begin(kPrefNamespaceName, true); /* Open in RO mode */
+    if (prefs.getBytes(kCheckpointKey, &record, sizeof(Record)) ==
+            sizeof(Record) &&
+        isValid(record)) {
+      sSource = NVS;
+    }
+    prefs.end();
+  }
+#else
+  memcpy(&record, sRTCRecord, sizeof(Record));
+  if (isValid(record)) {
+    sSource = RTC;
+  } else if (sNVSWritten) {
+    memcpy(&record, sNVSRecord, sizeof(Record));
+    if (isValid(record)) {
+      sSource = NVS;
+    }
+  }
+#endif
+
+  if (sSource != NONE && isTooOld(record.date)) {
+    LOGW;
+    DEBUG_PLN("Checkpoint trop ancien");
+    sSource = NONE;
+  }
+
+  LOGI;
+  DEBUG_P("Checkpoint : ");
+  DEBUG_PLN(stringSource());
+  if (sSource == NONE) {
+    return false;
+  }
+  sDate = record.date;
+  sAgeChecked = sDate == 0 || Hal::epoch() != 0;
+  outData = record.data;
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ * Returns true once if a checkpoint restored before the time was known
+ * turns out to be too old. The controller state it gave should be
+ * forgotten.
+ */
+bool Checkpoint::isStale() {
+  if (sAgeChecked || Hal::epoch() == 0) {
+    return false;
+  }
+  sAgeChecked = true;
+  if (isTooOld(sDate)) {
+    LOGW;
+    DEBUG_PLN("Checkpoint perime");
+    return true;
+  }
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ */
+const char *Checkpoint::stringSource() {
+  switch (sSource) {
+  case RTC:
+    return "rtc";
+  case NVS:
+    return "nvs";
+  default:
+    return "none";
+  }
+}
@@ -0,0 +1,73 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Checkpoint of the controller state across restarts.
+ *
+ * Without it, the heater restarts with a null integral component, a mean
+ * temperature set to kDefaultTemperature and empty histories. The first
+ * cycles see a derivative spike and the integral takes hours to converge
+ * again.
+ *
+ * The state is written in two places:
+ * - the RTC memory, which keeps its content across a software restart (OTA,
+ *   Backoff) but not across a power loss. It is cheap, it is written every
+ *   kCheckpointPeriod ms.
+ * - the Preferences (NVS), which survive a power loss. They are written
+ *   every kPersistentCheckpointPeriod ms only to spare the flash.
+ *
+ * Each copy is dated and protected by a CRC. At start, the RTC copy is
+ * preferred when the reset is not a power on one. A copy older than
+ * kCheckpointMaxAge s is not restored. After a power loss the time is not
+ * known until SNTP answers: the copy is restored provisionally and
+ * isStale() reports it once if it turns out to be too old.
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "Heater.h"
+#include "HistoryStore.h"
+#include <stdint.h>
+
+class Checkpoint {
+public:
+  typedef enum { NONE, RTC, NVS } Source;
+
+  typedef struct {
+    Heater::Snapshot heater;
+    float setpointTemperature;
+    float setpointOffset;
+    uint8_t functioningMode;
+    HistoryStore::Snapshot history; /* records being accumulated */
+  } Data;
+
+private:
+  typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t date; /* s since 1970, 0 if the time was not known */
+    Data data;
+    uint32_t crc;
+  } Record;
+
+  static Source sSource;
+  static uint32_t sDate;
+  static bool sAgeChecked;
+
+  static uint32_t crc(const Record &inRecord);
+  static void seal(Record &ioRecord, const Data &inData);
+  static bool isValid(const Record &inRecord);
+  static bool isTooOld(const uint32_t inDate);
+
+  Checkpoint() {} /* prevent instanciation */
+
+public:
+  static void save(const Data &inData);
+  static void savePersistent(const Data &inData);
+  static bool restore(Data &outData);
+  static bool isStale();
+  static Source source() { return sSource; }
+  static const char *stringSource();
+};
+
+#endif
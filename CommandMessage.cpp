@@ -0,0 +1,95 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Combined command of a heater.
+ */
+
+#include "CommandMessage.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ * The value must be a finite number and nothing else
+ */
+bool CommandMessage::parseFloat(const char *inStart, const char *inEnd,
+                                float &outValue) {
+  if (inStart == inEnd) {
+    return false;
+  }
+  char *end;
+  outValue = strtof(inStart, &end);
+  return end == inEnd && isfinite(outValue);
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool CommandMessage::isKey(const char *inKey, const char *inStart,
+                           const char *inEnd) {
+  const size_t length = inEnd - inStart;
+  return strlen(inKey) == length && strncmp(inKey, inStart, length) == 0;
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool CommandMessage::parse(const char *inPayload, const size_t inLength,
+                           const char *const *inModes,
+                           const uint8_t inModeCount, Command &outCommand) {
+  memset(&outCommand, 0, sizeof(outCommand));
+  outCommand.mode = -1;
+  const char *payloadEnd = inPayload + inLength;
+  bool empty = true;
+
+  const char *pair = inPayload;
+  while (pair < payloadEnd) {
+    const char *pairEnd = pair;
+    while (pairEnd < payloadEnd && *pairEnd != ',') {
+      pairEnd++;
+    }
+    const char *equal = (const char *)memchr(pair, '=', pairEnd - pair);
+    if (equal == NULL) {
+      return false;
+    }
+    const char *value = equal + 1;
+    if (isKey("sp", pair, equal)) {
+      if (!parseFloat(value, pairEnd, outCommand.setpoint)) {
+        return false;
+      }
+      outCommand.hasSetpoint = true;
+    } else if (isKey("spo", pair, equal)) {
+      if (!parseFloat(value, pairEnd, outCommand.setpointOffset)) {
+        return false;
+      }
+      outCommand.hasSetpointOffset = true;
+    } else if (isKey("mode", pair, equal)) {
+      for (uint8_t i = 0; i < inModeCount; i++) {
+        if (isKey(inModes[i], value, pairEnd)) {
+          outCommand.mode = i;
+        }
+      }
+      if (outCommand.mode < 0) {
+        return false;
+      }
+    } else if (isKey("toff", pair, equal)) {
+      if (!parseFloat(value, pairEnd, outCommand.temperatureOffset)) {
+        return false;
+      }
+      outCommand.hasTemperatureOffset = true;
+    } else if (isKey("seq", pair, equal)) {
+      char *end;
+      if (value == pairEnd || *value < '0' || *value > '9') {
+        return false;
+      }
+      outCommand.sequence = strtoul(value, &end, 10);
+      if (end != pairEnd) {
+        return false;
+      }
+      outCommand.hasSequence = true;
+    } else {
+      return false;
+    }
+    empty = false;
+    pair = pairEnd + 1;
+  }
+  return !empty;
+}
@@ -0,0 +1,59 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Combined command of a heater, received on heater<num>/cmd.
+ *
+ * The payload is a list of key=value pairs separated by ',' carrying any
+ * subset of:
+ *
+ *   sp    setpoint (°C)
+ *   spo   setpoint offset (°C)
+ *   mode  stop, auto, anti or eco
+ *   toff  temperature offset (°C)
+ *   seq   sequence number, echoed in the status
+ *
+ * for instance "sp=19.5,mode=auto,seq=42". The message is validated as a
+ * whole: an unknown key or a bad value rejects it and nothing is applied.
+ * Otherwise all the fields are applied together, so that the heater command
+ * never sees half of the message.
+ */
+
+#ifndef __COMMANDMESSAGE_H__
+#define __COMMANDMESSAGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+class CommandMessage {
+public:
+  typedef struct {
+    bool hasSetpoint;
+    float setpoint;
+    bool hasSetpointOffset;
+    float setpointOffset;
+    int8_t mode; /* index in the mode keywords, -1 if none */
+    bool hasTemperatureOffset;
+    float temperatureOffset;
+    bool hasSequence;
+    uint32_t sequence;
+  } Command;
+
+private:
+  CommandMessage() {} /* prevent instanciation */
+
+  static bool parseFloat(const char *inStart, const char *inEnd,
+                         float &outValue);
+  static bool isKey(const char *inKey, const char *inStart,
+                    const char *inEnd);
+
+public:
+  /*
+   * Parses a null terminated payload. Returns false if the message is
+   * invalid, outCommand is then meaningless.
+   */
+  static bool parse(const char *inPayload, const size_t inLength,
+                    const char *const *inModes, const uint8_t inModeCount,
+                    Command &outCommand);
+};
+
+#endif
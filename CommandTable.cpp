@@ -0,0 +1,117 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Table of commands for the whole fleet.
+ */
+
+#include "CommandTable.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ * '*', a number, a range or a group name
+ */
+bool CommandTable::matches(const char *inSelector, const char *inEnd,
+                           const uint32_t inNum, const char *inGroups) {
+  const size_t length = inEnd - inSelector;
+  if (length == 1 && *inSelector == '*') {
+    return true;
+  }
+  if (length > 0 && *inSelector >= '0' && *inSelector <= '9') {
+    char *end;
+    const uint32_t first = strtoul(inSelector, &end, 10);
+    uint32_t last = first;
+    if (end < inEnd && *end == '-') {
+      last = strtoul(end + 1, &end, 10);
+    }
+    return end == inEnd && inNum >= first && inNum <= last;
+  }
+  while (*inGroups != '\0') {
+    const char *groupEnd = strchr(inGroups, ',');
+    if (groupEnd == NULL) {
+      groupEnd = inGroups + strlen(inGroups);
+    }
+    if ((size_t)(groupEnd - inGroups) == length &&
+        strncmp(inGroups, inSelector, length) == 0) {
+      return true;
+    }
+    inGroups = *groupEnd == ',' ? groupEnd + 1 : groupEnd;
+  }
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ * A field ends at the next ',' or at the end of the entry
+ */
+const char *CommandTable::fieldEnd(const char *inStart, const char *inEnd) {
+  while (inStart < inEnd && *inStart != ',') {
+    inStart++;
+  }
+  return inStart;
+}
+
+/*------------------------------------------------------------------------------
+ * A field that is not entirely a finite number is ignored
+ */
+bool CommandTable::parseFloat(const char *inStart, const char *inEnd,
+                              float &outValue) {
+  if (inStart == inEnd) {
+    return false;
+  }
+  char *end;
+  const float value = strtof(inStart, &end);
+  if (end != inEnd || !isfinite(value)) {
+    return false;
+  }
+  outValue = value;
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool CommandTable::extract(const char *inPayload, const size_t inLength,
+                           const uint32_t inNum, const char *inGroups,
+                           const char *const *inModes,
+                           const uint8_t inModeCount, Command &outCommand) {
+  memset(&outCommand, 0, sizeof(outCommand));
+  outCommand.mode = -1;
+  bool selected = false;
+  const char *payloadEnd = inPayload + inLength;
+
+  const char *entry = inPayload;
+  while (entry < payloadEnd) {
+    const char *entryEnd = entry;
+    while (entryEnd < payloadEnd && *entryEnd != ';' && *entryEnd != '\n') {
+      entryEnd++;
+    }
+    const char *colon = (const char *)memchr(entry, ':', entryEnd - entry);
+    if (colon != NULL && matches(entry, colon, inNum, inGroups)) {
+      selected = true;
+      const char *start = colon + 1;
+      const char *end = fieldEnd(start, entryEnd);
+      if (parseFloat(start, end, outCommand.setpoint)) {
+        outCommand.hasSetpoint = true;
+      }
+      if (end < entryEnd) {
+        start = end + 1;
+        end = fieldEnd(start, entryEnd);
+        if (parseFloat(start, end, outCommand.offset)) {
+          outCommand.hasOffset = true;
+        }
+      }
+      if (end < entryEnd) {
+        start = end + 1;
+        end = fieldEnd(start, entryEnd);
+        for (uint8_t i = 0; i < inModeCount; i++) {
+          if (strlen(inModes[i]) == (size_t)(end - start) &&
+              strncmp(inModes[i], start, end - start) == 0) {
+            outCommand.mode = i;
+          }
+        }
+      }
+    }
+    entry = entryEnd + 1;
+  }
+  return selected;
+}
@@ -0,0 +1,57 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Table of commands for the whole fleet, published once on
+ * allHeaters/commands instead of one message per heater and per field.
+ *
+ * The table is a list of entries separated by ';' or new lines:
+ *
+ *   <selector>:<setpoint>,<setpoint offset>,<mode>
+ *
+ * The selector is '*' for all the heaters, a heater number, a range of
+ * numbers like 3-7 or the name of a group. The groups of a heater are set
+ * at runtime with heater<num>/groups. An empty field leaves the value
+ * unchanged and trailing fields may be omitted. The entries are applied in
+ * order so that a later, more specific, entry overrides an earlier one:
+ *
+ *   *:19,0,auto;bedrooms:17;5:21,,eco
+ */
+
+#ifndef __COMMANDTABLE_H__
+#define __COMMANDTABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+class CommandTable {
+public:
+  typedef struct {
+    bool hasSetpoint;
+    float setpoint;
+    bool hasOffset;
+    float offset;
+    int8_t mode; /* index in the mode keywords, -1 if none */
+  } Command;
+
+private:
+  CommandTable() {} /* prevent instanciation */
+
+  static bool matches(const char *inSelector, const char *inEnd,
+                      const uint32_t inNum, const char *inGroups);
+  static const char *fieldEnd(const char *inStart, const char *inEnd);
+  static bool parseFloat(const char *inStart, const char *inEnd,
+                         float &outValue);
+
+public:
+  /*
+   * Gathers in outCommand the fields of the entries selecting the heater
+   * inNum or one of its inGroups (comma separated). The payload must be
+   * null terminated. Returns false if no entry selects the heater.
+   */
+  static bool extract(const char *inPayload, const size_t inLength,
+                      const uint32_t inNum, const char *inGroups,
+                      const char *const *inModes, const uint8_t inModeCount,
+                      Command &outCommand);
+};
+
+#endif
@@ -63,12 +63,30 @@ extern const uint8_t pinAddr[];
  */
 static const uint8_t pinDHT22 = 4;
 
+/*
+ * The DHT22 is read asynchronously with the RMT peripheral. The start signal
+ * lasts kDHTStartDuration ms, the answer is captured during
+ * kDHTCaptureDuration ms and the reception ends after kDHTIdleThreshold µs
+ * without edge.
+ */
+static const uint8_t kDHTRmtChannel = 4;
+static const uint32_t kDHTStartDuration = 2ul;
+static const uint32_t kDHTCaptureDuration = 10ul;
+static const uint16_t kDHTIdleThreshold = 200;
+
 /*------------------------------------------------------------------------------
- * The number of consecutive retries of connection to the WiFi and MQTT broker
- * before reboot.
+ * Backoff of the reconnections to the WiFi and to the MQTT broker (in ms).
+ * The delay between attempts doubles from the base up to the cap, with a
+ * full jitter. The ESP is restarted when a series of attempts lasts more
+ * than kConnectionRestartBudget. A connection up for kBackoffStableTime ends
+ * the series.
  */
-static const uint32_t wifiRetryCount = 10;
-static const uint32_t brokerMQTTRetryCount = 60;
+static const uint32_t kWiFiBackoffBase = 1000ul;
+static const uint32_t kWiFiBackoffCap = 60ul * 1000ul;
+static const uint32_t kBrokerBackoffBase = 1000ul;
+static const uint32_t kBrokerBackoffCap = 30ul * 1000ul;
+static const uint32_t kConnectionRestartBudget = 30ul * 60ul * 1000ul;
+static const uint32_t kBackoffStableTime = 5ul * 60ul * 1000ul;
 
 /*------------------------------------------------------------------------------
  * Keep alive for the connection to the MQTT broker
@@ -81,6 +99,164 @@ static const int kMQTTSocketTimeout = 60;
  */
 static const uint32_t kMQTTBrokerTimeout = 1000ul * 60ul;
 
+/*------------------------------------------------------------------------------
+ * Network task. WiFi, mDNS, OTA and MQTT run in their own task on the core
+ * not used by loop(). The connection automaton is updated every
+ * kConnectionUpdatePeriod ms and the MQTT client is polled every
+ * kNetworkTaskPeriod ms. loop() runs the heater control with a higher
+ * priority.
+ */
+static const uint32_t kConnectionUpdatePeriod = 1000ul;
+static const uint32_t kNetworkTaskPeriod = 10ul;
+static const uint32_t kNetworkTaskStackSize = 8192ul;
+static const uint32_t kNetworkTaskPriority = 1ul;
+static const int kNetworkTaskCore = 0;
+static const uint32_t kControlTaskPriority = 3ul;
+
+/*------------------------------------------------------------------------------
+ * Messages exchanged between the network task and loop(). Topic sizes
+ * include the terminating null. The command table of allHeaters/commands
+ * is the largest incoming payload, about 15 bytes per heater when each has
+ * its own entry. heater<num>/stats is the largest outgoing one.
+ */
+static const uint32_t kMaxTopicSize = 48ul;
+static const uint32_t kMaxIncomingPayloadSize = 1024ul;
+static const uint32_t kMaxOutgoingPayloadSize = 512ul;
+static const uint32_t kIncomingQueueLength = 8ul;
+static const uint32_t kOutgoingQueueLength = 8ul;
+
+/*------------------------------------------------------------------------------
+ * Size of the MQTT client buffer. It holds a whole packet: header, topic and
+ * payload. The client drops a larger packet without a word, so the buffer
+ * is twice the largest payload: a payload too large for a slot still
+ * reaches the callback, where it is counted (see IncomingFilter).
+ */
+static const uint16_t kMQTTBufferSize = 2 * kMaxIncomingPayloadSize;
+
+/*------------------------------------------------------------------------------
+ * The cached WiFi parameters are abandoned after kCachedConnectRetries
+ * failures, see ConnectionCache.
+ */
+static const uint32_t kCachedConnectRetries = 3ul;
+
+/*------------------------------------------------------------------------------
+ * Size of the comma separated list of the groups of the heater, see
+ * CommandTable. Includes the terminating null.
+ */
+static const uint32_t kGroupsSize = 64ul;
+
+/*------------------------------------------------------------------------------
+ * Topics handled by Connection. At most kMaxTopicHandlers topics. The hash
+ * table has kTopicTableSize entries, a power of 2 at least twice
+ * kMaxTopicHandlers so that the probe sequences stay short.
+ */
+static const uint32_t kMaxTopicHandlers = 16ul;
+static const uint32_t kTopicTableSize = 32ul;
+
+/*------------------------------------------------------------------------------
+ * A heating slot started more than kMaxSlotLateness ms after the expected
+ * date is counted as late.
+ */
+static const uint32_t kMaxSlotLateness = 100ul;
+
+/*------------------------------------------------------------------------------
+ * Minimum CPU frequency (in MHz) when the power management lowers it during
+ * idle time.
+ */
+static const int kMinCpuFrequency = 80;
+
+/*------------------------------------------------------------------------------
+ * Period (in ms) of the publication of the runtime statistics on
+ * heater<num>/stats
+ */
+static const uint32_t kStatsPeriod = 60ul * 1000ul;
+
+/*------------------------------------------------------------------------------
+ * Logger. Up to kLogChannelCount tasks can log: loop(), the network task and
+ * a spare one. Each has a ring buffer of kLogBufferSize bytes (a power of 2).
+ * A record takes at most kLogRecordSize bytes (255 max) and is formatted in
+ * a line of at most kLogLineSize characters.
+ */
+static const uint32_t kLogChannelCount = 3ul;
+static const uint32_t kLogBufferSize = 2048ul;
+static const uint32_t kLogRecordSize = 128ul;
+static const uint32_t kLogLineSize = 192ul;
+
+/*------------------------------------------------------------------------------
+ * While log lines are pending, loop() wakes up at least every kLogDrainPeriod
+ * ms to write them. The UART FIFO (128 bytes) is emptied in 11 ms at 115200
+ * bauds.
+ */
+static const uint32_t kLogDrainPeriod = 10ul;
+
+/*------------------------------------------------------------------------------
+ * The log lines forwarded on MQTT are gathered in a payload published on
+ * heater<num>/log every kLogPublishPeriod ms.
+ */
+static const uint32_t kLogForwardSize = kMaxOutgoingPayloadSize;
+static const uint32_t kLogPublishPeriod = 2000ul;
+
+/*------------------------------------------------------------------------------
+ * Time. The date is got by SNTP from the broker machine and from kNTPServer.
+ * A date before kMinValidEpoch means the time is not known yet.
+ */
+static const char *const kNTPServer = "pool.ntp.org";
+static const uint32_t kMinValidEpoch = 1600000000ul;
+
+/*------------------------------------------------------------------------------
+ * Persistent history. A sample is added every kHistorySamplePeriod ms. The
+ * records are written in flash by batches of kHistoryFlushThreshold, at most
+ * kHistoryPendingSize records are kept in RAM. Chunks sent over MQTT are at
+ * most kHistoryChunkSize bytes, at most kHistoryScanLimit records are read
+ * to build one.
+ */
+static const uint32_t kHistorySamplePeriod = 60ul * 1000ul;
+static const uint32_t kHistoryFlushThreshold = 16ul;
+static const uint32_t kHistoryPendingSize = 24ul;
+static const uint32_t kHistoryChunkSize = 193ul; /* level + 16 records */
+static const uint32_t kHistoryScanLimit = 64ul;  /* records read per chunk */
+
+/*------------------------------------------------------------------------------
+ * Checkpoint of the controller state. It is written in RTC memory every
+ * kCheckpointPeriod ms to survive a software restart (OTA, Backoff) and in
+ * the Preferences every kPersistentCheckpointPeriod ms to survive a power
+ * loss. A checkpoint older than kCheckpointMaxAge s is not restored.
+ */
+static const uint32_t kCheckpointPeriod = 30ul * 1000ul;
+static const uint32_t kPersistentCheckpointPeriod = 15ul * 60ul * 1000ul;
+static const uint32_t kCheckpointMaxAge = 3600ul;
+static const char *const kCheckpointKey = "Ckpt";
+
+/*------------------------------------------------------------------------------
+ * The controller is considered settled when the error is below
+ * kSettledError °C during kSettledCycles consecutive PWM cycles.
+ */
+static const float kSettledError = 0.1;
+static const uint32_t kSettledCycles = 10ul;
+
+/*------------------------------------------------------------------------------
+ * Report by exception. When enabled, a publication is done only if a field
+ * has moved by its deadband (°C, % of humidity, % of PWM) or if the last one
+ * is older than kReportHeartbeat ms.
+ */
+static const uint32_t kReportHeartbeat = 60ul * 1000ul;
+static const float kTemperatureDeadband = 0.1;
+static const float kHumidityDeadband = 1.0;
+static const float kPWMDeadband = 1.0;
+static const float kDiscreteDeadband = 0.5;
+
+/*------------------------------------------------------------------------------
+ * Offline queue. While offline, a status is queued every
+ * kOfflineSamplePeriod ms, at most kOfflineQueueSize statuses are kept (3 h).
+ * Once online, they are replayed one every kReplayPeriod ms, starting
+ * kReplayStagger ms times the heater number after the connection so that
+ * the heaters do not replay together.
+ */
+static const uint32_t kOfflineSamplePeriod = 60ul * 1000ul;
+static const uint16_t kOfflineQueueSize = 180;
+static const uint32_t kReplayPeriod = 500ul;
+static const uint32_t kReplayStagger = 250ul;
+
 /*------------------------------------------------------------------------------
  * Default temperature when the node is operational but not receiving a
  * setpoint.
@@ -92,6 +268,10 @@ static const float kDefaultTemperature = 19.0;
  */
 static const char *const kPrefNamespaceName = "FirmRad";
 static const char *const kTemperatureOffsetKey = "TOff";
+static const char *const kTelemetryFormatKey = "TFmt";
+static const char *const kReportModeKey = "RBE";
+static const char *const kConnectionCacheKey = "NetC";
+static const char *const kGroupsKey = "Grp";
 
 /*------------------------------------------------------------------------------
  * The heating period is 30 seconds.
@@ -108,7 +288,17 @@ static const uint32_t kHeatingSlots = 30ul; /* 30 time slots */
  */
 static const uint32_t kHeatingSlotDuration = kHeatingPeriod / kHeatingSlots;
 
-static const float k50PercentPWM = ((float)kHeatingSlots) / 2.0;
+/*------------------------------------------------------------------------------
+ * The duty of a PWM cycle is computed kDutyLeadSlots slots before the end of
+ * the previous one.
+ */
+static const uint32_t kDutyLeadSlots = 2ul;
+
+/*------------------------------------------------------------------------------
+ * A setpoint change of at least kSetpointRecomputeStep °C recomputes the
+ * duty of the current PWM cycle instead of waiting for the next one.
+ */
+static const float kSetpointRecomputeStep = 0.5;
 
 /*------------------------------------------------------------------------------
  * The heating period is divided in temperature measurement slots. An average 
@@ -117,10 +307,11 @@ static const float k50PercentPWM = ((float)kHeatingSlots) / 2.0;
 static const uint32_t kTemperatureMeasurementSlots = 5ul; 
 
 /*------------------------------------------------------------------------------
- * Parameters of the control law
+ * Parameters of the control law, per PWM cycle. They are template parameters
+ * of the Controller of the heater, hence constexpr.
  */
-static const float kProportionalParameter = (float)kHeatingSlots * 0.8;
-static const float kIntegralParameter = 0.5;
-static const float kDerivativeParameter = 20.0;
+static constexpr float kProportionalParameter = (float)kHeatingSlots * 0.8;
+static constexpr float kIntegralParameter = 0.5;
+static constexpr float kDerivativeParameter = 20.0;
 
 #endif
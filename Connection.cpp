@@ -1,17 +1,25 @@
 #include "Connection.h"
 #include "Config.h"
+#include "ConnectionCache.h"
 #include "Debug.h"
+#include "Hal.h"
 #include "Network.h"
-#include "Retryer.h"
+#include "Backoff.h"
+#include "Crc.h"
+#include <esp_netif_net_stack.h>
+#include <lwip/dhcp.h>
+#include <math.h>
+
+static const uint8_t kLogModule = Logger::NETWORK; /* of the log messages */
 
 /*------------------------------------------------------------------------------
- * Objects counting the number of reconnection attempts and restarting the ESP
- * when the number of attempts exceeds a threshold
+ * Backoff of the reconnection attempts. They restart the ESP as a last
+ * resort.
  */
-Retryer wifiRetryer(wifiRetryCount);
-Retryer brokerMQTTRetryer(brokerMQTTRetryCount);
-Retryer wifiReconnectCount(wifiRetryCount, 10000);
-Retryer mqttReconnectCount(brokerMQTTRetryCount, 10000);
+Backoff wifiBackoff(kWiFiBackoffBase, kWiFiBackoffCap,
+                    kConnectionRestartBudget);
+Backoff brokerBackoff(kBrokerBackoffBase, kBrokerBackoffCap,
+                      kConnectionRestartBudget);
 
 /*------------------------------------------------------------------------------
  * Client for the WiFi connection
@@ -28,10 +36,15 @@ PubSubClient Connection::sClient(Connection::sNet);
  */
 IPAddress Connection::sBrokerIP;
 
+/*------------------------------------------------------------------------------
+ * IP address of the MQTT broker as a string for SNTP, which keeps the pointer
+ */
+char Connection::sBrokerIPString[16] = "";
+
 /*------------------------------------------------------------------------------
  * State of the connection
  */
-Connection::State Connection::sState = INIT;
+volatile Connection::State Connection::sState = INIT;
 
 /*------------------------------------------------------------------------------
  * Name of the node
@@ -45,39 +58,540 @@ Connection::SubscriptionFunction Connection::sSubs = NULL;
 Connection::MessageHandlingFunction Connection::sHandler = NULL;
 
 /*------------------------------------------------------------------------------
- * sets up the connection
+ * Queues between the network task and the user of Connection and counters of
+ * the messages dropped because a queue was full or a message was too large.
+ * The incoming queue and the free slot queue hold indexes in
+ * sIncomingSlots.
+ */
+Connection::IncomingMessage Connection::sIncomingSlots[kIncomingQueueLength];
+QueueHandle_t Connection::sFreeSlotQueue = NULL;
+QueueHandle_t Connection::sIncomingQueue = NULL;
+QueueHandle_t Connection::sOutgoingQueue = NULL;
+uint32_t Connection::sMessageDate = 0;
+uint32_t Connection::sDroppedIncoming = 0;
+IncomingFilter Connection::sIncomingFilter;
+uint32_t Connection::sDroppedOutgoing = 0;
+
+/*------------------------------------------------------------------------------
+ * Network task and connection timing. sStateDate is the date (ms) at which
+ * each state was entered for the last time. sAttemptDate is the date at
+ * which the current connection attempt started: the boot or the loss of the
+ * connection.
+ */
+TaskHandle_t Connection::sTask = NULL;
+uint32_t Connection::sStateDate[MQTT_OK + 1];
+uint32_t Connection::sAttemptDate = 0;
+uint32_t Connection::sBootTime = 0;
+uint32_t Connection::sReconnectTime = 0;
+uint32_t Connection::sOnlineCount = 0;
+
+/*------------------------------------------------------------------------------
+ * Profiles of the state machine and of the polling of the clients
+ */
+Profile Connection::sUpdateProfile;
+Profile Connection::sLoopProfile;
+
+/*------------------------------------------------------------------------------
+ * Use of the connection cache. sCachedFailureCount counts the WiFi failures
+ * with the cached parameters since the last good connection. sIPFromCache
+ * is set when the cached IP configuration is used instead of DHCP.
+ */
+bool Connection::sWiFiFromCache = false;
+bool Connection::sIPFromCache = false;
+bool Connection::sBrokerFromCache = false;
+uint32_t Connection::sCachedFailureCount = 0;
+uint8_t Connection::sCacheUse = 0;
+
+/*------------------------------------------------------------------------------
+ * Table of the handled topics, open addressing with linear probing
+ */
+Connection::TopicEntry Connection::sTopicTable[kTopicTableSize];
+uint32_t Connection::sTopicCount = 0;
+
+/*------------------------------------------------------------------------------
+ * sets up the connection and starts the network task. Must be called after
+ * every other initialization since the network task starts immediately.
  */
 void Connection::begin(String &inName, SubscriptionFunction inSubFunction, MessageHandlingFunction inHandler) {
   sName = inName;
   sSubs = inSubFunction;
   sHandler = inHandler;
+  sFreeSlotQueue = xQueueCreate(kIncomingQueueLength, sizeof(uint8_t));
+  sIncomingQueue = xQueueCreate(kIncomingQueueLength, sizeof(uint8_t));
+  for (uint8_t slot = 0; slot < kIncomingQueueLength; slot++) {
+    xQueueSend(sFreeSlotQueue, &slot, 0);
+  }
+  sOutgoingQueue = xQueueCreate(kOutgoingQueueLength, sizeof(OutgoingMessage));
+  xTaskCreatePinnedToCore(task, "network", kNetworkTaskStackSize, NULL,
+                          kNetworkTaskPriority, &sTask, kNetworkTaskCore);
+}
+
+/*------------------------------------------------------------------------------
+ * Network task. Blocking calls (WiFi, mDNS, connection to the broker) are
+ * done here so that they never delay the heater control.
+ *
+ * The state machine is evaluated when a WiFi event wakes the task up and
+ * every kConnectionUpdatePeriod ms for the retries. Both parts are
+ * profiled.
+ */
+void Connection::task(void *inParameter) {
+  uint32_t lastUpdateDate = millis() - kConnectionUpdatePeriod;
+  for (;;) {
+    const bool notified =
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(kNetworkTaskPeriod)) > 0;
+    const uint32_t currentDate = millis();
+    if (notified || currentDate - lastUpdateDate >= kConnectionUpdatePeriod) {
+      lastUpdateDate = currentDate;
+      const uint32_t startDate = Hal::micros();
+      evaluate();
+      sUpdateProfile.record(Hal::micros() - startDate);
+    }
+    const uint32_t startDate = Hal::micros();
+    loop();
+    flushOutgoing();
+    sLoopProfile.record(Hal::micros() - startDate);
+  }
 }
 
 /*------------------------------------------------------------------------------
- * Sets up subscriptions
+ * Runs the state machine again as long as it goes forward and the WiFi is
+ * connected, so that the stages that succeed immediately do not wait for
+ * the next period. When the WiFi is not connected yet, the GOT_IP event
+ * wakes the task up.
+ */
+void Connection::evaluate() {
+  State previous;
+  do {
+    previous = sState;
+    update();
+  } while (sState > previous && WiFi.status() == WL_CONNECTED);
+}
+
+/*------------------------------------------------------------------------------
+ * WiFi events, in the event task. Getting an address may let the state
+ * machine go forward, losing the connection has to be noticed at once. The
+ * disconnections while not connected are left to the periodic evaluation so
+ * that they do not count as extra retries.
+ */
+void Connection::wifiEvent(arduino_event_id_t inEvent,
+                           arduino_event_info_t inInfo) {
+  const bool wakeUp =
+      inEvent == ARDUINO_EVENT_WIFI_STA_GOT_IP ||
+      ((inEvent == ARDUINO_EVENT_WIFI_STA_DISCONNECTED ||
+        inEvent == ARDUINO_EVENT_WIFI_STA_LOST_IP) &&
+       sState >= WIFI_OK);
+  if (wakeUp && sTask != NULL) {
+    xTaskNotifyGive(sTask);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * The backoff is seeded with the MAC address so that each heater draws its
+ * own delays.
+ */
+void Connection::seedBackoff() {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  const uint32_t seed = crc32(mac, sizeof(mac));
+  wifiBackoff.seed(seed);
+  brokerBackoff.seed(seed ^ 0x5A5A5A5A);
+}
+
+/*------------------------------------------------------------------------------
+ * Starts the WiFi connection, with the access point and the IP
+ * configuration of the cache if any, so that neither a scan nor DHCP are
+ * needed. The IP configuration is used only while its lease holds.
+ */
+void Connection::beginWiFi() {
+  const ConnectionCache::Data &cache = ConnectionCache::data();
+  sWiFiFromCache = cache.hasWiFi;
+  sIPFromCache = ConnectionCache::hasLease(Hal::epoch());
+  if (sIPFromCache) {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway),
+                IPAddress(cache.subnet), IPAddress(cache.dns));
+  }
+  if (sWiFiFromCache) {
+    WiFi.begin(ssid, pass, cache.channel, cache.bssid);
+  } else {
+    WiFi.begin(ssid, pass);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * After kCachedConnectRetries failures with the cached parameters, they are
+ * forgotten and the connection starts again with a scan and DHCP.
+ */
+void Connection::wifiFailed() {
+  if (sWiFiFromCache && ++sCachedFailureCount >= kCachedConnectRetries) {
+    LOGW;
+    DEBUG_PLN("Cache WiFi abandonne");
+    ConnectionCache::invalidateWiFi();
+    WiFi.disconnect();
+    /* Back to DHCP */
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0),
+                IPAddress((uint32_t)0));
+    beginWiFi();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Resolves the broker with mDNS. If 0.0.0.0 is got, the broker was not
+ * found.
+ */
+bool Connection::resolveBroker() {
+  sBrokerFromCache = false;
+  sBrokerIP = MDNS.queryHost(brokerName);
+  if (sBrokerIP != IPAddress(0, 0, 0, 0)) {
+    DEBUG_PLN("trouve");
+    setupBroker();
+    return true;
+  } else {
+    DEBUG_PLN("absent");
+    return false;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+void Connection::setupBroker() {
+  sClient.setServer(sBrokerIP, 1883);
+  sClient.setCallback(callback);
+  sClient.setKeepAlive(kMQTTBrokerKeepAlive);
+  sClient.setSocketTimeout(kMQTTSocketTimeout);
+  sClient.setBufferSize(kMQTTBufferSize);
+  /* The broker machine is the preferred time server */
+  strlcpy(sBrokerIPString, sBrokerIP.toString().c_str(),
+          sizeof(sBrokerIPString));
+  configTime(0, 0, sBrokerIPString, kNTPServer);
+}
+
+/*------------------------------------------------------------------------------
+ * Duration of the DHCP lease in s, 0 if unknown. Read from lwIP without
+ * its lock, the value is written once per lease.
+ */
+uint32_t Connection::leaseTime() {
+  const struct netif *lwipNetif =
+      (const struct netif *)esp_netif_get_netif_impl(WiFi.STA.netif());
+  const struct dhcp *dhcp =
+      lwipNetif != NULL ? netif_dhcp_data(lwipNetif) : NULL;
+  return dhcp != NULL ? dhcp->offered_t0_lease : 0;
+}
+
+/*------------------------------------------------------------------------------
+ * Date of the DHCP lease, got when WiFi came up, 0 if the time is not set
+ */
+uint32_t Connection::leaseDate(const uint32_t inEpoch) {
+  return inEpoch > 0 ? inEpoch - (millis() - sStateDate[WIFI_OK]) / 1000 : 0;
+}
+
+/*------------------------------------------------------------------------------
+ * Keeps the parameters of the connection that just succeeded. A cached IP
+ * configuration keeps the lease it came with, it has not been renewed.
+ */
+void Connection::storeCache() {
+  sCacheUse = (sWiFiFromCache ? 1 : 0) | (sBrokerFromCache ? 2 : 0);
+  sCachedFailureCount = 0;
+  ConnectionCache::Data data;
+  memset(&data, 0, sizeof(data));
+  data.hasWiFi = true;
+  data.hasBroker = true;
+  memcpy(data.bssid, WiFi.BSSID(), sizeof(data.bssid));
+  data.channel = WiFi.channel();
+  data.ip = WiFi.localIP();
+  data.gateway = WiFi.gatewayIP();
+  data.subnet = WiFi.subnetMask();
+  data.dns = WiFi.dnsIP();
+  data.broker = sBrokerIP;
+  if (sIPFromCache) {
+    data.leaseTime = ConnectionCache::data().leaseTime;
+    data.leaseDate = ConnectionCache::data().leaseDate;
+  } else {
+    data.leaseTime = leaseTime();
+    data.leaseDate = leaseDate(Hal::epoch());
+  }
+  ConnectionCache::store(data);
+}
+
+/*------------------------------------------------------------------------------
+ * Once half of the lease of a cached IP configuration is over, the
+ * connection starts again with DHCP. The date of a lease got before SNTP
+ * had set the time is filled in once it has.
+ */
+void Connection::checkLease() {
+  const uint32_t epoch = Hal::epoch();
+  if (epoch == 0) {
+    return;
+  }
+  if (sIPFromCache && !ConnectionCache::hasLease(epoch)) {
+    LOGI;
+    DEBUG_PLN("Bail DHCP du cache echu, retour au DHCP");
+    ArduinoOTA.end();
+    WiFi.disconnect();
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0),
+                IPAddress((uint32_t)0));
+    beginWiFi();
+    setState(OFFLINE);
+  } else if (!sIPFromCache && ConnectionCache::data().hasWiFi &&
+             ConnectionCache::data().leaseDate == 0) {
+    ConnectionCache::Data data = ConnectionCache::data();
+    data.leaseDate = leaseDate(epoch);
+    ConnectionCache::store(data);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Changes the state and records the timing
+ */
+void Connection::setState(const State inState) {
+  const uint32_t currentDate = millis();
+  if (sState == MQTT_OK && inState != MQTT_OK) {
+    sAttemptDate = currentDate;
+  }
+  sStateDate[inState] = currentDate;
+  if (inState == MQTT_OK) {
+    if (sOnlineCount == 0) {
+      sBootTime = currentDate - sAttemptDate;
+    } else {
+      sReconnectTime = currentDate - sAttemptDate;
+    }
+    sOnlineCount++;
+    LOGI;
+    DEBUG_P("En ligne en ");
+    DEBUG_P(currentDate - sAttemptDate);
+    DEBUG_PLN(" ms");
+  }
+  sState = inState;
+}
+
+/*------------------------------------------------------------------------------
+ * Time (in ms) from the start of the last connection attempt to the last
+ * entry in a state. 0 if the state has not been entered during the last
+ * attempt, for instance WIFI_OK when only the broker was lost.
+ */
+uint32_t Connection::stageTime(const State inState) {
+  const int32_t time = sStateDate[inState] - sAttemptDate;
+  return time > 0 ? time : 0;
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the messages queued by publish(). Runs in the network task.
+ */
+void Connection::flushOutgoing() {
+  OutgoingMessage message;
+  while (xQueueReceive(sOutgoingQueue, &message, 0) == pdTRUE) {
+    if (sClient.connected()) {
+      sClient.publish(message.topic, message.payload, message.length);
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * FNV-1a hash of a topic
+ */
+uint32_t Connection::hash(const char *inTopic) {
+  uint32_t hash = 2166136261ul;
+  while (*inTopic != '\0') {
+    hash ^= (uint8_t)*inTopic++;
+    hash *= 16777619ul;
+  }
+  return hash;
+}
+
+/*------------------------------------------------------------------------------
+ * Adds a topic to the table. Returns the entry or NULL if it cannot be
+ * added.
+ */
+Connection::TopicEntry *Connection::addTopic(const String &inTopic,
+                                             const HandlerKind inKind) {
+  if (sIncomingQueue != NULL || sTopicCount == kMaxTopicHandlers ||
+      inTopic.length() == 0 || inTopic.length() >= kMaxTopicSize) {
+    return NULL;
+  }
+  const uint32_t topicHash = hash(inTopic.c_str());
+  uint32_t index = topicHash & (kTopicTableSize - 1);
+  while (sTopicTable[index].topic[0] != '\0') {
+    if (inTopic == sTopicTable[index].topic) {
+      break; /* registered again, the handler is replaced */
+    }
+    index = (index + 1) & (kTopicTableSize - 1);
+  }
+  TopicEntry &entry = sTopicTable[index];
+  if (entry.topic[0] == '\0') {
+    sTopicCount++;
+  }
+  entry.hash = topicHash;
+  strcpy(entry.topic, inTopic.c_str());
+  entry.kind = inKind;
+  entry.keywords = NULL;
+  entry.keywordCount = 0;
+  return &entry;
+}
+
+/*------------------------------------------------------------------------------
+ * Looks for a topic. The probe stops at the first free entry.
+ */
+const Connection::TopicEntry *Connection::findTopic(const uint32_t inHash,
+                                                    const char *inTopic) {
+  uint32_t index = inHash & (kTopicTableSize - 1);
+  while (sTopicTable[index].topic[0] != '\0') {
+    const TopicEntry &entry = sTopicTable[index];
+    if (entry.hash == inHash && strcmp(entry.topic, inTopic) == 0) {
+      return &entry;
+    }
+    index = (index + 1) & (kTopicTableSize - 1);
+  }
+  return NULL;
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool Connection::handle(const String &inTopic, TopicHandler inHandler) {
+  TopicEntry *entry = addTopic(inTopic, RAW);
+  if (entry != NULL) {
+    entry->handler.raw = inHandler;
+  }
+  return entry != NULL;
+}
+
+bool Connection::handleFloat(const String &inTopic, FloatHandler inHandler) {
+  TopicEntry *entry = addTopic(inTopic, FLOAT);
+  if (entry != NULL) {
+    entry->handler.floatValue = inHandler;
+  }
+  return entry != NULL;
+}
+
+bool Connection::handleInt(const String &inTopic, IntHandler inHandler) {
+  TopicEntry *entry = addTopic(inTopic, INT);
+  if (entry != NULL) {
+    entry->handler.intValue = inHandler;
+  }
+  return entry != NULL;
+}
+
+bool Connection::handleKeyword(const String &inTopic,
+                               const char *const *inKeywords,
+                               const uint8_t inKeywordCount,
+                               KeywordHandler inHandler) {
+  TopicEntry *entry = addTopic(inTopic, KEYWORD);
+  if (entry != NULL) {
+    entry->handler.keyword = inHandler;
+    entry->keywords = inKeywords;
+    entry->keywordCount = inKeywordCount;
+  }
+  return entry != NULL;
+}
+
+/*------------------------------------------------------------------------------
+ * Parses the payload according to the kind of handler and calls it. A
+ * payload that is not one of the keywords or not a finite number is ignored.
+ */
+void Connection::callHandler(const TopicEntry &inEntry,
+                             const IncomingMessage &inMessage) {
+  const char *payload = inMessage.payload;
+  const size_t length = inMessage.payloadLength;
+  switch (inEntry.kind) {
+  case RAW:
+    inEntry.handler.raw(payload, length);
+    break;
+  case FLOAT: {
+    const float value = strtof(payload, NULL);
+    if (isfinite(value)) {
+      inEntry.handler.floatValue(value);
+    }
+    break;
+  }
+  case INT:
+    inEntry.handler.intValue(strtol(payload, NULL, 10));
+    break;
+  case KEYWORD:
+    for (uint8_t i = 0; i < inEntry.keywordCount; i++) {
+      const char *keyword = inEntry.keywords[i];
+      if (strlen(keyword) == length && memcmp(payload, keyword, length) == 0) {
+        inEntry.handler.keyword(i);
+        return;
+      }
+    }
+    LOGW;
+    DEBUG_P("Mot cle inconnu : ");
+    DEBUG_PLN(payload);
+    break;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Calls the handler of each received message. Messages whose topic has no
+ * handler go to the message handler given to begin(), if any. Runs in the
+ * task calling it, typically loop(). Returns the number of messages.
+ */
+uint32_t Connection::dispatch() {
+  uint8_t slot;
+  uint32_t count = 0;
+  while (xQueueReceive(sIncomingQueue, &slot, 0) == pdTRUE) {
+    const IncomingMessage &message = sIncomingSlots[slot];
+    count++;
+    LOGT;
+    DEBUG_P("incoming: ");
+    DEBUG_P(message.topic);
+    DEBUG_P(" - ");
+    DEBUG_PLN(message.payload);
+    sMessageDate = message.date;
+    const TopicEntry *entry = findTopic(message.hash, message.topic);
+    if (entry != NULL) {
+      callHandler(*entry, message);
+    } else if (sHandler != NULL) {
+      sHandler(message.topic, message.topicLength, message.payload,
+               message.payloadLength);
+    }
+    xQueueSend(sFreeSlotQueue, &slot, 0);
+  }
+  return count;
+}
+
+/*------------------------------------------------------------------------------
+ * Subscribes the topics of the table and the ones of the subscription
+ * function
  */
 void Connection::doSubscriptions() {
+  LOGT;
+  DEBUG_PLN("Souscriptions");
+  for (uint32_t i = 0; i < kTopicTableSize; i++) {
+    if (sTopicTable[i].topic[0] != '\0') {
+      sClient.subscribe(sTopicTable[i].topic);
+    }
+  }
   if (sSubs != NULL) {
     sSubs();
   }
 }
 
 /*------------------------------------------------------------------------------
- * Callback for incoming messages
+ * Callback for incoming messages. Runs in the network task. The message is
+ * copied from the buffer of the MQTT client, which is reused for the next
+ * packet, to a free slot. The slot is queued for dispatch() and the task
+ * sleeping in Idle is woken up.
  */
 void Connection::callback(char *inTopic, byte *inPayload,
                           unsigned int inLength) {
-  if (inLength < 30) {
-    char buf[31];
-    uint32_t i;
-    for (i = 0; i < inLength; i++) {
-      buf[i] = inPayload[i];
-    }
-    buf[i] = '\0';
-    if (sHandler != NULL) {
-      sHandler(String(inTopic), String(buf));
-    }
+  const size_t topicLength = strlen(inTopic);
+  if (!sIncomingFilter.accept(topicLength, inLength)) {
+    return;
+  }
+  uint8_t slot;
+  if (xQueueReceive(sFreeSlotQueue, &slot, 0) != pdTRUE) {
+    sDroppedIncoming++;
+    return;
   }
+  IncomingMessage &message = sIncomingSlots[slot];
+  message.hash = hash(inTopic);
+  message.date = Hal::micros();
+  message.topicLength = topicLength;
+  message.payloadLength = inLength;
+  memcpy(message.topic, inTopic, topicLength + 1);
+  memcpy(message.payload, inPayload, inLength);
+  message.payload[inLength] = '\0';
+  xQueueSend(sIncomingQueue, &slot, 0);
+  Hal::wakeUp();
 }
 
 /*------------------------------------------------------------------------------
@@ -91,47 +605,59 @@ bool Connection::isOnline() { return (sState == MQTT_OK); }
  */
 void Connection::startOTA() {
   const int command = ArduinoOTA.getCommand();
+  LOGI;
   if (command == U_FLASH) {
-    Serial.println("Mise a jour du firmware");
+    DEBUG_PLN("Mise a jour du firmware");
   } else {
-    Serial.print("Commande non supportee : ");
-    Serial.println(command);
+    DEBUG_P("Commande non supportee : ");
+    DEBUG_PLN(command);
   }
 }
 
+/*------------------------------------------------------------------------------
+ * The progress is logged every 10 % only, the callback is called for each
+ * block received.
+ */
 void Connection::progressOTA(unsigned int progress, unsigned int total) {
-  static int lastProgress = -1;
-  if (progress != lastProgress) {
-    Serial.print("En cours : ");
-    Serial.print(100 * progress / total);
-    Serial.print("%\r");
+  static unsigned int lastProgress = 100;
+  const unsigned int percent = 100 * progress / total;
+  if (percent / 10 != lastProgress / 10) {
+    lastProgress = percent;
+    LOGT;
+    DEBUG_P("En cours : ");
+    DEBUG_P(percent);
+    DEBUG_PLN("%");
   }
 }
 
 void Connection::endOTA() {
-  Serial.println();
-  Serial.println("Fini");
+  LOGI;
+  DEBUG_PLN("Fini");
 }
 
 void Connection::errorOTA(ota_error_t error) {
-  Serial.print("Erreur[");
-  Serial.print(error);
-  Serial.print("] : ");
+  LOGE;
+  DEBUG_P("Erreur[");
+  DEBUG_P(error);
+  DEBUG_P("] : ");
   switch (error) {
   case OTA_AUTH_ERROR:
-    Serial.println("L'authentification a échoué");
+    DEBUG_PLN("L'authentification a échoué");
     break;
   case OTA_BEGIN_ERROR:
-    Serial.println("Échec au début");
+    DEBUG_PLN("Échec au début");
     break;
   case OTA_CONNECT_ERROR:
-    Serial.println("Échec à la connexion");
+    DEBUG_PLN("Échec à la connexion");
     break;
   case OTA_RECEIVE_ERROR:
-    Serial.println("Échec à la réception");
+    DEBUG_PLN("Échec à la réception");
     break;
   case OTA_END_ERROR:
-    Serial.println("Échec à la fermeture");
+    DEBUG_PLN("Échec à la fermeture");
+    break;
+  default:
+    DEBUG_PLN();
     break;
   }
 }
@@ -155,76 +681,86 @@ void Connection::update() {
 
   case INIT:
     /* Initial state after (re)boot. initialize the WiFi connection */
+    WiFi.onEvent(wifiEvent);
     WiFi.mode(WIFI_STA);
+    /* Modem sleep is required by the light sleep of the idle time */
+    WiFi.setSleep(true);
     if (sName != "") {
       WiFi.setHostname(sName.c_str());
     }
-    WiFi.begin(ssid, pass);
-    sState = WIFI_STBY;
+    seedBackoff();
+    ConnectionCache::load();
+    beginWiFi();
+    setState(WIFI_STBY);
     break;
 
   case WIFI_STBY:
     /* Do the initial connection to WiFi */
-    LOGT;
+    LOGI;
     DEBUG_P("Connexion a ");
     DEBUG_P(ssid);
     DEBUG_P(" - ");
     if (WiFi.status() != WL_CONNECTED) {
       DEBUG_PLN("echec");
-      wifiRetryer.retry();
+      if (wifiBackoff.isDue()) {
+        wifiFailed();
+        wifiBackoff.attempted();
+      }
     } else {
       DEBUG_PLN("connecte");
-      wifiRetryer.reset();
+      wifiBackoff.succeeded();
       /* Start the multicast DNS */
       if (sName != "") {
         MDNS.begin(sName.c_str());
       }
-      sState = WIFI_OK;
+      setState(WIFI_OK);
     }
     break;
 
   case OFFLINE:
-    /* Try to reconnect WiFi */
-    WiFi.disconnect();
-    DEBUG_P("Reconnexion a ");
-    DEBUG_P(ssid);
-    DEBUG_P(" - ");
-    if (WiFi.reconnect()) {
-      DEBUG_PLN("connecte");
-      wifiRetryer.reset();
-      wifiReconnectCount.retry();
-      sState = WIFI_OK;
-    } else {
-      DEBUG_PLN("echec");
-      wifiRetryer.retry();
+    if (WiFi.status() == WL_CONNECTED) {
+      /* Reconnected by the WiFi driver while waiting */
+      setState(WIFI_OK);
+    } else if (wifiBackoff.isDue()) {
+      /* Try to reconnect WiFi */
+      WiFi.disconnect();
+      LOGI;
+      DEBUG_P("Reconnexion a ");
+      DEBUG_P(ssid);
+      DEBUG_P(" - ");
+      wifiBackoff.attempted();
+      if (WiFi.reconnect()) {
+        DEBUG_PLN("connecte");
+        setState(WIFI_OK);
+      } else {
+        DEBUG_PLN("echec");
+      }
     }
     break;
 
   case WIFI_OK:
     LOGT;
     if (WiFi.status() == WL_CONNECTED) {
+      wifiBackoff.succeeded();
       /*
-       * Get the IP of the MQTT broker. If 0.0.0.0 is got, the broker was not
-       * found
+       * Get the IP of the MQTT broker from the cache or with mDNS
        */
       DEBUG_P("Broker MQTT ");
       DEBUG_P(brokerName);
       DEBUG_P(".local - ");
-      sBrokerIP = MDNS.queryHost(brokerName);
-      if (sBrokerIP != IPAddress(0, 0, 0, 0)) {
-        /* Broker responded */
-        DEBUG_PLN("trouve");
-        sClient.setServer(sBrokerIP, 1883);
-        sClient.setCallback(callback);
-        sClient.setKeepAlive(kMQTTBrokerKeepAlive);
-        sClient.setSocketTimeout(kMQTTSocketTimeout);
-        sState = MDNS_OK;
-      } else {
-        DEBUG_PLN("absent");
+      if (ConnectionCache::data().hasBroker) {
+        DEBUG_PLN("cache");
+        sBrokerIP = IPAddress(ConnectionCache::data().broker);
+        sBrokerFromCache = true;
+        setupBroker();
+        setState(MDNS_OK);
+      } else if (resolveBroker()) {
+        setState(MDNS_OK);
       }
     } else {
       DEBUG_PLN("WiFi deconnecte");
-      sState = OFFLINE;
+      wifiFailed();
+      setState(OFFLINE);
     }
     break;
 
@@ -233,50 +769,61 @@ void Connection::update() {
     if (WiFi.status() == WL_CONNECTED) {
       DEBUG_PLN("Démarrage de l'OTA");
       initOTA();
-      sState = OTA_OK;
+      setState(OTA_OK);
     } else {
       DEBUG_PLN("WiFi deconnecte");
-      sState = OFFLINE;
+      setState(OFFLINE);
     }
     break;
 
   case OTA_OK:
-    LOGT;
     if (WiFi.status() == WL_CONNECTED) {
+      if (!brokerBackoff.isDue()) {
+        break;
+      }
+      LOGI;
       DEBUG_P("Connexion au broker MQTT ");
       DEBUG_P(brokerName);
       DEBUG_P(".local (");
-      DEBUG_DO(sBrokerIP.printTo(Serial));
+      DEBUG_P(sBrokerIPString);
       DEBUG_P(") - ");
       if (!sClient.connect(sName.c_str())) {
         DEBUG_P("echec : ");
         DEBUG_PLN(sClient.state());
-        brokerMQTTRetryer.retry();
+        if (sBrokerFromCache) {
+          /* The broker may have moved, look for it again */
+          ConnectionCache::invalidateBroker();
+          resolveBroker();
+        }
+        brokerBackoff.attempted();
       } else {
         DEBUG_PLN("connecte");
-        brokerMQTTRetryer.reset();
-        mqttReconnectCount.retry();
+        brokerBackoff.succeeded();
         doSubscriptions();
-        sState = MQTT_OK;
+        storeCache();
+        setState(MQTT_OK);
       }
     } else {
+      LOGW;
       DEBUG_PLN("WiFi deconnecte");
       ArduinoOTA.end();
-      sState = OFFLINE;
+      setState(OFFLINE);
     }
     break;
 
   case MQTT_OK:
     if (WiFi.status() != WL_CONNECTED) {
-      LOGT;
+      LOGW;
       DEBUG_PLN("WiFi deconnecte");
       ArduinoOTA.end();
-      sState = OFFLINE;
+      setState(OFFLINE);
     } else if (!sClient.connected()) {
-      LOGT;
+      LOGW;
       DEBUG_P("Broker MQTT deconnecte : ");
       DEBUG_PLN(sClient.state());
-      sState = OTA_OK;
+      setState(OTA_OK);
+    } else {
+      checkLease();
     }
     break;
   }
@@ -290,22 +837,61 @@ void Connection::loop() {
 }
 
 /*------------------------------------------------------------------------------
+ * Queues a message for the network task. The message is dropped if the
+ * queue is full, if it is too large or if the connection is not up. Returns
+ * true if the message has been queued.
  */
-void Connection::publish(const String &inTopic, const String &inPayload) {
-  if (sClient.connected()) {
-    sClient.publish(inTopic.c_str(), inPayload.c_str());
-  }
+bool Connection::publish(const String &inTopic, const String &inPayload) {
+  return publish(inTopic.c_str(), (const uint8_t *)inPayload.c_str(),
+                 inPayload.length());
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool Connection::publish(const String &inTopic, const char *inPayload) {
+  return publish(inTopic.c_str(), (const uint8_t *)inPayload,
+                 strlen(inPayload));
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool Connection::publish(const String &inTopic, const uint8_t *inPayload,
+                         const size_t inLength) {
+  return publish(inTopic.c_str(), inPayload, inLength);
 }
 
 /*------------------------------------------------------------------------------
+ * Text payload, typically built by a Formatter. No String is involved.
  */
-void Connection::publish(const String &inTopic, const char *inPayload) {
-  if (sClient.connected()) {
-    sClient.publish(inTopic.c_str(), inPayload);
+bool Connection::publish(const char *inTopic, const char *inPayload,
+                         const size_t inLength) {
+  return publish(inTopic, (const uint8_t *)inPayload, inLength);
+}
+
+/*------------------------------------------------------------------------------
+ * Binary payload. The message is copied in the queue, there is no heap
+ * allocation.
+ */
+bool Connection::publish(const char *inTopic, const uint8_t *inPayload,
+                         const size_t inLength) {
+  if (isOnline()) {
+    OutgoingMessage message;
+    if (strlen(inTopic) < kMaxTopicSize &&
+        inLength <= kMaxOutgoingPayloadSize) {
+      strcpy(message.topic, inTopic);
+      message.length = inLength;
+      memcpy(message.payload, inPayload, inLength);
+      if (xQueueSend(sOutgoingQueue, &message, 0) == pdTRUE) {
+        return true;
+      }
+    }
+    sDroppedOutgoing++;
   }
+  return false;
 }
 
 /*------------------------------------------------------------------------------
+ * Called by the subscription function, in the network task.
  */
 void Connection::subscribe(const String &inTopic) {
   sClient.subscribe(inTopic.c_str());
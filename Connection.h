@@ -7,13 +7,9 @@
 #include <PubSubClient.h>
 #include <WiFi.h>
 
-/*------------------------------------------------------------------------------
- * Identifier of the setpoint message, the mode message and the IP request
- * message
- */
-extern String messageSetpoint;
-extern String messageMode;
-extern String messageRequest;
+#include "Config.h"
+#include "IncomingFilter.h"
+#include "Profile.h"
 
 class Connection {
 public:
@@ -27,21 +23,122 @@ public:
     MQTT_OK
   } State;
 
+  /*
+   * Handlers of a topic. The payload is parsed according to the handler
+   * kind before the call. A raw handler gets a view of the payload in the
+   * message slot, valid during the call only. It is also null terminated
+   * so that it can be parsed with the C functions.
+   */
+  typedef void (*TopicHandler)(const char *inPayload, const size_t inLength);
+  typedef void (*FloatHandler)(const float inValue);
+  typedef void (*IntHandler)(const int32_t inValue);
+  typedef void (*KeywordHandler)(const uint8_t inIndex);
+
 private:
   typedef void (*SubscriptionFunction)();
-  typedef void (*MessageHandlingFunction)(const String &, const String &);
+  typedef void (*MessageHandlingFunction)(const char *inTopic,
+                                          const size_t inTopicLength,
+                                          const char *inPayload,
+                                          const size_t inPayloadLength);
+
+  typedef enum { RAW, FLOAT, INT, KEYWORD } HandlerKind;
+
+  /*
+   * Entry of the topic table. An entry whose topic is empty is free.
+   */
+  typedef struct {
+    uint32_t hash;
+    char topic[kMaxTopicSize];
+    HandlerKind kind;
+    union {
+      TopicHandler raw;
+      FloatHandler floatValue;
+      IntHandler intValue;
+      KeywordHandler keyword;
+    } handler;
+    const char *const *keywords;
+    uint8_t keywordCount;
+  } TopicEntry;
+
+  /*
+   * Messages exchanged between the network task and the task calling
+   * publish() and dispatch(). The incoming messages are written once in a
+   * slot by the network task, only the index of the slot goes through the
+   * queues. The handlers read the slot in place.
+   */
+  typedef struct {
+    uint32_t hash; /* of the topic, computed by the network task */
+    uint32_t date; /* of the reception, in µs */
+    uint16_t topicLength;
+    uint16_t payloadLength;
+    char topic[kMaxTopicSize];
+    char payload[kMaxIncomingPayloadSize + 1];
+  } IncomingMessage;
+
+  typedef struct {
+    char topic[kMaxTopicSize];
+    uint16_t length;
+    uint8_t payload[kMaxOutgoingPayloadSize];
+  } OutgoingMessage;
 
   static WiFiClient sNet;
   static PubSubClient sClient;
   static IPAddress sBrokerIP;
-  static State sState;
+  static char sBrokerIPString[16];
+  static volatile State sState;
   static String sName;
   static SubscriptionFunction sSubs;
   static MessageHandlingFunction sHandler;
+  static IncomingMessage sIncomingSlots[kIncomingQueueLength];
+  static QueueHandle_t sFreeSlotQueue;
+  static QueueHandle_t sIncomingQueue;
+  static QueueHandle_t sOutgoingQueue;
+  static uint32_t sMessageDate;
+  static Profile sUpdateProfile;
+  static Profile sLoopProfile;
+  static uint32_t sDroppedIncoming;
+  static IncomingFilter sIncomingFilter;
+  static uint32_t sDroppedOutgoing;
+  static TopicEntry sTopicTable[kTopicTableSize];
+  static uint32_t sTopicCount;
+  static TaskHandle_t sTask;
+  static uint32_t sStateDate[MQTT_OK + 1];
+  static uint32_t sAttemptDate;
+  static uint32_t sBootTime;
+  static uint32_t sReconnectTime;
+  static uint32_t sOnlineCount;
+  static bool sWiFiFromCache;
+  static bool sIPFromCache;
+  static bool sBrokerFromCache;
+  static uint32_t sCachedFailureCount;
+  static uint8_t sCacheUse;
 
   Connection() {} /* prevent instanciation */
 
+  static void task(void *inParameter);
+  static void update();
+  static void evaluate();
+  static void setState(const State inState);
+  static void seedBackoff();
+  static void beginWiFi();
+  static void wifiFailed();
+  static bool resolveBroker();
+  static void setupBroker();
+  static uint32_t leaseTime();
+  static uint32_t leaseDate(const uint32_t inEpoch);
+  static void storeCache();
+  static void checkLease();
+  static void wifiEvent(arduino_event_id_t inEvent,
+                        arduino_event_info_t inInfo);
+  static void loop();
+  static void flushOutgoing();
   static void doSubscriptions();
+  static uint32_t hash(const char *inTopic);
+  static TopicEntry *addTopic(const String &inTopic, const HandlerKind inKind);
+  static const TopicEntry *findTopic(const uint32_t inHash,
+                                     const char *inTopic);
+  static void callHandler(const TopicEntry &inEntry,
+                          const IncomingMessage &inMessage);
   static void callback(char *inTopic, byte *inPayload, unsigned int inLength);
   static void startOTA();
   static void progressOTA(unsigned int progress, unsigned int total);
@@ -52,10 +149,62 @@ private:
 public:
   static void begin(String &inName, SubscriptionFunction inSubFunction = NULL, MessageHandlingFunction inHandler = NULL);
   static bool isOnline();
-  static void update();
-  static void loop();
-  static void publish(const String &inTopic, const String &inPayload);
-  static void publish(const String &inTopic, const char *inPayload);
+  /*
+   * Connection timing, in ms: from the boot to the first connection to the
+   * broker, from the loss of the connection to the last reconnection, and
+   * from the start of the last attempt to each stage.
+   */
+  static uint32_t bootTime() { return sBootTime; }
+  static uint32_t reconnectTime() { return sReconnectTime; }
+  static uint32_t onlineCount() { return sOnlineCount; }
+  static uint32_t stageTime(const State inState);
+  /* Parts of the cache used by the last connection: 1 WiFi, 2 broker */
+  static uint8_t cacheUse() { return sCacheUse; }
+  /*
+   * Profiles of the network task: update() of the state machine and loop()
+   * polling the MQTT client and the OTA, with the flush of the outgoing
+   * messages. Lowest free stack of the task, in bytes.
+   */
+  static const Profile &updateProfile() { return sUpdateProfile; }
+  static const Profile &loopProfile() { return sLoopProfile; }
+  static void resetProfiles() {
+    sUpdateProfile.reset();
+    sLoopProfile.reset();
+  }
+  static uint32_t stackHighWaterMark() {
+    return sTask != NULL ? uxTaskGetStackHighWaterMark(sTask) : 0;
+  }
+  /*
+   * Registration of the topic handlers. Must be done before begin(), the
+   * topics are subscribed automatically on each connection to the broker.
+   * Returns false if the table is full or the topic too long.
+   */
+  static bool handle(const String &inTopic, TopicHandler inHandler);
+  static bool handleFloat(const String &inTopic, FloatHandler inHandler);
+  static bool handleInt(const String &inTopic, IntHandler inHandler);
+  /* inHandler gets the index of the payload in inKeywords */
+  static bool handleKeyword(const String &inTopic,
+                            const char *const *inKeywords,
+                            const uint8_t inKeywordCount,
+                            KeywordHandler inHandler);
+  static uint32_t dispatch();
+  /* Date (Hal::micros()) of the reception of the message being dispatched */
+  static uint32_t messageDate() { return sMessageDate; }
+  /* Incoming messages dropped because the slots were all in use */
+  static uint32_t droppedIncoming() { return sDroppedIncoming; }
+  /* Incoming messages dropped because the topic or payload is too large */
+  static uint32_t oversizedIncoming() {
+    return sIncomingFilter.oversizedCount();
+  }
+  static uint32_t droppedOutgoing() { return sDroppedOutgoing; }
+  static bool publish(const String &inTopic, const String &inPayload);
+  static bool publish(const String &inTopic, const char *inPayload);
+  static bool publish(const String &inTopic, const uint8_t *inPayload,
+                      const size_t inLength);
+  static bool publish(const char *inTopic, const char *inPayload,
+                      const size_t inLength);
+  static bool publish(const char *inTopic, const uint8_t *inPayload,
+                      const size_t inLength);
   static void subscribe(const String &inTopic);
 };
 
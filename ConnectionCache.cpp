@@ -0,0 +1,107 @@
+#include "ConnectionCache.h"
+#include "Config.h"
+#include "Crc.h"
+#include "Debug.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <stddef.h>
+#include <string.h>
+
+static const uint32_t kConnectionCacheMagic = 0x32434E43; /* "CNC2" */
+static const uint8_t kLogModule = Logger::NETWORK; /* of the log messages */
+
+ConnectionCache::Data ConnectionCache::sData;
+
+/*------------------------------------------------------------------------------
+ * Copy in RTC memory, kept across a software restart
+ */
+RTC_NOINIT_ATTR static uint32_t sRTCRecord[sizeof(ConnectionCache::Data) / 4 + 3];
+
+/*------------------------------------------------------------------------------
+ */
+uint32_t ConnectionCache::crc(const Record &inRecord) {
+  return crc32(&inRecord, offsetof(Record, crc));
+}
+
+/*------------------------------------------------------------------------------
+ * Gets the cache from the RTC memory after a software restart, from the
+ * Preferences otherwise. An invalid cache is empty.
+ */
+void ConnectionCache::load() {
+  static_assert(sizeof(Record) <= sizeof(sRTCRecord), "RTC record too small");
+  Record record;
+  bool valid = false;
+  const esp_reset_reason_t reason = esp_reset_reason();
+  if (reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT) {
+    memcpy(&record, sRTCRecord, sizeof(Record));
+    valid = record.magic == kConnectionCacheMagic && record.crc == crc(record);
+  }
+  if (!valid) {
+    Preferences prefs;
+    prefs.begin(kPrefNamespaceName, true); /* Open in RO mode */
+    valid = prefs.getBytes(kConnectionCacheKey, &record, sizeof(Record)) ==
+                sizeof(Record) &&
+            record.magic == kConnectionCacheMagic &&
+            record.crc == crc(record);
+    prefs.end();
+  }
+  if (valid) {
+    sData = record.data;
+  } else {
+    memset(&sData, 0, sizeof(sData));
+  }
+  LOGI;
+  DEBUG_P("Cache connexion : ");
+  DEBUG_P(sData.hasWiFi ? "wifi " : "");
+  DEBUG_PLN(sData.hasBroker ? "broker" : "");
+}
+
+/*------------------------------------------------------------------------------
+ */
+void ConnectionCache::save(const bool inPersistent) {
+  Record &record = *(Record *)sRTCRecord;
+  memset(&record, 0, sizeof(Record));
+  record.magic = kConnectionCacheMagic;
+  record.data = sData;
+  record.crc = crc(record);
+  if (inPersistent) {
+    Preferences prefs;
+    prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
+    prefs.putBytes(kConnectionCacheKey, &record, sizeof(Record));
+    prefs.end();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Parameters of a connection that succeeded
+ */
+void ConnectionCache::store(const Data &inData) {
+  if (memcmp(&inData, &sData, sizeof(Data)) != 0) {
+    sData = inData;
+    save(true);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Up to half of the lease. An unknown date or duration is an expired lease.
+ */
+bool ConnectionCache::hasLease(const uint32_t inEpoch) {
+  return sData.hasWiFi && sData.leaseTime > 0 && sData.leaseDate > 0 &&
+         inEpoch >= sData.leaseDate &&
+         inEpoch - sData.leaseDate < sData.leaseTime / 2;
+}
+
+/*------------------------------------------------------------------------------
+ * The RTC copy is updated at once. The Preferences one will be at the next
+ * good connection, if the parameters have changed.
+ */
+void ConnectionCache::invalidateWiFi() {
+  sData.hasWiFi = false;
+  save(false);
+}
+
+void ConnectionCache::invalidateBroker() {
+  sData.hasBroker = false;
+  save(false);
+}
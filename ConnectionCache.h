@@ -0,0 +1,67 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Cache of the parameters of the last good connection.
+ *
+ * A connection without cache scans the channels to find the access point,
+ * waits for a DHCP lease and resolves the broker with mDNS. The BSSID and
+ * channel of the access point, the IP configuration and the broker address
+ * of the last good connection are kept in RTC memory and in the
+ * Preferences, and tried first. Connection falls back to the full discovery
+ * when they fail and invalidates the part of the cache that failed.
+ *
+ * The IP configuration is a DHCP lease that the node does not renew while
+ * it uses it as a static one. Its duration and date are kept with it and
+ * it is used only until half of the lease, when a DHCP client would renew
+ * it, so that the server never gives the address to another device. A
+ * lease whose date is unknown (time not set by SNTP) is not used.
+ *
+ * The Preferences are written only when the parameters change.
+ */
+
+#ifndef __CONNECTIONCACHE_H__
+#define __CONNECTIONCACHE_H__
+
+#include <stdint.h>
+
+class ConnectionCache {
+public:
+  typedef struct {
+    bool hasWiFi;
+    bool hasBroker;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t broker;
+    uint32_t leaseTime; /* s, 0 if unknown */
+    uint32_t leaseDate; /* s since 1970, 0 if unknown */
+  } Data;
+
+private:
+  typedef struct {
+    uint32_t magic;
+    Data data;
+    uint32_t crc;
+  } Record;
+
+  static Data sData;
+
+  static uint32_t crc(const Record &inRecord);
+  static void save(const bool inPersistent);
+
+  ConnectionCache() {} /* prevent instanciation */
+
+public:
+  static void load();
+  static const Data &data() { return sData; }
+  /* true if the cached IP configuration may be used at inEpoch */
+  static bool hasLease(const uint32_t inEpoch);
+  static void store(const Data &inData);
+  static void invalidateWiFi();
+  static void invalidateBroker();
+};
+
+#endif
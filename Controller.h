@@ -0,0 +1,144 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Fixed point controller of the heater.
+ *
+ * The number of slots of the PWM cycle and the gains are template
+ * parameters, the constants of the control law are computed at compile
+ * time. The computation uses Q16.16 integers only, so that it gives the same
+ * bits on the ESP32 and on the host, does not need the floating point unit
+ * and takes the same time whatever the values. Once per PWM cycle, update()
+ * takes the setpoint and the mean room temperature and returns the number of
+ * slots on:
+ *
+ *   duty = Kp.e + Ki.I - Kd.D + slots / 2, rounded, limited to [0, slots]
+ *
+ * e is the error, D the change of the mean temperature since the previous
+ * cycle and I the sum of the errors. The gains are per cycle. I is limited
+ * so that Ki.I stays within +/- slots / 2 and does not grow while the duty
+ * is saturated in the direction of the error (anti-windup).
+ */
+
+#ifndef __CONTROLLER_H__
+#define __CONTROLLER_H__
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ * Q16.16 fixed point, 1.0 is kFixedOne. The right shifts of negative values
+ * are arithmetic with GCC, on the host and on the ESP32.
+ */
+typedef int32_t Fixed;
+static const uint32_t kFixedShift = 16;
+static const Fixed kFixedOne = (Fixed)1 << kFixedShift;
+
+/* Largest magnitude that converts without overflow */
+static constexpr float kFixedMaxValue = 32767.5f;
+
+/*
+ * Nearest fixed point value, halves away from 0. The values out of range
+ * saturate and NaN gives 0, the conversion would be undefined otherwise.
+ */
+constexpr Fixed toFixed(const float inValue) {
+  return inValue != inValue            ? 0
+         : inValue >= kFixedMaxValue  ? INT32_MAX
+         : inValue <= -kFixedMaxValue ? -INT32_MAX
+         : (Fixed)(inValue * (float)kFixedOne + (inValue < 0 ? -0.5f : 0.5f));
+}
+
+constexpr float fromFixed(const Fixed inValue) {
+  return (float)inValue / (float)kFixedOne;
+}
+
+/* Product rounded to nearest, halves up */
+inline Fixed fixedMul(const Fixed inA, const Fixed inB) {
+  return (Fixed)(((int64_t)inA * inB + (kFixedOne >> 1)) >> kFixedShift);
+}
+
+/*------------------------------------------------------------------------------
+ * S is the number of slots of the PWM cycle. P, I and D are the gains in
+ * slots per °C, per °C accumulated and per °C of change, see toFixed().
+ */
+template <uint32_t S, Fixed P, Fixed I, Fixed D> class Controller {
+  static_assert(I > 0, "the integral gain bounds the integral");
+
+  /* Half of the cycle */
+  static const Fixed kOffset = (Fixed)(S << (kFixedShift - 1));
+  /* Largest integral, I.kIntegralLimit = kOffset */
+  static const Fixed kIntegralLimit =
+      (Fixed)(((int64_t)kOffset << kFixedShift) / I);
+
+  Fixed mIntegral;
+  Fixed mLastMean;
+  bool mHasLastMean; /* false until a first update or a restore */
+  Fixed mDerivative;
+  Fixed mDuty; /* before rounding and limitation */
+
+  static Fixed limit(const Fixed inValue, const Fixed inLimit) {
+    return inValue > inLimit ? inLimit : inValue < -inLimit ? -inLimit : inValue;
+  }
+
+  /* Duty before rounding */
+  Fixed dutyFor(const Fixed inError, const Fixed inIntegral) const {
+    return fixedMul(inError, P) + fixedMul(inIntegral, I) -
+           fixedMul(mDerivative, D) + kOffset;
+  }
+
+  /* Number of slots on, may be out of [0, S] */
+  static int32_t slots(const Fixed inDuty) {
+    return (inDuty + (kFixedOne >> 1)) >> kFixedShift;
+  }
+
+public:
+  /* inLastMean is saved in a checkpoint taken before the first update */
+  Controller(const Fixed inLastMean)
+      : mIntegral(0), mLastMean(inLastMean), mHasLastMean(false),
+        mDerivative(0), mDuty(0) {}
+
+  /*
+   * End of a cycle. The derivative is 0 until a previous mean temperature
+   * is known, otherwise the first cycle after a start would see a step.
+   */
+  uint32_t update(const Fixed inSetpoint, const Fixed inMean) {
+    const Fixed error = inSetpoint - inMean;
+    mDerivative = mHasLastMean ? inMean - mLastMean : 0;
+    mLastMean = inMean;
+    mHasLastMean = true;
+
+    const Fixed integral = limit(mIntegral + error, kIntegralLimit);
+    const int32_t wanted = slots(dutyFor(error, integral));
+    if (!((wanted > (int32_t)S && error > 0) || (wanted < 0 && error < 0))) {
+      mIntegral = integral;
+    }
+    return output(error);
+  }
+
+  /*
+   * Duty for a new error with the current integral and derivative, used
+   * when the setpoint changes in the middle of a cycle.
+   */
+  uint32_t output(const Fixed inError) {
+    mDuty = dutyFor(inError, mIntegral);
+    const int32_t pwm = slots(mDuty);
+    return pwm < 0 ? 0 : pwm > (int32_t)S ? S : pwm;
+  }
+
+  /* State for a checkpoint */
+  void restore(const Fixed inIntegral, const Fixed inLastMean) {
+    mIntegral = limit(inIntegral, kIntegralLimit);
+    mLastMean = inLastMean;
+    mHasLastMean = true;
+  }
+
+  void reset() {
+    mIntegral = 0;
+    mHasLastMean = false;
+  }
+
+  Fixed integral() const { return mIntegral; }
+  Fixed lastMean() const { return mLastMean; }
+  Fixed derivative() const { return mDerivative; }
+  Fixed duty() const { return mDuty; }
+};
+
+#endif
@@ -0,0 +1,26 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * CRC-32 (IEEE) of the records saved in RTC memory and in the Preferences.
+ * Computed bit by bit, the records are small and rarely written.
+ */
+
+#ifndef __CRC_H__
+#define __CRC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+inline uint32_t crc32(const void *inData, const size_t inSize) {
+  const uint8_t *bytes = (const uint8_t *)inData;
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < inSize; i++) {
+    crc ^= bytes[i];
+    for (uint32_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "DHT22Decoder.h"
+#include <math.h>
+
+/*------------------------------------------------------------------------------
+ */
+DHT22Decoder::Status DHT22Decoder::decode(const uint16_t *inHighDurations,
+                                          const size_t inCount,
+                                          float &outTemperature,
+                                          float &outHumidity) {
+  if (inCount < kBitCount) {
+    return FORMAT_ERROR;
+  }
+
+  uint8_t data[kBitCount / 8] = {0, 0, 0, 0, 0};
+  const uint16_t *bits = inHighDurations + (inCount - kBitCount);
+  for (uint32_t i = 0; i < kBitCount; i++) {
+    if (bits[i] > kMaxBitDuration) {
+      return FORMAT_ERROR;
+    }
+    data[i / 8] <<= 1;
+    data[i / 8] |= bits[i] > kOneThreshold;
+  }
+
+  if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4]) {
+    return CHECKSUM_ERROR;
+  }
+
+  outHumidity = (float)((data[0] << 8) | data[1]) * 0.1;
+  outTemperature = (float)(((data[2] & 0x7F) << 8) | data[3]) * 0.1;
+  if (data[2] & 0x80) {
+    outTemperature = -outTemperature;
+  }
+  return OK;
+}
+
+/*------------------------------------------------------------------------------
+ * Same computation as the Adafruit DHT library. The formula works in °F.
+ */
+float DHT22Decoder::heatIndex(const float inTemperature,
+                              const float inHumidity) {
+  const float t = inTemperature * 1.8 + 32.0;
+  const float h = inHumidity;
+  float hi = 0.5 * (t + 61.0 + ((t - 68.0) * 1.2) + (h * 0.094));
+
+  if (hi > 79.0) {
+    hi = -42.379 + 2.04901523 * t + 10.14333127 * h +
+         -0.22475541 * t * h +
+         -0.00683783 * t * t +
+         -0.05481717 * h * h +
+         0.00122874 * t * t * h +
+         0.00085282 * t * h * h +
+         -0.00000199 * t * t * h * h;
+
+    if ((h < 13.0) && (t >= 80.0) && (t <= 112.0)) {
+      hi -= ((13.0 - h) * 0.25) * sqrtf((17.0 - fabsf(t - 95.0)) * 0.05882);
+    } else if ((h > 85.0) && (t >= 80.0) && (t <= 87.0)) {
+      hi += ((h - 85.0) * 0.1) * ((87.0 - t) * 0.2);
+    }
+  }
+
+  return (hi - 32.0) * 0.55555;
+}
@@ -0,0 +1,46 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Decoder of the DHT22 frame.
+ *
+ * After the start signal, the DHT22 answers with a low then high 80µs pulse
+ * and sends 40 bits. Each bit is a 50µs low pulse followed by a high pulse of
+ * 26-28µs for a 0 and of 70µs for a 1. The decoder only looks at the
+ * durations of the high pulses so that it does not depend on the way they
+ * are captured (RMT peripheral on the ESP32, recorded pulse trains on the
+ * host).
+ *
+ * Bytes 0 and 1 are the humidity in 0.1 %, bytes 2 and 3 the temperature in
+ * 0.1 °C, with the sign in the most significant bit, and byte 4 is the
+ * checksum.
+ */
+
+#ifndef __DHT22DECODER_H__
+#define __DHT22DECODER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+class DHT22Decoder {
+public:
+  typedef enum { OK, CHECKSUM_ERROR, FORMAT_ERROR } Status;
+
+  static const uint32_t kBitCount = 40;
+  /* A high pulse longer than this (in µs) is a 1 */
+  static const uint16_t kOneThreshold = 48;
+  /* The high pulse of the response is longer than this (in µs) */
+  static const uint16_t kMaxBitDuration = 100;
+
+  /*
+   * Decodes the inCount durations (in µs) of the high pulses of a frame. The
+   * last 40 pulses are the bits, the ones before (the release of the line
+   * and the response) are ignored.
+   */
+  static Status decode(const uint16_t *inHighDurations, const size_t inCount,
+                       float &outTemperature, float &outHumidity);
+
+  /* Heat index in °C. See https://fr.wikipedia.org/wiki/Indice_de_chaleur */
+  static float heatIndex(const float inTemperature, const float inHumidity);
+};
+
+#endif
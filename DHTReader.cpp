@@ -0,0 +1,150 @@
+#include "DHTReader.h"
+#include "Config.h"
+#include "DHT22Decoder.h"
+#include "Hal.h"
+
+#ifdef ARDUINO
+#include <driver/gpio.h>
+#include <driver/rmt.h>
+
+static const rmt_channel_t kChannel = (rmt_channel_t)kDHTRmtChannel;
+
+/* One RMT memory block holds 64 items, each item holds 2 pulses */
+static const size_t kMaxHighPulses = 64;
+#endif
+
+/*------------------------------------------------------------------------------
+ * The acquisition starts kDHTStartDuration + kDHTCaptureDuration ms before
+ * the offset so that the sample is available at the offset.
+ */
+DHTReader::DHTReader(const uint8_t inPin, const uint32_t inOffset,
+                     const uint32_t inPeriod)
+    : TimeObject(inOffset - kDHTStartDuration - kDHTCaptureDuration),
+      mPeriod(inPeriod), mPin(inPin), mPhase(START), mValid(false),
+      mTemperature(NAN), mHumidity(NAN), mReadCount(0),
+      mChecksumErrorCount(0), mFormatErrorCount(0) {}
+
+/*------------------------------------------------------------------------------
+ * The pin is an open drain output with input enabled: the reader pulls the
+ * line low for the start signal and the RMT peripheral listens to it. The
+ * reception ends when the line stays high longer than kDHTIdleThreshold µs.
+ */
+void DHTReader::begin() {
+#ifdef ARDUINO
+  rmt_config_t config = RMT_DEFAULT_CONFIG_RX((gpio_num_t)mPin, kChannel);
+  config.clk_div = 80; /* 1 tick = 1µs */
+  config.rx_config.filter_en = true;
+  config.rx_config.filter_ticks_thresh = 10;
+  config.rx_config.idle_threshold = kDHTIdleThreshold;
+  rmt_config(&config);
+  rmt_driver_install(kChannel, 1000, 0);
+  gpio_set_direction((gpio_num_t)mPin, GPIO_MODE_INPUT_OUTPUT_OD);
+  gpio_set_pull_mode((gpio_num_t)mPin, GPIO_PULLUP_ONLY);
+  gpio_set_level((gpio_num_t)mPin, 1);
+#endif
+}
+
+/*------------------------------------------------------------------------------
+ */
+void DHTReader::execute() {
+  switch (mPhase) {
+  case START:
+    /* Start signal: the line is pulled low */
+#ifdef ARDUINO
+    gpio_set_level((gpio_num_t)mPin, 0);
+#endif
+    mNextDelay = kDHTStartDuration;
+    mPhase = CAPTURE;
+    break;
+  case CAPTURE:
+    /* The line is released and the answer of the sensor captured */
+#ifdef ARDUINO
+    rmt_rx_start(kChannel, true);
+    gpio_set_level((gpio_num_t)mPin, 1);
+#endif
+    mNextDelay = kDHTCaptureDuration;
+    mPhase = DECODE;
+    break;
+  case DECODE:
+    decode();
+    mNextDelay = mPeriod - kDHTStartDuration - kDHTCaptureDuration;
+    mPhase = START;
+    break;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Gets the captured pulses and decodes them
+ */
+void DHTReader::decode() {
+#ifdef ARDUINO
+  rmt_rx_stop(kChannel);
+  mReadCount++;
+  mValid = false;
+
+  RingbufHandle_t ringBuffer = NULL;
+  rmt_get_ringbuf_handle(kChannel, &ringBuffer);
+  size_t length = 0;
+  rmt_item32_t *items =
+      (rmt_item32_t *)xRingbufferReceive(ringBuffer, &length, 0);
+  if (items == NULL) {
+    /* No answer from the sensor */
+    mFormatErrorCount++;
+    return;
+  }
+
+  /* Collects the durations of the high pulses */
+  uint16_t highDurations[kMaxHighPulses];
+  size_t highCount = 0;
+  const size_t itemCount = length / sizeof(rmt_item32_t);
+  for (size_t i = 0; i < itemCount && highCount < kMaxHighPulses - 1; i++) {
+    if (items[i].level0 == 1 && items[i].duration0 > 0) {
+      highDurations[highCount++] = items[i].duration0;
+    }
+    if (items[i].level1 == 1 && items[i].duration1 > 0) {
+      highDurations[highCount++] = items[i].duration1;
+    }
+  }
+  vRingbufferReturnItem(ringBuffer, (void *)items);
+
+  float temperature;
+  float humidity;
+  switch (DHT22Decoder::decode(highDurations, highCount, temperature,
+                               humidity)) {
+  case DHT22Decoder::OK:
+    mTemperature = temperature;
+    mHumidity = humidity;
+    mValid = true;
+    break;
+  case DHT22Decoder::CHECKSUM_ERROR:
+    mChecksumErrorCount++;
+    break;
+  case DHT22Decoder::FORMAT_ERROR:
+    mFormatErrorCount++;
+    break;
+  }
+#else
+  mReadCount++;
+  mValid = !isnan(mTemperature) && !isnan(mHumidity);
+#endif
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool DHTReader::sample(float &outTemperature, float &outHumidity) const {
+  if (mValid) {
+    outTemperature = mTemperature;
+    outHumidity = mHumidity;
+  }
+  return mValid;
+}
+
+#ifndef ARDUINO
+/*------------------------------------------------------------------------------
+ * NAN simulates a sensor failure
+ */
+void DHTReader::simulate(const float inTemperature, const float inHumidity) {
+  mTemperature = inTemperature;
+  mHumidity = inHumidity;
+}
+#endif
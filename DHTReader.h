@@ -0,0 +1,53 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Asynchronous DHT22 reader.
+ *
+ * The Adafruit library bit-bangs the ~5ms transfer with the interrupts
+ * disabled. DHTReader is a TimeObject that sends the start signal, lets the
+ * RMT peripheral capture the answer of the sensor and decodes it later
+ * without ever blocking loop(). The last sample is kept in a mailbox read
+ * by sample().
+ *
+ * On the host, the acquisition is replaced by the values given to
+ * simulate().
+ */
+
+#ifndef __DHTREADER_H__
+#define __DHTREADER_H__
+
+#include "TimeObject.h"
+
+class DHTReader : public TimeObject {
+  typedef enum { START, CAPTURE, DECODE } Phase;
+
+  uint32_t mPeriod;
+  uint8_t mPin;
+  Phase mPhase;
+  bool mValid;
+  float mTemperature;
+  float mHumidity;
+
+  /* Statistics */
+  uint32_t mReadCount;
+  uint32_t mChecksumErrorCount;
+  uint32_t mFormatErrorCount;
+
+  virtual void execute();
+  void decode();
+
+public:
+  DHTReader(const uint8_t inPin, const uint32_t inOffset,
+            const uint32_t inPeriod);
+  void begin();
+  /* true and the values if the last acquisition succeeded */
+  bool sample(float &outTemperature, float &outHumidity) const;
+  uint32_t readCount() const { return mReadCount; }
+  uint32_t checksumErrorCount() const { return mChecksumErrorCount; }
+  uint32_t formatErrorCount() const { return mFormatErrorCount; }
+#ifndef ARDUINO
+  void simulate(const float inTemperature, const float inHumidity);
+#endif
+};
+
+#endif
@@ -1,20 +1,32 @@
 #ifndef __DEBUG_H__
 #define __DEBUG_H__
 
-void logTime();
+#include "Logger.h"
 
+/*
+ * The debug messages go to the Logger, they are written to Serial from the
+ * idle time of loop(). Each file using them defines kLogModule, the module
+ * whose level filters them. LOGT starts a debug line, LOGI, LOGW and LOGE an
+ * info, warning and error line.
+ */
 #define DEBUG
 
 #ifdef DEBUG
 #define DEBUG_DO(inst) inst
-#define DEBUG_P(mess) Serial.print(mess)
-#define DEBUG_PLN(mess) Serial.println(mess)
-#define LOGT logTime()
+#define DEBUG_P(mess) Logger::add(kLogModule, mess)
+#define DEBUG_PLN(...) Logger::end(kLogModule, ##__VA_ARGS__)
+#define LOGT Logger::start(kLogModule, Logger::LOG_DEBUG)
+#define LOGI Logger::start(kLogModule, Logger::LOG_INFO)
+#define LOGW Logger::start(kLogModule, Logger::LOG_WARNING)
+#define LOGE Logger::start(kLogModule, Logger::LOG_ERROR)
 #else
 #define DEBUG_DO(inst)
 #define DEBUG_P(mess)
-#define DEBUG_PLN(mess)
+#define DEBUG_PLN(...)
 #define LOGT
+#define LOGI
+#define LOGW
+#define LOGE
 #endif
 
-#endif
\ No newline at end of file
+#endif
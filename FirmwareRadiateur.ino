@@ -1,12 +1,69 @@
 /*==============================================================================
  * Connected heater firmware
  *
- * V 2.14
+ * V 2.37
  *
  * Jean-Luc Béchennec - January 2021
  *
  *------------------------------------------------------------------------------
  * Changelog :
+ * - 2.37 Fixed point controller with constants computed at compile time.
+ *        The integral does not grow while the duty is saturated.
+ * - 2.36 Asynchronous logger: the debug messages are written to Serial from
+ *        the idle time, with a level per module set on heater<num>/loglevel,
+ *        and can be forwarded on heater<num>/log.
+ * - 2.35 Overrun policy of the periodic actions. The heater control skips the
+ *        missed runs instead of replaying them.
+ * - 2.34 Runtime profile of the actions and of the network task, with heap,
+ *        loop rate and stacks, published on heater<num>/stats.
+ * - 2.33 The mode, setpoint and ventilation commands are applied as soon as
+ *        they are received. A large setpoint change recomputes the duty of
+ *        the current PWM cycle.
+ * - 2.32 Combined command on heater<num>/cmd, applied atomically. Its
+ *        sequence number is echoed in the status (version 2 of the binary
+ *        status).
+ * - 2.31 Fleet-wide command table on allHeaters/commands, with the groups of
+ *        the heater set by heater<num>/groups.
+ * - 2.30 Exponential backoff with jitter for the reconnections. The ESP is
+ *        restarted only when it cannot connect for 30 min.
+ * - 2.29 The access point, IP configuration and broker address of the last
+ *        good connection are cached and tried first.
+ * - 2.28 The connection state machine is driven by the WiFi events and goes
+ *        through the stages that succeed at once without waiting. The
+ *        connection times are published.
+ * - 2.27 The statuses sampled while offline are queued and replayed at a
+ *        limited rate on heater<num>/status/replay once online.
+ * - 2.26 Optional report by exception: status, temperature and ventack are
+ *        published on change beyond a deadband or as a heartbeat.
+ * - 2.25 Incoming payloads up to kMaxIncomingPayloadSize, read in place by
+ *        the handlers. Oversized messages are counted.
+ * - 2.24 The incoming messages are dispatched through a table of topic
+ *        handlers in Connection, which also does the subscriptions.
+ * - 2.23 Optional binary status on heater<num>/status/bin, selected by
+ *        heater<num>/format and kept in the Preferences.
+ * - 2.22 The publications are formatted in a fixed buffer instead of String,
+ *        no heap allocation.
+ * - 2.21 The controller state (PI, setpoint, mode, histories) is
+ *        checkpointed in RTC memory and in the Preferences and restored at
+ *        start. No derivative spike on the first cycle. The time to steady
+ *        state is published.
+ * - 2.20 Persistent history of duty, temperature and setpoint in flash at
+ *        1 min, 15 min, 1 h and 1 day resolutions, queried over MQTT. The
+ *        time is got by SNTP.
+ * - 2.19 The PWM slots are sequenced by a timer instead of loop(). The PI
+ *        computation stays in loop(). Commanded and realised duty of the
+ *        last cycle are published.
+ * - 2.18 The DHT22 is read asynchronously with the RMT peripheral instead of
+ *        the Adafruit library. Checksum and format errors are counted.
+ * - 2.17 WiFi, mDNS, OTA and MQTT run in their own task on core 0 so that a
+ *        blocking connection never delays the heater control. loop() runs
+ *        with a higher priority. Late heating slots are counted.
+ * - 2.16 loop() sleeps until the next deadline instead of busy polling.
+ *        Light sleep when available. Idle ratio and wake-up lateness are
+ *        published in the status.
+ * - 2.15 Hardware abstraction layer (Hal) for the clock and the pins so that
+ *        the core classes can be built and simulated on a host with a
+ *        virtual clock.
  * - 2.14 BitRingBuffer::loadAverage computed as float
  * - 2.13 Added temperature manual setpoint adjustement.
  * - 2.12 Switched to a 30s PWM period to reduce the temperature range of the
@@ -38,20 +95,39 @@
  *        IP.
  * - 2.0  initial version. MQTT, support of stop and comfort modes.
  */
-#include <DHT.h>
+#include <LittleFS.h>
 #include <Preferences.h>
 
+#include "Checkpoint.h"
+#include "CommandMessage.h"
+#include "CommandTable.h"
 #include "Config.h"
 #include "Connection.h"
+#include "DHTReader.h"
+#include "DHT22Decoder.h"
 #include "Debug.h"
+#include "Formatter.h"
+#include "Hal.h"
 #include "Heater.h"
+#include "HistoryStore.h"
+#include "Idle.h"
+#include "Logger.h"
+#include "OfflineQueue.h"
 #include "PeriodicAction.h"
 #include "PeriodicLED.h"
+#include "Profile.h"
+#include "ReportFilter.h"
+#include "Telemetry.h"
 #include "Timeout.h"
 
 /*------------------------------------------------------------------------------
  */
-const String version = "2.13";
+const String version = "2.37";
+
+/*------------------------------------------------------------------------------
+ * Module of the log messages of the sketch
+ */
+static const uint8_t kLogModule = Logger::MAIN;
 
 /*------------------------------------------------------------------------------
  *  Settings for connecting to the home WiFi network
@@ -79,12 +155,16 @@ PeriodicAction heaterCommandAction(
 );
 
 /*------------------------------------------------------------------------------
- * Object for heater control: microcycle of the PWM.
+ * Object for heater control: PI computation and heating history. The slots
+ * of the PWM are sequenced by a timer, see heaterSlotTick(). After a blocking
+ * call, the missed runs are skipped: the slots are pushed in the history by
+ * the next run anyway.
  */
- PeriodicAction heaterControlAction(
-   1000,
-   kHeatingSlotDuration
- );
+PeriodicAction heaterControlAction(
+  1000,
+  kHeatingSlotDuration,
+  PeriodicAction::SKIP_ALIGNED
+);
 
 /*------------------------------------------------------------------------------
  * Object for data publication. Offset of 4000.
@@ -96,26 +176,71 @@ PeriodicAction publishDataAction(
   kHeatingPeriod / kTemperatureMeasurementSlots
 );
 
+/*------------------------------------------------------------------------------
+ * Object for the persistent history. A sample every minute.
+ */
+PeriodicAction historyAction(kHistorySamplePeriod, kHistorySamplePeriod);
+
+/*------------------------------------------------------------------------------
+ * Object for answering the history queries, one chunk every 200 ms.
+ */
+PeriodicAction historyQueryAction(500, 200);
+
+/*------------------------------------------------------------------------------
+ * Objects for the checkpoint of the controller state, in RTC memory and in
+ * the Preferences.
+ */
+PeriodicAction checkpointAction(kCheckpointPeriod, kCheckpointPeriod);
+PeriodicAction persistentCheckpointAction(
+  kPersistentCheckpointPeriod,
+  kPersistentCheckpointPeriod
+);
+
+/*------------------------------------------------------------------------------
+ * Object for the replay of the statuses queued while offline
+ */
+PeriodicAction replayAction(kReplayPeriod, kReplayPeriod);
+
 /*------------------------------------------------------------------------------
  * Object for the publication of the IP. Offset of 5000, period of 6000.
  */
 PeriodicAction publishIPAction(5000, 6000);
 
 /*------------------------------------------------------------------------------
- * Object for monitoring the status of the Wifi and MQTT connection.
+ * Object for the publication of the runtime statistics
  */
-PeriodicAction controlConnectionAction(1000, 1000);
+PeriodicAction statsAction(kStatsPeriod, kStatsPeriod);
 
 /*------------------------------------------------------------------------------
- * Object for reading the DHT22
+ * Object for the publication of the log lines forwarded on MQTT
  */
-DHT dht(pinDHT22, DHT22);
+PeriodicAction logAction(kLogPublishPeriod, kLogPublishPeriod);
+
+/*------------------------------------------------------------------------------
+ * Object for reading the DHT22. The sample is ready at the same offset and
+ * with the same period as the heater command.
+ */
+DHTReader dhtReader(
+  pinDHT22,
+  1000,
+  kHeatingPeriod / kTemperatureMeasurementSlots
+);
 
 /*------------------------------------------------------------------------------
  * Object for the heater
  */
 Heater heater(pinAddr, pinStop, pinAntifreeze);
 
+/*------------------------------------------------------------------------------
+ * Persistent history in flash
+ */
+HistoryStore historyStore;
+
+/*------------------------------------------------------------------------------
+ * Statuses sampled while offline
+ */
+OfflineQueue offlineQueue;
+
 /*------------------------------------------------------------------------------
  * Object for to handle a time out from the broker
  */
@@ -141,11 +266,58 @@ float setpointOffset = 0.0;
  */
 Heater::HeaterState functioningMode = Heater::ECO;
 
+/*------------------------------------------------------------------------------
+ * true if the status is published in binary, see Telemetry
+ */
+bool binaryTelemetry = false;
+
+/*------------------------------------------------------------------------------
+ * Report by exception filters of the published messages and their fields
+ */
+ReportFilter statusFilter(kReportHeartbeat);
+ReportFilter temperatureFilter(kReportHeartbeat);
+ReportFilter ventAckFilter(kReportHeartbeat);
+
+const uint8_t statusState = statusFilter.addField(kDiscreteDeadband);
+const uint8_t statusTemperature = statusFilter.addField(kTemperatureDeadband);
+const uint8_t statusHumidity = statusFilter.addField(kHumidityDeadband);
+const uint8_t statusSetpoint = statusFilter.addField(kTemperatureDeadband);
+const uint8_t statusVentilation = statusFilter.addField(kDiscreteDeadband);
+const uint8_t statusMean = statusFilter.addField(kTemperatureDeadband);
+const uint8_t statusPWM = statusFilter.addField(kPWMDeadband);
+const uint8_t statusSequence = statusFilter.addField(kDiscreteDeadband);
+const uint8_t temperatureMean = temperatureFilter.addField(kTemperatureDeadband);
+const uint8_t ventAckVentilation = ventAckFilter.addField(kDiscreteDeadband);
+
 /*------------------------------------------------------------------------------
  * Ventilation command
  */
 bool ventilation = false;
 
+/*------------------------------------------------------------------------------
+ * Groups of the heater in the command table, comma separated
+ */
+char groups[kGroupsSize] = "";
+
+/*------------------------------------------------------------------------------
+ * Sequence number of the last heater<num>/cmd applied, echoed in the status,
+ * and number of those rejected. The status acknowledging a command is
+ * published once the command is applied.
+ */
+uint32_t commandSequence = 0;
+uint32_t rejectedCommandCount = 0;
+bool acknowledgeRequested = false;
+
+/*------------------------------------------------------------------------------
+ * Actuation of the commands when received. The latency (in µs) is measured
+ * from the reception of the first message by the network task to the pilot
+ * wire update.
+ */
+bool actuationRequested = false;
+uint32_t actuationRequestDate = 0;
+uint32_t actuationLatency = 0;
+uint32_t maxActuationLatency = 0;
+
 /*------------------------------------------------------------------------------
  * true if the publication of the IP has been requested
  */
@@ -156,60 +328,392 @@ bool IPRequested = false;
  */
 String heaterId;
 String heaterStatus;
+String heaterStatusBin;
+String heaterStatusReplay;
+String heaterConnection;
 String heaterTemperature;
 String heaterIP;
 String heaterVentAck;
+String heaterHistoryData;
+String heaterStats;
+String heaterLog;
+
+/*------------------------------------------------------------------------------
+ * Buffer for the text payloads. The publications are formatted in it
+ * without any heap allocation.
+ */
+FixedFormatter<kMaxOutgoingPayloadSize + 1> payload;
+
+/*------------------------------------------------------------------------------
+ * Report by exception counters, all messages together
+ */
+uint32_t reportSentCount() {
+  return statusFilter.sentCount() + temperatureFilter.sentCount() +
+         ventAckFilter.sentCount();
+}
+
+uint32_t reportSuppressedCount() {
+  return statusFilter.suppressedCount() + temperatureFilter.suppressedCount() +
+         ventAckFilter.suppressedCount();
+}
+
+/*------------------------------------------------------------------------------
+ * Enables or disables the report by exception
+ */
+void setReportByException(const bool inEnabled) {
+  statusFilter.setEnabled(inEnabled);
+  temperatureFilter.setEnabled(inEnabled);
+  ventAckFilter.setEnabled(inEnabled);
+}
+
+/*------------------------------------------------------------------------------
+ * Binary status, same fields as the text one
+ */
+void fillStatus(Telemetry::Status &status) {
+  status.version = Telemetry::kVersion;
+  status.state = heater.state();
+  status.ventilation = ventilation;
+  status.checkpoint = Checkpoint::source();
+  status.temperature = Telemetry::toInt16(temperature, Telemetry::kTemperatureScale);
+  status.humidity = Telemetry::toUInt16(humidity, Telemetry::kRatioScale);
+  status.heatIndex = Telemetry::toInt16(heatIndex, Telemetry::kTemperatureScale);
+  status.shortTermEnergy = Telemetry::toUInt16(heater.shortTermEnergy(), Telemetry::kRatioScale);
+  status.averageTermEnergy = Telemetry::toUInt16(heater.averageTermEnergy(), Telemetry::kRatioScale);
+  status.longTermEnergy = Telemetry::toUInt16(heater.longTermEnergy(), Telemetry::kRatioScale);
+  status.setpoint = Telemetry::toInt16(setpointTemperature + setpointOffset, Telemetry::kTemperatureScale);
+  status.meanTemperature = Telemetry::toInt16(heater.meanRoomTemperature(), Telemetry::kTemperatureScale);
+  status.derivative = Telemetry::toInt16(heater.derivative(), Telemetry::kDerivativeScale);
+  status.integralComponent = Telemetry::toInt16(heater.integralComponent(), Telemetry::kTemperatureScale);
+  status.pwm = Telemetry::toUInt16(100 * (float)heater.actualPWM() / (float)heater.pwmCycle(), Telemetry::kRatioScale);
+  status.pwmCounter = heater.pwmCounter();
+  status.reserved = 0;
+  status.idleRatio = Telemetry::toUInt16(Idle::idleRatio(), Telemetry::kRatioScale);
+  status.maxLateness = Idle::maxLateness() > UINT16_MAX ? UINT16_MAX : Idle::maxLateness();
+  status.lateSlotCount = heater.lateSlotCount();
+  status.commandedDuty = Telemetry::toUInt16(heater.commandedDuty(), Telemetry::kRatioScale);
+  status.realisedDuty = Telemetry::toUInt16(heater.realisedDuty(), Telemetry::kRatioScale);
+  status.checksumErrorCount = dhtReader.checksumErrorCount();
+  status.formatErrorCount = dhtReader.formatErrorCount();
+  status.settleTime = heater.settleTime();
+  status.commandSequence = commandSequence;
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the status in binary, same fields as the text one
+ */
+bool publishBinaryStatus() {
+  Telemetry::Status status;
+  fillStatus(status);
+  Idle::resetStats();
+  return Connection::publish(heaterStatusBin.c_str(), (const uint8_t *)&status, sizeof(status));
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the status in text
+ */
+bool publishTextStatus() {
+  payload.clear();
+  payload << heater.stringState()
+          << ',' << temperature
+          << ',' << humidity
+          << ',' << heatIndex
+          << ',' << heater.shortTermEnergy()
+          << '/' << heater.averageTermEnergy()
+          << '/' << heater.longTermEnergy()
+          << ", CON=" << setpointTemperature + setpointOffset
+          << ", VENT=" << ventilation
+          << ", MEAN=" << heater.meanRoomTemperature()
+          << ", DRV=" << heater.derivative()
+          << ", CI=" << heater.integralComponent()
+          << ", PWM=" << 100 * (float)heater.actualPWM() / (float)heater.pwmCycle()
+          << "%, CNT=" << heater.pwmCounter()
+          << ", IDLE=" << Idle::idleRatio()
+          << "%, LATE=" << Idle::maxLateness()
+          << ", LATESLOT=" << heater.lateSlotCount()
+          << ", DUTY=" << heater.commandedDuty()
+          << '/' << heater.realisedDuty()
+          << ", DHTERR=" << dhtReader.checksumErrorCount()
+          << '/' << dhtReader.formatErrorCount()
+          << ", SETTLE=" << heater.settleTime()
+          << ", CKPT=" << Checkpoint::stringSource()
+          << ", DROP=" << Connection::droppedIncoming()
+          << '/' << Connection::oversizedIncoming()
+          << '/' << Connection::droppedOutgoing()
+          << ", RBE=" << reportSentCount()
+          << '/' << reportSuppressedCount()
+          << ", OFFQ=" << offlineQueue.depth()
+          << '/' << offlineQueue.maxDepth()
+          << '/' << offlineQueue.droppedCount()
+          << '/' << offlineQueue.lastDrainTime()
+          << ", CONN=" << Connection::bootTime()
+          << '/' << Connection::reconnectTime()
+          << ", SEQ=" << commandSequence
+          << '/' << rejectedCommandCount
+          << ", ACT=" << actuationLatency
+          << '/' << maxActuationLatency
+          << '/' << heater.recomputeCount();
+  Idle::resetStats();
+  return Connection::publish(heaterStatus.c_str(), payload.c_str(), payload.length());
+}
 
 /*------------------------------------------------------------------------------
- * Identifier of the setpoint message, the mode message and the
- * request message
+ * Queues a status every kOfflineSamplePeriod while offline
  */
-String messageSetpoint;
-String messageSetpointOffset;
-String messageMode;
-String messageRequest;
-String messageOffset;
-String messageVentilation;
+void queueOfflineStatus() {
+  static uint32_t lastSampleDate = 0;
+  static bool sampled = false;
+  if (!sampled || Hal::millis() - lastSampleDate >= kOfflineSamplePeriod) {
+    sampled = true;
+    lastSampleDate = Hal::millis();
+    Telemetry::Status status;
+    fillStatus(status);
+    offlineQueue.push(status);
+  }
+}
 
 /*------------------------------------------------------------------------------
- * Publishes current values of temperature, humidity and heat index
+ * Runtime statistics. passProfile is the busy part of the loop passes, its
+ * count gives the loop rate. profileCost is the cost of a record in ns.
+ */
+Profile passProfile;
+uint32_t profileCost = 0;
+uint32_t lastPassCount = 0;
+uint32_t lastPassCountDate = 0;
+
+/*------------------------------------------------------------------------------
+ * The statistics may not fit in one message once the counters grow. They
+ * are written a field at a time in statsField, then moved to the payload.
+ * A field that does not fit in the payload starts a new part, so that each
+ * message holds whole fields. The room left for part=<n>, is kept.
+ */
+FixedFormatter<kMaxOutgoingPayloadSize - 16> statsField;
+uint32_t statsPart = 0;
+
+void beginStatsPart() {
+  payload.clear();
+  payload << "part=" << ++statsPart;
+}
+
+void addStatsField() {
+  if (statsField.overflow()) {
+    LOGW;
+    DEBUG_P("Champ de stats trop long : ");
+    DEBUG_PLN(statsField.c_str());
+  } else {
+    if (payload.length() + 1 + statsField.length() > kMaxOutgoingPayloadSize) {
+      Connection::publish(heaterStats.c_str(), payload.c_str(),
+                          payload.length());
+      beginStatsPart();
+    }
+    payload << ',' << statsField.c_str();
+  }
+  statsField.clear();
+}
+
+void addProfile(const char *inName, const Profile &inProfile) {
+  statsField << inName << '=' << inProfile.count()
+             << '/' << inProfile.meanTime()
+             << '/' << inProfile.maxTime()
+             << '/' << inProfile.maxLateness();
+  addStatsField();
+}
+
+void resetStats() {
+  TimeObject::resetProfiles();
+  Connection::resetProfiles();
+  passProfile.reset();
+  lastPassCount = 0;
+  maxActuationLatency = 0;
+}
+
+/*------------------------------------------------------------------------------
+ * Time spent in the records of the loop task relative to its busy time, in
+ * 0.01 %
+ */
+uint32_t profileOverhead() {
+  uint64_t recordCount = passProfile.count();
+  for (TimeObject *obj = TimeObject::first(); obj != NULL; obj = obj->next()) {
+    recordCount += obj->profile().count();
+  }
+  const uint64_t busyTime = passProfile.totalTime(); /* µs */
+  return busyTime > 0 ? (uint32_t)(recordCount * profileCost * 10ull / busyTime)
+                      : 0;
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the gauges of the system then, for the loop passes, the network
+ * task and each action, the number of runs, the mean and max execution time
+ * in µs and the max lateness in ms:
+ *
+ * part=1,heap=free/min,loop=passes per s,stack=loop/network,
+ * prof=ns/overhead,pass=n/mean/max/late,upd=...,net=...,<action>=...,
+ * ovr=<action>:overruns/missed;...,log=records/dropped/not forwarded
+ *
+ * When the fields do not fit in kMaxOutgoingPayloadSize, they go on in
+ * messages beginning with part=2, part=3... The last part ends with log.
+ * The profiles accumulate until heater<num>/request resetstats. The log
+ * counters are since the boot.
+ */
+void publishStats() {
+  const uint32_t currentDate = Hal::millis();
+  const uint32_t passCount = passProfile.count();
+  const uint32_t loopRate =
+      currentDate != lastPassCountDate
+          ? (uint32_t)(1000ull * (passCount - lastPassCount) /
+                       (currentDate - lastPassCountDate))
+          : 0;
+  lastPassCount = passCount;
+  lastPassCountDate = currentDate;
+  if (Connection::isOnline()) {
+    statsPart = 0;
+    beginStatsPart();
+    statsField << "heap=" << ESP.getFreeHeap() << '/' << ESP.getMinFreeHeap();
+    addStatsField();
+    statsField << "loop=" << loopRate;
+    addStatsField();
+    statsField << "stack=" << (uint32_t)uxTaskGetStackHighWaterMark(NULL)
+               << '/' << Connection::stackHighWaterMark();
+    addStatsField();
+    statsField << "prof=" << profileCost << '/' << profileOverhead();
+    addStatsField();
+    addProfile("pass", passProfile);
+    addProfile("upd", Connection::updateProfile());
+    addProfile("net", Connection::loopProfile());
+    for (TimeObject *obj = TimeObject::first(); obj != NULL; obj = obj->next()) {
+      if (obj->name() != NULL) {
+        addProfile(obj->name(), obj->profile());
+      }
+    }
+    /* Overruns, only for the objects that had some */
+    for (TimeObject *obj = TimeObject::first(); obj != NULL; obj = obj->next()) {
+      if (obj->name() != NULL && obj->overrunCount() > 0) {
+        statsField << (statsField.length() == 0 ? "ovr=" : ";") << obj->name()
+                   << ':' << obj->overrunCount() << '/' << obj->missedCount();
+      }
+    }
+    if (statsField.length() > 0) {
+      addStatsField();
+    }
+    statsField << "log=" << Logger::recordCount()
+               << '/' << Logger::droppedCount()
+               << '/' << Logger::forwardLostCount();
+    addStatsField();
+    Connection::publish(heaterStats.c_str(), payload.c_str(), payload.length());
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the log lines gathered for MQTT, see Logger::setLevels(). While
+ * offline, they are kept until the buffer is full.
+ */
+void publishLog() {
+  if (Logger::forwardLength() > 0 && Connection::isOnline()) {
+    if (Connection::publish(heaterLog.c_str(), Logger::forwardBuffer(),
+                            Logger::forwardLength())) {
+      Logger::clearForward();
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the time taken by each stage of the last connection, once per
+ * connection. Times in ms from the boot or from the loss of the connection.
+ */
+void publishConnectionTimes() {
+  static uint32_t reportedOnlineCount = 0;
+  if (Connection::onlineCount() != reportedOnlineCount) {
+    payload.clear();
+    payload << "count=" << Connection::onlineCount()
+            << ",wifi=" << Connection::stageTime(Connection::WIFI_OK)
+            << ",mdns=" << Connection::stageTime(Connection::MDNS_OK)
+            << ",ota=" << Connection::stageTime(Connection::OTA_OK)
+            << ",mqtt=" << Connection::stageTime(Connection::MQTT_OK)
+            << ",boot=" << Connection::bootTime()
+            << ",reconnect=" << Connection::reconnectTime()
+            << ",cache=" << (uint32_t)Connection::cacheUse();
+    if (Connection::publish(heaterConnection.c_str(), payload.c_str(), payload.length())) {
+      reportedOnlineCount = Connection::onlineCount();
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the status if it is due
+ */
+void publishStatus() {
+  const float pwm = 100 * (float)heater.actualPWM() / (float)heater.pwmCycle();
+  statusFilter.set(statusState, heater.state());
+  statusFilter.set(statusTemperature, temperature);
+  statusFilter.set(statusHumidity, humidity);
+  statusFilter.set(statusSetpoint, setpointTemperature + setpointOffset);
+  statusFilter.set(statusVentilation, ventilation);
+  statusFilter.set(statusMean, heater.meanRoomTemperature());
+  statusFilter.set(statusPWM, pwm);
+  statusFilter.set(statusSequence, commandSequence);
+  if (statusFilter.isDue()) {
+    const bool published = binaryTelemetry ? publishBinaryStatus()
+                                           : publishTextStatus();
+    if (published) {
+      statusFilter.reported();
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes current values of temperature, humidity and heat index. In
+ * report by exception mode, only the messages whose fields have changed or
+ * whose heartbeat has elapsed are published.
  */
 void publishData() {
   LOGT;
   if (Connection::isOnline()) {
     DEBUG_PLN("Publication des donnees !");
-    String data(heater.stringState());
-    data += ',';
-    data += temperature;
-    data += ',';
-    data += humidity;
-    data += ',';
-    data += heatIndex;
-    data += ',';
-    data += heater.shortTermEnergy();
-    data += '/';
-    data += heater.averageTermEnergy();
-    data += '/';
-    data += heater.longTermEnergy();
-    data += ", CON=";
-    data += setpointTemperature + setpointOffset;
-    data += ", VENT=";
-    data += ventilation;
-    data += ", MEAN=";
-    data += heater.meanRoomTemperature();
-    data += ", DRV=";
-    data += heater.derivative();
-    data += ", CI=";
-    data += heater.integralComponent();
-    data += ", PWM=";
-    data += 100 * (float)heater.actualPWM() / (float)heater.pwmCycle();
-    data += "%, CNT=";
-    data += heater.pwmCounter();    
-    Connection::publish(heaterStatus, data);
-    Connection::publish(heaterTemperature, String(heater.meanRoomTemperature()));
-    Connection::publish(heaterVentAck, String(ventilation ? 1 : 0));
+    publishConnectionTimes();
+    publishStatus();
+
+    temperatureFilter.set(temperatureMean, heater.meanRoomTemperature());
+    if (temperatureFilter.isDue()) {
+      payload.clear();
+      payload << heater.meanRoomTemperature();
+      if (Connection::publish(heaterTemperature.c_str(), payload.c_str(), payload.length())) {
+        temperatureFilter.reported();
+      }
+    }
+
+    ventAckFilter.set(ventAckVentilation, ventilation);
+    if (ventAckFilter.isDue()) {
+      payload.clear();
+      payload << ventilation;
+      if (Connection::publish(heaterVentAck.c_str(), payload.c_str(), payload.length())) {
+        ventAckFilter.reported();
+      }
+    }
   } else {
     DEBUG_PLN("Client deconnecte, pas de publication.");
+    queueOfflineStatus();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Replays one queued status. The replay starts kReplayStagger ms times the
+ * heater number after the connection.
+ */
+void replayStatus() {
+  static bool wasOnline = false;
+  static uint32_t onlineDate = 0;
+  if (!Connection::isOnline()) {
+    wasOnline = false;
+    return;
+  }
+  if (!wasOnline) {
+    wasOnline = true;
+    onlineDate = Hal::millis();
+  }
+  Telemetry::TimedStatus status;
+  if (Hal::millis() - onlineDate >= kReplayStagger * heater.num() &&
+      offlineQueue.front(status) &&
+      Connection::publish(heaterStatusReplay.c_str(), (const uint8_t *)&status, sizeof(status))) {
+    offlineQueue.pop();
   }
 }
 
@@ -221,7 +725,11 @@ void publishIP() {
     LOGT;
     if (Connection::isOnline()) {
       DEBUG_PLN("Publication de l'IP !");
-      Connection::publish(heaterIP, WiFi.localIP().toString());
+      const IPAddress ip = WiFi.localIP();
+      const uint8_t address[4] = { ip[0], ip[1], ip[2], ip[3] };
+      payload.clear();
+      payload.addIP(address);
+      Connection::publish(heaterIP.c_str(), payload.c_str(), payload.length());
     } else {
       DEBUG_PLN("Client deconnecte, pas de publication d'IP.");
     }
@@ -230,52 +738,165 @@ void publishIP() {
 }
 
 /*------------------------------------------------------------------------------
- * Command the heater according to the mode and temperature set point
+ * Adds a sample to the persistent history
  */
-void commandHeater() {
+void recordHistory() {
+  historyStore.add(
+    Hal::epoch(),
+    heater.recentEnergy(kHistorySamplePeriod / kHeatingSlotDuration),
+    heater.meanRoomTemperature(),
+    heater.setpoint()
+  );
+}
+
+/*------------------------------------------------------------------------------
+ * Publishes the next chunk of the current history query. A chunk that could
+ * not be queued is published again at the next call.
+ */
+void answerHistoryQuery() {
+  static uint8_t chunk[kHistoryChunkSize];
+  static size_t chunkSize = 0;
+  if (Connection::isOnline()) {
+    if (chunkSize == 0) {
+      chunkSize = historyStore.nextChunk(chunk, sizeof(chunk));
+    }
+    if (chunkSize > 0 && Connection::publish(heaterHistoryData.c_str(), chunk, chunkSize)) {
+      chunkSize = 0;
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Checkpoint of the controller state
+ */
+void fillCheckpoint(Checkpoint::Data &outData) {
+  heater.save(outData.heater);
+  outData.setpointTemperature = setpointTemperature;
+  outData.setpointOffset = setpointOffset;
+  outData.functioningMode = functioningMode;
+  historyStore.save(outData.history);
+}
+
+void saveCheckpoint() {
+  if (Checkpoint::isStale()) {
+    /* Restored before the time was known and too old */
+    heater.resetController();
+  }
+  Checkpoint::Data data;
+  fillCheckpoint(data);
+  Checkpoint::save(data);
+}
+
+void savePersistentCheckpoint() {
+  Checkpoint::Data data;
+  fillCheckpoint(data);
+  Checkpoint::savePersistent(data);
+}
+
+/*------------------------------------------------------------------------------
+ * Restores the controller state saved before the restart, if any
+ */
+void restoreCheckpoint() {
+  Checkpoint::Data data;
+  if (Checkpoint::restore(data)) {
+    heater.restore(data.heater);
+    setpointTemperature = data.setpointTemperature;
+    setpointOffset = data.setpointOffset;
+    functioningMode = (Heater::HeaterState)data.functioningMode;
+    historyStore.restore(data.history);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * true while the last sample of the DHT22 is valid
+ */
+bool sensorOk = false;
+
+/*------------------------------------------------------------------------------
+ * Applies the mode and the setpoint to the heater, with the fallbacks when
+ * the sensor or the connection is lost.
+ */
+void applyCommand() {
   if (ventilation) {
     heater.setStop();
-  } else {
-    /* reads temperature and humidity, computes heat index */
-    float t = dht.readTemperature();
-    float h = dht.readHumidity();
-    if (isnan(t) || isnan(h)) {
-      LOGT;
-      DEBUG_PLN("DHT22 off");
-      /* In case of sensor malfunction, we check the connection */
-      if (Connection::isOnline() && brokerTimeout.isNotTimedout()) {
-        /* If online, we check the functioning mode */
-        if (functioningMode != Heater::AUTO) {
-          heater.setMode(functioningMode);
-        } else {
-          /* Auto cannot be applied because the sensor is off, fallback to eco */
-          heater.setEco();
-        }
+  } else if (!sensorOk) {
+    /* In case of sensor malfunction, we check the connection */
+    if (Connection::isOnline() && brokerTimeout.isNotTimedout()) {
+      /* If online, we check the functioning mode */
+      if (functioningMode != Heater::AUTO) {
+        heater.setMode(functioningMode);
       } else {
-        /* Nothing working, fallback to echo */
+        /* Auto cannot be applied because the sensor is off, fallback to eco */
         heater.setEco();
       }
     } else {
-      LOGT;
+      /* Nothing working, fallback to echo */
+      heater.setEco();
+    }
+  } else if (Connection::isOnline() && brokerTimeout.isNotTimedout()) {
+    /* sensor and connection ok, apply the command */
+    heater.setSetpoint(setpointTemperature + setpointOffset);
+    heater.setMode(functioningMode);
+  } else {
+    /* sensor ok but connection lost, set temperature to default one */
+    heater.setSetpoint(kDefaultTemperature + setpointOffset);
+    heater.setAuto();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Command the heater according to the mode and temperature set point
+ */
+void commandHeater() {
+  if (!ventilation) {
+    /* gets the last temperature and humidity, computes heat index */
+    float t;
+    float h;
+    sensorOk = dhtReader.sample(t, h);
+    if (!sensorOk) {
+      LOGW;
+      DEBUG_PLN("DHT22 off");
+    } else {
       temperature = t + temperatureOffset;
       humidity = h;
+      LOGT;
       DEBUG_P("DHT22 ok : t = ");
       DEBUG_P(t);
       DEBUG_P(", tc = ");
       DEBUG_P(temperature);
       DEBUG_P(", h = ");
       DEBUG_PLN(humidity);
-      heatIndex = dht.computeHeatIndex(temperature, humidity, false);
+      heatIndex = DHT22Decoder::heatIndex(temperature, humidity);
       heater.setRoomTemperature(temperature);
-  
-      if (Connection::isOnline() && brokerTimeout.isNotTimedout()) {
-        /* sensor and connection ok, apply the command */
-        heater.setSetpoint(setpointTemperature + setpointOffset);
-        heater.setMode(functioningMode);
-      } else {
-        /* sensor ok but connection lost, set temperature to default one */
-        heater.setSetpoint(kDefaultTemperature + setpointOffset);
-        heater.setAuto();
+    }
+  }
+  applyCommand();
+}
+
+/*------------------------------------------------------------------------------
+ * The messages changing the command request an actuation. It is done once
+ * all the received messages have been dispatched, so that a combined
+ * command is applied as a whole, without waiting for commandHeater().
+ */
+void requestActuation() {
+  if (!actuationRequested) {
+    actuationRequested = true;
+    actuationRequestDate = Connection::messageDate();
+  }
+}
+
+void actuate() {
+  if (actuationRequested) {
+    actuationRequested = false;
+    applyCommand();
+    actuationLatency = Hal::micros() - actuationRequestDate;
+    if (actuationLatency > maxActuationLatency) {
+      maxActuationLatency = actuationLatency;
+    }
+    if (acknowledgeRequested) {
+      acknowledgeRequested = false;
+      if (Connection::isOnline()) {
+        publishStatus();
       }
     }
   }
@@ -289,93 +910,228 @@ void controlHeater() {
 }
 
 /*------------------------------------------------------------------------------
- * Handler for receiving messages from the broker
+ * Sequencing of the PWM slots, called by the timer
  */
-void messageReceived(const String &topic, const String &payload) {
+void heaterSlotTick() {
+  heater.slotTick();
+}
+
+/*------------------------------------------------------------------------------
+ * Handlers of the messages received from the broker. They are registered
+ * in setup() with the topic they handle.
+ */
+void setpointReceived(const float inSetpoint) {
+  if (inSetpoint != 0.0) {
+    LOGI;
+    DEBUG_P("Temperature de consigne = ");
+    DEBUG_PLN(inSetpoint);
+    setpointTemperature = inSetpoint;
+    requestActuation();
+  }
+}
+
+void setpointOffsetReceived(const float inOffset) {
+  LOGI;
+  DEBUG_P("Offset de consigne = ");
+  DEBUG_PLN(inOffset);
+  setpointOffset = inOffset;
+  requestActuation();
+}
+
+/*------------------------------------------------------------------------------
+ * Payloads of the mode message, in the order of Heater::HeaterState
+ */
+const char *const modeKeywords[] = { "stop", "auto", "anti", "eco" };
+const Heater::HeaterState modes[] = {
+  Heater::STOP, Heater::AUTO, Heater::ANTI, Heater::ECO
+};
+
+void modeReceived(const uint8_t inIndex) {
+  LOGI;
+  DEBUG_P("Mode ");
+  DEBUG_PLN(modeKeywords[inIndex]);
+  functioningMode = modes[inIndex];
+  requestActuation();
+}
+
+const char *const requestKeywords[] = { "IP", "resetstats" };
+
+void requestReceived(const uint8_t inIndex) {
+  LOGI;
+  if (inIndex == 0) {
+    DEBUG_PLN("Requete de l'IP");
+    IPRequested = true;
+  } else {
+    DEBUG_PLN("Remise a zero des statistiques");
+    resetStats();
+  }
+}
+
+void offsetReceived(const float inOffset) {
+  LOGI;
+  DEBUG_P("Offset temperature = ");
+  DEBUG_P(inOffset);
+  if (inOffset != temperatureOffset) {
+    DEBUG_P(", Mise a jour de l'offset");
+    temperatureOffset = inOffset;
+    prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
+    prefs.putFloat(kTemperatureOffsetKey, temperatureOffset);
+    prefs.end();
+  }
+  DEBUG_PLN();
+}
+
+/*------------------------------------------------------------------------------
+ * <level>,<from>,<to>, dates in s since 1970
+ */
+void historyRequestReceived(const char *inPayload, const size_t inLength) {
+  char *end;
+  uint32_t level = strtoul(inPayload, &end, 10);
+  if (end == inPayload || level >= HistoryStore::kLevelCount) {
+    LOGW;
+    DEBUG_P("Niveau d'historique invalide : ");
+    DEBUG_PLN(inPayload);
+    return;
+  }
+  uint32_t from = *end == ',' ? strtoul(end + 1, &end, 10) : 0;
+  uint32_t to = *end == ',' ? strtoul(end + 1, &end, 10) : UINT32_MAX;
   LOGT;
-  DEBUG_P("incoming: ");
-  DEBUG_P(topic);
-  DEBUG_P(" - ");
-  DEBUG_PLN(payload);
+  DEBUG_P("Requete d'historique, niveau ");
+  DEBUG_PLN(level);
+  historyStore.startQuery(level, from, to);
+}
 
-  /* reset the timeout */
-  brokerTimeout.timestamp();
+const char *const formatKeywords[] = { "text", "bin" };
 
-  if (topic == messageSetpoint) {
-    float t = payload.toFloat();
-    if (t != 0.0) {
-      LOGT;
-      DEBUG_P("Temperature de consigne = ");
-      DEBUG_PLN(t);
-      setpointTemperature = t;
-    }
-  } else if (topic == messageSetpointOffset) {
-    float t = payload.toFloat();
-    LOGT;
-    DEBUG_P("Offset de consigne = ");
-    DEBUG_PLN(t);
-    setpointOffset = t;
-  } else if (topic == messageMode) {
-    if (payload == "stop") {
-      LOGT;
-      DEBUG_PLN("Mode stop");
-      functioningMode = Heater::STOP;
-    } else if (payload == "auto") {
-      LOGT;
-      DEBUG_PLN("Mode auto");
-      functioningMode = Heater::AUTO;
-    } else if (payload == "anti") {
-      LOGT;
-      DEBUG_PLN("Mode antifreeze");
-      functioningMode = Heater::ANTI;
-    } else if (payload == "eco") {
-      LOGT;
-      DEBUG_PLN("Mode eco");
-      functioningMode = Heater::ECO;
-    } else {
-      LOGT;
-      DEBUG_PLN("Mode ?");
+void formatReceived(const uint8_t inIndex) {
+  binaryTelemetry = inIndex == 1;
+  LOGI;
+  DEBUG_P("Format du statut : ");
+  DEBUG_PLN(formatKeywords[inIndex]);
+  prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
+  prefs.putUChar(kTelemetryFormatKey, binaryTelemetry);
+  prefs.end();
+}
+
+const char *const reportKeywords[] = { "always", "exception" };
+
+void reportModeReceived(const uint8_t inIndex) {
+  const bool byException = inIndex == 1;
+  LOGI;
+  DEBUG_P("Mode de publication : ");
+  DEBUG_PLN(reportKeywords[inIndex]);
+  setReportByException(byException);
+  prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
+  prefs.putUChar(kReportModeKey, byException);
+  prefs.end();
+}
+
+/*------------------------------------------------------------------------------
+ * Combined command, see CommandMessage. The fields are applied in the same
+ * call so that commandHeater() sees all of them or none. A command with a
+ * sequence number is acknowledged by the status published by actuate(), once
+ * the command is applied.
+ */
+void commandReceived(const char *inPayload, const size_t inLength) {
+  CommandMessage::Command command;
+  if (!CommandMessage::parse(inPayload, inLength, modeKeywords, 4, command)) {
+    rejectedCommandCount++;
+    LOGW;
+    DEBUG_P("Commande invalide : ");
+    DEBUG_PLN(inPayload);
+    return;
+  }
+  if (command.hasSetpoint) {
+    setpointReceived(command.setpoint);
+  }
+  if (command.hasSetpointOffset) {
+    setpointOffsetReceived(command.setpointOffset);
+  }
+  if (command.mode >= 0) {
+    modeReceived(command.mode);
+  }
+  if (command.hasTemperatureOffset) {
+    offsetReceived(command.temperatureOffset);
+  }
+  if (command.hasSequence) {
+    commandSequence = command.sequence;
+    acknowledgeRequested = true;
+    requestActuation();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Command table of the fleet, see CommandTable. Only the fields of the
+ * entries selecting this heater are applied.
+ */
+void commandsReceived(const char *inPayload, const size_t inLength) {
+  CommandTable::Command command;
+  if (CommandTable::extract(inPayload, inLength, heater.num(), groups,
+                            modeKeywords, 4, command)) {
+    if (command.hasSetpoint) {
+      setpointReceived(command.setpoint);
     }
-  } else if (topic == messageRequest) {
-    if (payload == "IP") {
-      LOGT;
-      DEBUG_PLN("Requete de l'IP");
-      IPRequested = true;
+    if (command.hasOffset) {
+      setpointOffsetReceived(command.offset);
     }
-  } else if (topic == messageOffset) {
-    float o = payload.toFloat();
-    LOGT;
-    DEBUG_P("Offset temperature = ");
-    DEBUG_P(o);
-    if (o != temperatureOffset) {
-      DEBUG_P(", Mise a jour de l'offset");
-      temperatureOffset = o;
-      prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
-      prefs.putFloat(kTemperatureOffsetKey, temperatureOffset);
-      prefs.end();
+    if (command.mode >= 0) {
+      modeReceived(command.mode);
     }
-    DEBUG_PLN();
-  } else if (topic == messageVentilation) {
-    int i = payload.toInt();
-    ventilation = i == 1 ? true : false;
-    LOGT;
-    DEBUG_P("Ordre de ventilation = ");
-    DEBUG_PLN(ventilation);
   }
 }
 
+void groupsReceived(const char *inPayload, const size_t inLength) {
+  if (inLength < kGroupsSize) {
+    strcpy(groups, inPayload);
+    LOGI;
+    DEBUG_P("Groupes : ");
+    DEBUG_PLN(groups);
+    prefs.begin(kPrefNamespaceName, false); /* Open in RW mode */
+    prefs.putString(kGroupsKey, groups);
+    prefs.end();
+  }
+}
+
+void ventilationReceived(const int32_t inVentilation) {
+  ventilation = inVentilation == 1;
+  LOGI;
+  DEBUG_P("Ordre de ventilation = ");
+  DEBUG_PLN(ventilation);
+  requestActuation();
+}
+
 /*------------------------------------------------------------------------------
- * All subscriptions
+ * Levels of the log, see Logger::setLevels(). They are not kept across a
+ * restart.
  */
-void performSubscriptions() {
-  LOGT;
-  DEBUG_PLN("Souscriptions");
-  Connection::subscribe(messageSetpoint);
-  Connection::subscribe(messageMode);
-  Connection::subscribe(messageRequest);
-  Connection::subscribe(messageOffset);
-  Connection::subscribe(messageVentilation);
-  Connection::subscribe(messageSetpointOffset);
+void logLevelReceived(const char *inPayload, const size_t inLength) {
+  if (Logger::setLevels(inPayload)) {
+    LOGI;
+    DEBUG_P("Niveaux de log : ");
+  } else {
+    LOGW;
+    DEBUG_P("Niveaux de log invalides : ");
+  }
+  DEBUG_PLN(inPayload);
+}
+
+/*------------------------------------------------------------------------------
+ * Registration of the handlers, the topics are subscribed by Connection
+ */
+void registerHandlers() {
+  Connection::handleFloat(heaterId + "/setpoint", setpointReceived);
+  Connection::handleFloat(heaterId + "/spoffset", setpointOffsetReceived);
+  Connection::handleKeyword(heaterId + "/mode", modeKeywords, 4, modeReceived);
+  Connection::handleKeyword(heaterId + "/request", requestKeywords, 2, requestReceived);
+  Connection::handleFloat(heaterId + "/offset", offsetReceived);
+  Connection::handle(heaterId + "/history", historyRequestReceived);
+  Connection::handleKeyword(heaterId + "/format", formatKeywords, 2, formatReceived);
+  Connection::handleKeyword(heaterId + "/report", reportKeywords, 2, reportModeReceived);
+  Connection::handle(heaterId + "/cmd", commandReceived);
+  Connection::handle(heaterId + "/groups", groupsReceived);
+  Connection::handle(heaterId + "/loglevel", logLevelReceived);
+  Connection::handleInt("allHeaters/ventilation", ventilationReceived);
+  Connection::handle("allHeaters/commands", commandsReceived);
 }
 
 /*------------------------------------------------------------------------------
@@ -393,36 +1149,52 @@ void setup() {
   Serial.println(version);
   Serial.println("--------------------------------");
 
-  /* The heater */
+  /* The heater, with the state it had before the restart */
   heater.begin(kDefaultTemperature);
+  restoreCheckpoint();
 
   /* calculates the heater identifier and the topics of the published data */
   heaterId = String("heater") + heater.num();
   heaterStatus = heaterId + "/status";
+  heaterStatusBin = heaterId + "/status/bin";
+  heaterStatusReplay = heaterId + "/status/replay";
+  heaterConnection = heaterId + "/connection";
   heaterTemperature = heaterId + "/temperature";
   heaterIP = heaterId + "/IP";
-
-  messageSetpoint = heaterId + "/setpoint";
-  messageSetpointOffset = heaterId + "/spoffset";
-  messageMode = heaterId + "/mode";
-  messageRequest = heaterId + "/request";
-  messageOffset = heaterId + "/offset";
   heaterVentAck = heaterId + "/ventack";
+  heaterHistoryData = heaterId + "/history/data";
+  heaterStats = heaterId + "/stats";
+  heaterLog = heaterId + "/log";
 
-  messageVentilation = "allHeaters/ventilation";
+  /* Handlers of the messages received from the broker */
+  registerHandlers();
 
   /* Starts the activity LED */
   activityLED.begin(LOW);
+  activityLED.setName("led");
+  dhtReader.setName("dht");
   /* Starts of the heater command action */
-  heaterCommandAction.begin(commandHeater);
-  /* Starts oh the heater control action */
-  heaterControlAction.begin(controlHeater);
+  heaterCommandAction.begin(commandHeater, "cmd");
+  /* Starts oh the heater control action and the PWM slots timer */
+  heaterControlAction.begin(controlHeater, "ctl");
+  Hal::startTimer(kHeatingSlotDuration, heaterSlotTick);
   /* Starts the data publishing action */
-  publishDataAction.begin(publishData);
+  publishDataAction.begin(publishData, "pub");
   /* Starts the IP publishing action */
-  publishIPAction.begin(publishIP);
-  /* Starts the WiFi and MQTT connection control action */
-  controlConnectionAction.begin(Connection::update);
+  publishIPAction.begin(publishIP, "ip");
+  /* Starts the replay of the statuses queued while offline */
+  replayAction.begin(replayStatus, "rply");
+  /* Starts the history actions */
+  historyAction.begin(recordHistory, "hist");
+  historyQueryAction.begin(answerHistoryQuery, "hq");
+  /* Starts the checkpoint actions */
+  checkpointAction.begin(saveCheckpoint, "ckpt");
+  persistentCheckpointAction.begin(savePersistentCheckpoint, "pckpt");
+  /* Starts the publication of the runtime statistics */
+  profileCost = Profile::measureCost();
+  statsAction.begin(publishStats, "stats");
+  /* Starts the publication of the log lines forwarded on MQTT */
+  logAction.begin(publishLog, "log");
 
   /* Get the offset from the preferences */
   prefs.begin(kPrefNamespaceName, true); /* Open in RO mode */
@@ -430,24 +1202,53 @@ void setup() {
   LOGT;
   DEBUG_P("Pref TOff : ");
   DEBUG_PLN(temperatureOffset);
+  binaryTelemetry = prefs.getUChar(kTelemetryFormatKey, 0) != 0;
+  setReportByException(prefs.getUChar(kReportModeKey, 0) != 0);
+  prefs.getString(kGroupsKey, groups, sizeof(groups));
   prefs.end();
 
+  /* Persistent history, the partition is formatted the first time */
+  if (LittleFS.begin(true)) {
+    historyStore.begin("/littlefs");
+  }
+
   /* Start the DHT22 */
-  dht.begin();
+  dhtReader.begin();
 
-  /* Connection initialization */
-  Connection::begin(heaterId, performSubscriptions, messageReceived);
+  /* The heater control has priority over the network task */
+  vTaskPrioritySet(NULL, kControlTaskPriority);
+
+  /* Connection initialization, starts the network task */
+  Connection::begin(heaterId);
 
   /* Mark the initial time for the TimeObject.s */
   TimeObject::setup();
+
+  /* Sleep between the deadlines */
+  Idle::begin();
 }
 
 /*------------------------------------------------------------------------------
   loop
 */
 void loop() {
-  /* MQTT Client and OTA */
-  Connection::loop();
+  const uint32_t passDate = Hal::micros();
+  /* Messages received by the network task, they reset the broker timeout */
+  if (Connection::dispatch() > 0) {
+    brokerTimeout.timestamp();
+  }
+  /* The commands received are applied at once */
+  actuate();
   /* Periodic actions */
   TimeObject::loop();
+  passProfile.record(Hal::micros() - passDate);
+  /* Log lines, as far as the UART takes them */
+  Logger::drain();
+  /* Nothing to do until the next deadline or the next message */
+  uint32_t wakeUpDate = TimeObject::nextDeadline();
+  if (Logger::isPending() &&
+      (int32_t)(wakeUpDate - Hal::millis()) > (int32_t)kLogDrainPeriod) {
+    wakeUpDate = Hal::millis() + kLogDrainPeriod;
+  }
+  Idle::sleepUntil(wakeUpDate);
 }
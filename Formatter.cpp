@@ -0,0 +1,145 @@
+#include "Formatter.h"
+#include <math.h>
+
+/*------------------------------------------------------------------------------
+ */
+Formatter::Formatter(char *outBuffer, const size_t inCapacity)
+    : mBuffer(outBuffer), mCapacity(inCapacity), mLength(0),
+      mOverflow(false) {
+  if (mCapacity > 0) {
+    mBuffer[0] = '\0';
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+void Formatter::clear() {
+  mLength = 0;
+  mOverflow = false;
+  if (mCapacity > 0) {
+    mBuffer[0] = '\0';
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+Formatter &Formatter::add(const char inChar) {
+  if (mLength + 1 < mCapacity) {
+    mBuffer[mLength++] = inChar;
+    mBuffer[mLength] = '\0';
+  } else {
+    mOverflow = true;
+  }
+  return *this;
+}
+
+/*------------------------------------------------------------------------------
+ */
+Formatter &Formatter::add(const char *inString) {
+  while (*inString != '\0' && mLength + 1 < mCapacity) {
+    mBuffer[mLength++] = *inString++;
+  }
+  if (mCapacity > 0) {
+    mBuffer[mLength] = '\0';
+  }
+  if (*inString != '\0') {
+    mOverflow = true;
+  }
+  return *this;
+}
+
+/*------------------------------------------------------------------------------
+ * Digits are produced backward in a small buffer
+ */
+void Formatter::addUnsigned(uint32_t inValue) {
+  char digits[10];
+  uint32_t count = 0;
+  do {
+    digits[count++] = '0' + inValue % 10;
+    inValue /= 10;
+  } while (inValue != 0);
+  while (count > 0) {
+    add(digits[--count]);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+Formatter &Formatter::add(const uint32_t inValue) {
+  addUnsigned(inValue);
+  return *this;
+}
+
+/*------------------------------------------------------------------------------
+ */
+Formatter &Formatter::add(const int32_t inValue) {
+  if (inValue < 0) {
+    add('-');
+    addUnsigned(0u - (uint32_t)inValue);
+  } else {
+    addUnsigned(inValue);
+  }
+  return *this;
+}
+
+/*------------------------------------------------------------------------------
+ * The integer and the fractional parts are written as integers. The
+ * fractional part is scaled by 10^inDecimals and rounded, the rounding may
+ * carry to the integer part. Only single precision is used, the ESP32 has no
+ * double precision unit. inDecimals is limited to 6.
+ */
+Formatter &Formatter::add(const float inValue, uint8_t inDecimals) {
+  static const uint32_t kScale[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+  if (isnan(inValue)) {
+    return add("nan");
+  }
+  if (isinf(inValue)) {
+    return add("inf");
+  }
+  if (inDecimals > 6) {
+    inDecimals = 6;
+  }
+  float value = inValue;
+  if (value < 0.0f) {
+    value = -value;
+  }
+  /* Beyond 2^32, the integer part cannot be written */
+  if (value > 4294967040.0f) {
+    return add("ovf");
+  }
+
+  const uint32_t scale = kScale[inDecimals];
+  uint32_t integerPart = (uint32_t)value;
+  uint32_t fractionalPart =
+      (uint32_t)((value - (float)integerPart) * (float)scale + 0.5f);
+  if (fractionalPart >= scale) {
+    integerPart++;
+    fractionalPart -= scale;
+  }
+
+  if (inValue < 0.0f && (integerPart != 0 || fractionalPart != 0)) {
+    add('-');
+  }
+  addUnsigned(integerPart);
+  if (inDecimals > 0) {
+    add('.');
+    /* Leading zeros of the fractional part */
+    for (uint32_t s = scale / 10; s > 1 && fractionalPart < s; s /= 10) {
+      add('0');
+    }
+    addUnsigned(fractionalPart);
+  }
+  return *this;
+}
+
+/*------------------------------------------------------------------------------
+ */
+Formatter &Formatter::addIP(const uint8_t *inAddress) {
+  for (uint32_t i = 0; i < 4; i++) {
+    if (i > 0) {
+      add('.');
+    }
+    addUnsigned(inAddress[i]);
+  }
+  return *this;
+}
@@ -0,0 +1,61 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Text formatting in a fixed size buffer, without heap allocation and
+ * without printf.
+ *
+ * The payloads of the publications were built with String, whose buffer is
+ * reallocated at each concatenation. On a device that runs for months, this
+ * fragments the heap. A Formatter writes in a buffer given by its owner
+ * (usually static or on the stack). What does not fit is dropped and
+ * overflow() becomes true.
+ *
+ * Floats are written with a fixed number of decimals, rounded to nearest,
+ * like String and Print do: 2 decimals by default, "nan", "inf" and "ovf"
+ * for the special or too large values.
+ */
+
+#ifndef __FORMATTER_H__
+#define __FORMATTER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Formatter {
+  char *mBuffer;
+  size_t mCapacity; /* terminating null included */
+  size_t mLength;
+  bool mOverflow;
+
+  void addUnsigned(uint32_t inValue);
+
+public:
+  Formatter(char *outBuffer, const size_t inCapacity);
+  void clear();
+  Formatter &add(const char *inString);
+  Formatter &add(const char inChar);
+  Formatter &add(const uint32_t inValue);
+  Formatter &add(const int32_t inValue);
+  Formatter &add(const float inValue, const uint8_t inDecimals = 2);
+  Formatter &add(const bool inValue) { return add((uint32_t)inValue); }
+  /* Dotted notation, inAddress in network order as given by IPAddress */
+  Formatter &addIP(const uint8_t *inAddress);
+  template <typename T> Formatter &operator<<(const T inValue) {
+    return add(inValue);
+  }
+  const char *c_str() const { return mBuffer; }
+  size_t length() const { return mLength; }
+  bool overflow() const { return mOverflow; }
+};
+
+/*------------------------------------------------------------------------------
+ * Formatter with its own buffer of S bytes, terminating null included.
+ */
+template <size_t S> class FixedFormatter : public Formatter {
+  char mStorage[S];
+
+public:
+  FixedFormatter() : Formatter(mStorage, S) {}
+};
+
+#endif
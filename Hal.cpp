@@ -0,0 +1,202 @@
+#include "Hal.h"
+
+#ifdef ARDUINO
+
+#include <esp_timer.h>
+#include <soc/soc_memory_layout.h>
+#include <time.h>
+
+#include "Config.h"
+
+/*------------------------------------------------------------------------------
+ * Clock of the ESP32. The sleep waits for a task notification so that
+ * another task can wake the sleeping one up.
+ */
+static TaskHandle_t sSleepingTask = NULL;
+
+class SystemClock : public Clock {
+public:
+  virtual uint32_t millis() { return ::millis(); }
+  virtual uint32_t micros() { return ::micros(); }
+  virtual void sleep(const uint32_t inDelay) {
+    sSleepingTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(inDelay));
+  }
+};
+
+static SystemClock sSystemClock;
+Clock *Hal::sClock = &sSystemClock;
+
+/*------------------------------------------------------------------------------
+ */
+void Hal::pinMode(const uint8_t inPin, const uint8_t inMode) {
+  ::pinMode(inPin, inMode);
+}
+
+void Hal::digitalWrite(const uint8_t inPin, const uint8_t inLevel) {
+  ::digitalWrite(inPin, inLevel);
+}
+
+int Hal::digitalRead(const uint8_t inPin) { return ::digitalRead(inPin); }
+
+void Hal::restart() { ESP.restart(); }
+
+/*------------------------------------------------------------------------------
+ * The time is set by SNTP, see Connection. Before, time() returns a date
+ * close to 1970.
+ */
+uint32_t Hal::epoch() {
+  const time_t now = time(NULL);
+  return now > kMinValidEpoch ? (uint32_t)now : 0;
+}
+
+/*------------------------------------------------------------------------------
+ * The literals are in the flash mapped in the data bus (DROM).
+ */
+bool Hal::isReadOnly(const void *inAddress) {
+  return esp_ptr_in_drom(inAddress);
+}
+
+void Hal::wakeUp() {
+  if (sSleepingTask != NULL) {
+    xTaskNotifyGive(sSleepingTask);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * esp_timer is used rather than a timer group: its alarms are kept during
+ * the automatic light sleep. The callback runs in the high priority
+ * esp_timer task.
+ */
+static void timerCallback(void *inArg) { ((void (*)())inArg)(); }
+
+void Hal::startTimer(const uint32_t inPeriod, void (*inCallback)()) {
+  esp_timer_create_args_t args = {};
+  args.callback = timerCallback;
+  args.arg = (void *)inCallback;
+  args.name = "hal";
+  esp_timer_handle_t timer;
+  esp_timer_create(&args, &timer);
+  esp_timer_start_periodic(timer, 1000ull * inPeriod);
+}
+
+/*------------------------------------------------------------------------------
+ * The esp_timer task and loop() may run on different cores, a spinlock is
+ * needed.
+ */
+static portMUX_TYPE sMux = portMUX_INITIALIZER_UNLOCKED;
+
+void Hal::enterCritical() { portENTER_CRITICAL(&sMux); }
+
+void Hal::exitCritical() { portEXIT_CRITICAL(&sMux); }
+
+#else
+
+#include "TimeObject.h"
+#include <stdlib.h>
+
+HostSerial Serial;
+
+/*------------------------------------------------------------------------------
+ * On the host, the default clock is a virtual one starting at 0
+ */
+static VirtualClock sDefaultClock;
+Clock *Hal::sClock = &sDefaultClock;
+
+/*------------------------------------------------------------------------------
+ * Pins state. An input pin configured with INPUT_PULLUP reads HIGH unless the
+ * simulation has forced its level with setPinLevel.
+ */
+static uint8_t sPinLevel[Hal::kPinCount];
+static bool sPinForced[Hal::kPinCount];
+static uint32_t sRestartCount = 0;
+
+void Hal::pinMode(const uint8_t inPin, const uint8_t inMode) {
+  if (inPin < kPinCount && inMode == INPUT_PULLUP && !sPinForced[inPin]) {
+    sPinLevel[inPin] = HIGH;
+  }
+}
+
+void Hal::digitalWrite(const uint8_t inPin, const uint8_t inLevel) {
+  if (inPin < kPinCount) {
+    sPinLevel[inPin] = inLevel != LOW ? HIGH : LOW;
+  }
+}
+
+int Hal::digitalRead(const uint8_t inPin) { return pinLevel(inPin); }
+
+uint8_t Hal::pinLevel(const uint8_t inPin) {
+  return inPin < kPinCount ? sPinLevel[inPin] : LOW;
+}
+
+void Hal::setPinLevel(const uint8_t inPin, const uint8_t inLevel) {
+  if (inPin < kPinCount) {
+    sPinForced[inPin] = true;
+    sPinLevel[inPin] = inLevel != LOW ? HIGH : LOW;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * A restart is counted. The simulation decides what to do with it.
+ */
+void Hal::restart() { sRestartCount++; }
+
+/*------------------------------------------------------------------------------
+ * The virtual clock sleeps instantly, there is nothing to wake up.
+ */
+void Hal::wakeUp() {}
+
+/*------------------------------------------------------------------------------
+ * There is no portable way to tell a literal on the host, all the strings
+ * are copied.
+ */
+bool Hal::isReadOnly(const void * /* inAddress */) { return false; }
+
+/*------------------------------------------------------------------------------
+ * On the host, the timer is a TimeObject. startTimer() must be called before
+ * TimeObject::setup(), the first call happens one period after it.
+ */
+class HostTimer : public TimeObject {
+  uint32_t mPeriod;
+  void (*mCallback)();
+
+  virtual void execute() {
+    mCallback();
+    mNextDelay = mPeriod;
+  }
+
+public:
+  HostTimer(const uint32_t inPeriod, void (*inCallback)())
+      : TimeObject(inPeriod), mPeriod(inPeriod),
+        mCallback(inCallback) {}
+};
+
+void Hal::startTimer(const uint32_t inPeriod, void (*inCallback)()) {
+  new HostTimer(inPeriod, inCallback);
+}
+
+/*------------------------------------------------------------------------------
+ * Single threaded
+ */
+void Hal::enterCritical() {}
+
+void Hal::exitCritical() {}
+
+uint32_t Hal::restartCount() { return sRestartCount; }
+
+/*------------------------------------------------------------------------------
+ * The virtual epoch follows the virtual clock once set.
+ */
+static bool sEpochSet = false;
+static uint32_t sEpochOffset = 0;
+
+void Hal::setEpoch(const uint32_t inEpoch) {
+  sEpochOffset = inEpoch - Hal::millis() / 1000;
+  sEpochSet = true;
+}
+
+uint32_t Hal::epoch() {
+  return sEpochSet ? sEpochOffset + Hal::millis() / 1000 : 0;
+}
+
+#endif
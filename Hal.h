@@ -0,0 +1,132 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Hardware abstraction layer.
+ *
+ * The core classes (TimeObject, Timeout, Backoff, Heater, Logger) get the
+ * time, access the pins and use timers through Hal instead of calling
+ * millis() and digitalWrite() directly. On the ESP32, Hal forwards to the
+ * Arduino core and the ESP-IDF. On the host (ARDUINO not defined), the time
+ * is given by a VirtualClock, the pins are stored in memory and the timers
+ * are TimeObjects so that days of heater behaviour can be simulated in a few
+ * seconds.
+ */
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define LED_BUILTIN 2
+#endif
+
+/*------------------------------------------------------------------------------
+ * Clock interface. millis() and micros() have the same semantic as the
+ * Arduino ones: 32 bits counts that wrap around. sleep() suspends the caller
+ * for the given number of milliseconds or until Hal::wakeUp() is called.
+ */
+class Clock {
+public:
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+  virtual void sleep(const uint32_t inDelay) = 0;
+};
+
+/*------------------------------------------------------------------------------
+ * Clock whose date is set by the program. Used by the host simulation to
+ * jump straight to the next TimeObject deadline.
+ */
+class VirtualClock : public Clock {
+  uint32_t mDate;
+
+public:
+  VirtualClock(const uint32_t inDate = 0) : mDate(inDate) {}
+  virtual uint32_t millis() { return mDate; }
+  virtual uint32_t micros() { return mDate * 1000ul; }
+  virtual void sleep(const uint32_t inDelay) { mDate += inDelay; }
+  void set(const uint32_t inDate) { mDate = inDate; }
+  void advance(const uint32_t inDelay) { mDate += inDelay; }
+};
+
+class Hal {
+  static Clock *sClock;
+
+  Hal() {} /* prevent instanciation */
+
+public:
+  static void setClock(Clock &inClock) { sClock = &inClock; }
+  static uint32_t millis() { return sClock->millis(); }
+  static uint32_t micros() { return sClock->micros(); }
+  static void sleep(const uint32_t inDelay) { sClock->sleep(inDelay); }
+  static void wakeUp();
+  /*
+   * Calls inCallback every inPeriod ms from a context that is not delayed by
+   * loop(). Data shared with the callback are protected by a critical
+   * section.
+   */
+  static void startTimer(const uint32_t inPeriod, void (*inCallback)());
+  static void enterCritical();
+  static void exitCritical();
+  static void pinMode(const uint8_t inPin, const uint8_t inMode);
+  static void digitalWrite(const uint8_t inPin, const uint8_t inLevel);
+  static int digitalRead(const uint8_t inPin);
+  static void restart();
+  /* Seconds since 1970-01-01 or 0 if the time is not known yet */
+  static uint32_t epoch();
+  /* True if inAddress is in the flash constants, where the literals are */
+  static bool isReadOnly(const void *inAddress);
+
+#ifndef ARDUINO
+  static const uint8_t kPinCount = 40;
+
+  /* Level of an output pin or level forced on an input pin */
+  static uint8_t pinLevel(const uint8_t inPin);
+  static void setPinLevel(const uint8_t inPin, const uint8_t inLevel);
+  static uint32_t restartCount();
+  static void setEpoch(const uint32_t inEpoch);
+#endif
+};
+
+#ifndef ARDUINO
+
+/*------------------------------------------------------------------------------
+ * Stand-in for the Serial object written by the Logger. Writes on stdout.
+ */
+class HostSerial {
+public:
+  void begin(const uint32_t /* inBaudRate */) {}
+  void print(const char *inStr) { fputs(inStr, stdout); }
+  void print(const char inChar) { fputc(inChar, stdout); }
+  void print(const int inVal) { printf("%d", inVal); }
+  void print(const unsigned int inVal) { printf("%u", inVal); }
+  void print(const long inVal) { printf("%ld", inVal); }
+  void print(const unsigned long inVal) { printf("%lu", inVal); }
+  void print(const double inVal) { printf("%.2f", inVal); }
+  void println() { fputc('\n', stdout); }
+  int availableForWrite() { return 128; }
+  size_t write(const uint8_t *inData, const size_t inSize) {
+    return fwrite(inData, 1, inSize, stdout);
+  }
+  template <typename T> void println(const T inVal) {
+    print(inVal);
+    println();
+  }
+};
+
+extern HostSerial Serial;
+
+#endif
+
+#endif
@@ -1,18 +1,22 @@
 #include "Config.h"
 #include "Heater.h"
 #include "Debug.h"
-#include <Arduino.h>
+#include "Hal.h"
+
+static const uint8_t kLogModule = Logger::HEATER; /* of the log messages */
 
 /*------------------------------------------------------------------------------
  */
 Heater::Heater(const uint8_t *const inPinAddr, const uint8_t inPinStop,
                const uint8_t inPinAntifreeze)
-    : mPinStop(inPinStop), mPinAntifreeze(inPinAntifreeze),
-      mPinAddr(inPinAddr), mProportionalCoeff(kProportionalParameter), 
-      mIntegralCoeff(kIntegralParameter),
-      mDerivativeCoeff(kDerivativeParameter), mIntegralComponent(0.0), 
-      mLastMeanTemperature(kDefaultTemperature), mPWMOffset(k50PercentPWM), 
-      mPWMCycle(kHeatingSlots), mPWMCounter(0) {
+    : mController(toFixed(kDefaultTemperature)), mPWMCycle(kHeatingSlots),
+      mPWMCounter(0), mNextPWM(0), mDutyRequested(false), mPendingSlots(0),
+      mPendingSlotCount(0), mLostSlotCount(0), mRecomputeCount(0),
+      mSlotOn(false), mCycleStarted(false), mSlotDate(0), mCycleStartDate(0),
+      mCycleOnTime(0), mLastCyclePWM(0), mLastCycleOnTime(0),
+      mLastCycleDuration(0), mLateSlotCount(0), mSettledCycleCount(0),
+      mBandEntryTime(0), mSettleTime(0), mPinStop(inPinStop),
+      mPinAntifreeze(inPinAntifreeze), mPinAddr(inPinAddr) {
   setEco();
 }
 
@@ -21,12 +25,12 @@ Heater::Heater(const uint8_t *const inPinAddr, const uint8_t inPinStop,
 void Heater::readHeaterNum() {
   uint8_t num = 0;
   for (uint32_t pinIdx = 0; pinIdx < 6; pinIdx++) {
-    pinMode(mPinAddr[pinIdx], INPUT_PULLUP);
+    Hal::pinMode(mPinAddr[pinIdx], INPUT_PULLUP);
   }
   for (uint32_t pinIdx = 0; pinIdx < 6; pinIdx++) {
-    num |= (!digitalRead(mPinAddr[pinIdx])) << pinIdx;
+    num |= (!Hal::digitalRead(mPinAddr[pinIdx])) << pinIdx;
   }
-  LOGT;
+  LOGI;
   DEBUG_P("Numero radiateur : ");
   DEBUG_PLN(num);
   mNum = num;
@@ -35,26 +39,26 @@ void Heater::readHeaterNum() {
 /*------------------------------------------------------------------------------
  */
 void Heater::stop() {
-  digitalWrite(mPinAntifreeze, LOW);
-  digitalWrite(mPinStop, HIGH);
+  Hal::digitalWrite(mPinAntifreeze, LOW);
+  Hal::digitalWrite(mPinStop, HIGH);
 }
 /*------------------------------------------------------------------------------
  */
 void Heater::comfort() {
-  digitalWrite(mPinAntifreeze, LOW);
-  digitalWrite(mPinStop, LOW);
+  Hal::digitalWrite(mPinAntifreeze, LOW);
+  Hal::digitalWrite(mPinStop, LOW);
 }
 /*------------------------------------------------------------------------------
  */
 void Heater::antifreeze() {
-  digitalWrite(mPinAntifreeze, HIGH);
-  digitalWrite(mPinStop, LOW);
+  Hal::digitalWrite(mPinAntifreeze, HIGH);
+  Hal::digitalWrite(mPinStop, LOW);
 }
 /*------------------------------------------------------------------------------
  */
 void Heater::eco() {
-  digitalWrite(mPinAntifreeze, HIGH);
-  digitalWrite(mPinStop, HIGH);
+  Hal::digitalWrite(mPinAntifreeze, HIGH);
+  Hal::digitalWrite(mPinStop, HIGH);
 }
 
 /*------------------------------------------------------------------------------
@@ -62,8 +66,8 @@ void Heater::eco() {
 void Heater::begin(const float inDefaultRoomTemperature) {
   mRoomTemperature = inDefaultRoomTemperature;
   readHeaterNum();
-  pinMode(mPinStop, OUTPUT);
-  pinMode(mPinAntifreeze, OUTPUT);
+  Hal::pinMode(mPinStop, OUTPUT);
+  Hal::pinMode(mPinAntifreeze, OUTPUT);
   setEco();
 }
 
@@ -74,35 +78,52 @@ void Heater::changeStateTo(const HeaterState inState) {
     mState = inState;
     if (inState == AUTO) {
       mPWMCounter = 0;
+      mCycleStarted = false;
+      mSlotOn = false;
     }
   }
 }
 
 /*------------------------------------------------------------------------------
+ * The state and the pins are changed in a critical section so that slotTick()
+ * cannot drive the pins in between.
  */
 void Heater::setStop() {
+  Hal::enterCritical();
   changeStateTo(STOP);
   stop();
+  Hal::exitCritical();
 }
 
 /*------------------------------------------------------------------------------
+ * When switching to AUTO, the duty of the first cycle is computed
+ * immediately.
  */
 void Heater::setAuto() {
+  if (mState != AUTO) {
+    computeDuty();
+  }
+  Hal::enterCritical();
   changeStateTo(AUTO);
+  Hal::exitCritical();
 }
 
 /*------------------------------------------------------------------------------
  */
 void Heater::setAntifreeze() {
+  Hal::enterCritical();
   changeStateTo(ANTI);
   antifreeze();
+  Hal::exitCritical();
 }
 
 /*------------------------------------------------------------------------------
  */
 void Heater::setEco() {
+  Hal::enterCritical();
   changeStateTo(ECO);
   eco();
+  Hal::exitCritical();
 }
 
 /*------------------------------------------------------------------------------
@@ -128,59 +149,195 @@ void Heater::setMode(const HeaterState inMode) {
 }
 
 /*------------------------------------------------------------------------------
+ * PI computation of the duty of the next PWM cycle. Normal context.
  */
-void Heater::loop() {
+void Heater::computeDuty() {
+  const float currentTemperature = meanRoomTemperature();
+  const float error = mSetpointTemperature - currentTemperature;
+  const uint32_t pwm = mController.update(toFixed(mSetpointTemperature),
+                                          toFixed(currentTemperature));
+  mNextPWM = pwm;
+
+  /* Time to steady state, measured again each time the error leaves the band */
+  if (fabsf(error) < kSettledError) {
+    if (mSettledCycleCount == 0) {
+      mBandEntryTime = Hal::millis() / 1000;
+    }
+    mSettledCycleCount++;
+    if (mSettledCycleCount == kSettledCycles) {
+      mSettleTime = mBandEntryTime;
+      LOGI;
+      DEBUG_P("Regime etabli en ");
+      DEBUG_P(mSettleTime);
+      DEBUG_PLN(" s");
+    }
+  } else {
+    mSettledCycleCount = 0;
+    mSettleTime = 0;
+  }
+
+  LOGT;
+  DEBUG_P("PWM=");
+  DEBUG_PLN(pwm);
+}
+
+/*------------------------------------------------------------------------------
+ * A large change in AUTO recomputes the duty of the current cycle with the
+ * new error. The integral is not updated, it is at the end of the cycle.
+ * The slots already elapsed are kept, the next ones follow the new duty.
+ */
+void Heater::setSetpoint(const float inSetpoint) {
+  if (!isfinite(inSetpoint)) {
+    return;
+  }
+  const bool large =
+      fabsf(inSetpoint - mSetpointTemperature) >= kSetpointRecomputeStep;
+  mSetpointTemperature = inSetpoint;
+  if (large && mState == AUTO) {
+    const uint32_t pwm = mController.output(toFixed(mSetpointTemperature) -
+                                            toFixed(meanRoomTemperature()));
+    Hal::enterCritical();
+    mNextPWM = pwm;
+    if (mCycleStarted) {
+      mActualPWM = pwm;
+    }
+    Hal::exitCritical();
+    mRecomputeCount++;
+    LOGT;
+    DEBUG_P("PWM recalcule=");
+    DEBUG_PLN(pwm);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Sequencing of the PWM slots. Called by the timer every
+ * kHeatingSlotDuration ms. Does not use the floating point unit.
+ */
+void Heater::slotTick() {
+  Hal::enterCritical();
+  const uint32_t currentDate = Hal::micros();
+  if (mSlotDate != 0 &&
+      (currentDate - mSlotDate) >
+          1000ul * (kHeatingSlotDuration + kMaxSlotLateness)) {
+    mLateSlotCount++;
+  }
+
   if (mState == AUTO) {
+    if (mSlotOn) {
+      mCycleOnTime += currentDate - mSlotDate;
+    }
     if (mPWMCounter == 0) {
-      /* Start of a PWM cycle */
-      float currentTemperature = meanRoomTemperature();
-      float error = mSetpointTemperature - currentTemperature;
-      mIntegralComponent += error; 
-      mDerivative = currentTemperature - mLastMeanTemperature;
-      mLastMeanTemperature = currentTemperature;
-      /* 
-       * When we reach an integral component that corresponds to the dynamics
-       * of the PWM, we limit. 
-       */
-      if (abs(mIntegralComponent * mIntegralCoeff) > mPWMOffset) {
-        if (mIntegralComponent > 0) {
-          mIntegralComponent = mPWMOffset / mIntegralCoeff;
-        } else {
-          mIntegralComponent = - mPWMOffset / mIntegralCoeff;
-        }
+      /* Start of a PWM cycle, the previous one is recorded */
+      if (mCycleStarted) {
+        mLastCyclePWM = mActualPWM;
+        mLastCycleOnTime = mCycleOnTime;
+        mLastCycleDuration = currentDate - mCycleStartDate;
       }
-      
-      mPWMDuty = (error * mProportionalCoeff) +
-                 (mIntegralComponent * mIntegralCoeff) -
-                 (mDerivative * mDerivativeCoeff) +
-                 mPWMOffset + 0.5;
-      int32_t pwm = mPWMDuty;
-      if (pwm < 0) {
-        pwm = 0;
-      } else if (pwm > mPWMCycle) {
-        pwm = mPWMCycle;
-      }
-      mActualPWM = pwm;
-
+      mCycleStarted = true;
+      mCycleStartDate = currentDate;
+      mCycleOnTime = 0;
+      mActualPWM = mNextPWM;
+    }
+    if (mPWMCounter == mPWMCycle - kDutyLeadSlots) {
+      mDutyRequested = true;
     }
 
-    Serial.print("Compteur="); Serial.print(mPWMCounter); Serial.print(", PWM="); Serial.println(mActualPWM); 
-    
-    if (mPWMCounter < mActualPWM) {
+    mSlotOn = mPWMCounter < mActualPWM;
+    if (mSlotOn) {
       comfort();
-      mHistory.push(1);
     } else {
       stop();
-      mHistory.push(0);
+    }
+
+    /* The slot is handed to loop() for the history */
+    if (mPendingSlotCount < 32) {
+      mPendingSlots |= (uint32_t)mSlotOn << mPendingSlotCount;
+      mPendingSlotCount++;
+    } else {
+      mLostSlotCount++;
     }
 
     mPWMCounter = (mPWMCounter >= (mPWMCycle - 1)) ? 0 : mPWMCounter + 1;
   }
+  mSlotDate = currentDate;
+  Hal::exitCritical();
+}
+
+/*------------------------------------------------------------------------------
+ * Normal context part of the PWM: PI computation when requested by
+ * slotTick() and update of the heating history.
+ */
+void Heater::loop() {
+  if (mDutyRequested) {
+    mDutyRequested = false;
+    computeDuty();
+  }
+
+  Hal::enterCritical();
+  const uint32_t slots = mPendingSlots;
+  const uint32_t slotCount = mPendingSlotCount;
+  mPendingSlots = 0;
+  mPendingSlotCount = 0;
+  Hal::exitCritical();
+
+  for (uint32_t i = 0; i < slotCount; i++) {
+    mHistory.push((slots >> i) & 1);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Checkpoint of the controller state
+ */
+void Heater::save(Snapshot &outSnapshot) {
+  outSnapshot.setpointTemperature = mSetpointTemperature;
+  outSnapshot.integralComponent = fromFixed(mController.integral());
+  outSnapshot.lastMeanTemperature = fromFixed(mController.lastMean());
+  tempHistory.save(outSnapshot.temperatureHistory);
+  mHistory.save(outSnapshot.heatingHistory);
+}
+
+/*------------------------------------------------------------------------------
+ * Restores a checkpoint. Must be called after begin() and before the first
+ * room temperature is set.
+ */
+void Heater::restore(const Snapshot &inSnapshot) {
+  mSetpointTemperature = inSnapshot.setpointTemperature;
+  mController.restore(toFixed(inSnapshot.integralComponent),
+                      toFixed(inSnapshot.lastMeanTemperature));
+  tempHistory.restore(inSnapshot.temperatureHistory);
+  mHistory.restore(inSnapshot.heatingHistory);
+  mRoomTemperature = tempHistory.mean();
+}
+
+/*------------------------------------------------------------------------------
+ * Forgets a restored controller state that turned out to be too old
+ */
+void Heater::resetController() {
+  mController.reset();
+}
+
+/*------------------------------------------------------------------------------
+ * Commanded and realised duty (in %) of the last complete PWM cycle
+ */
+float Heater::commandedDuty() {
+  return 100.0 * (float)mLastCyclePWM / (float)mPWMCycle;
+}
+
+float Heater::realisedDuty() {
+  Hal::enterCritical();
+  const uint32_t onTime = mLastCycleOnTime;
+  const uint32_t duration = mLastCycleDuration;
+  Hal::exitCritical();
+  if (duration > 0) {
+    return 100.0 * (float)onTime / (float)duration;
+  } else {
+    return 0.0;
+  }
 }
 
 /*------------------------------------------------------------------------------
  */
-const char *const Heater::stringState() const {
+const char *Heater::stringState() const {
   switch (mState) {
   case STOP:
     return "stop";
@@ -5,21 +5,51 @@
  * - storage of the state of the heater.
  * - storage of the cumulated time spent in each state (in ms on 64 bits)
  * - % of time spent in comfort mode.
+ *
+ * The PWM slots are sequenced by slotTick(), called by a timer every
+ * kHeatingSlotDuration ms. The PI computation, which needs the temperature
+ * history, is done by loop() in normal context with a fixed point
+ * Controller: slotTick() requests it kDutyLeadSlots slots before the end of the
+ * cycle and takes the result at the start of the next one. The slots states
+ * are handed to loop() which pushes them in the heating history. A large
+ * setpoint change recomputes the duty of the current cycle, it applies from
+ * the next slot.
+ *
+ * The state of the controller can be saved in a Snapshot and restored after
+ * a restart, see Checkpoint.
  */
 
 #ifndef __HEATER_H__
 #define __HEATER_H__
 
 #include "BitRingBuf.h"
+#include "Config.h"
+#include "Controller.h"
 #include "TemperatureHistory.h"
 #include "HeatingHistory.h"
-#include <WString.h>
+#include <math.h>
 #include <stdint.h>
 
+/*------------------------------------------------------------------------------
+ * Control law of the heater, the gains are converted at compile time
+ */
+typedef Controller<kHeatingSlots, toFixed(kProportionalParameter),
+                   toFixed(kIntegralParameter), toFixed(kDerivativeParameter)>
+    HeaterController;
+
 class Heater {
 public:
   typedef enum { STOP, AUTO, ANTI, ECO } HeaterState;
 
+  /* State of the controller for a checkpoint */
+  typedef struct {
+    float setpointTemperature;
+    float integralComponent;
+    float lastMeanTemperature;
+    TemperatureHistory::Snapshot temperatureHistory;
+    HeatingHistory::Snapshot heatingHistory;
+  } Snapshot;
+
 private:
   /* mHistory stores the satisfaction history of the setpoint */
   HeatingHistory mHistory;
@@ -30,29 +60,45 @@ private:
   float mSetpointTemperature;
   TemperatureHistory tempHistory;
 
-  float mProportionalCoeff;
-  float mIntegralCoeff;
-  float mDerivativeCoeff;
-  float mIntegralComponent;
-  float mLastMeanTemperature;
-  float mDerivative;
-  float mPWMDuty;
-  float mPWMOffset;
+  HeaterController mController;
 
   uint32_t mActualPWM;
   uint32_t mPWMCycle;
   uint32_t mPWMCounter;
 
+  /* Shared between slotTick() and loop() */
+  volatile uint32_t mNextPWM;
+  volatile bool mDutyRequested;
+  uint32_t mPendingSlots; /* oldest slot in bit 0 */
+  uint32_t mPendingSlotCount;
+  uint32_t mLostSlotCount;
+  uint32_t mRecomputeCount;
+
+  /* Realised duty instrumentation, dates in µs */
+  bool mSlotOn;
+  bool mCycleStarted;
+  uint32_t mSlotDate;
+  uint32_t mCycleStartDate;
+  uint32_t mCycleOnTime;
+  uint32_t mLastCyclePWM;
+  uint32_t mLastCycleOnTime;
+  uint32_t mLastCycleDuration;
+  uint32_t mLateSlotCount;
+
+  /* Time to steady state */
+  uint32_t mSettledCycleCount;
+  uint32_t mBandEntryTime;
+  uint32_t mSettleTime;
+
   /* Pins */
   uint8_t mPinStop;
   uint8_t mPinAntifreeze;
   const uint8_t *const mPinAddr;
   /* Heater Num */
   uint8_t mNum;
-  /* Heater Id */
-  String mId;
 
   void changeStateTo(const HeaterState inState);
+  void computeDuty();
   void readHeaterNum();
   void stop();
   void comfort();
@@ -68,28 +114,47 @@ public:
   void setAntifreeze();
   void setEco();
   void setMode(const HeaterState inMode);
-  void setSetpoint(const float inSetpoint) {
-    mSetpointTemperature = inSetpoint;
-  }
+  void setSetpoint(const float inSetpoint);
+  float setpoint() const { return mSetpointTemperature; }
   void setRoomTemperature(const float inRoomTemperature) {
+    if (!isfinite(inRoomTemperature)) {
+      return;
+    }
     mRoomTemperature = inRoomTemperature;
     tempHistory.add(inRoomTemperature);
   }
+  void slotTick();
   void loop();
+  void save(Snapshot &outSnapshot);
+  void restore(const Snapshot &inSnapshot);
+  void resetController();
   uint32_t num() const        { return mNum; }
-  const String &id() const    { return mId; }
   HeaterState state() const   { return mState; }
-  float pwmDuty()             { return mPWMDuty; }
-  float integralComponent()   { return mIntegralComponent; }
+  float pwmDuty()             { return fromFixed(mController.duty()); }
+  float integralComponent()   { return fromFixed(mController.integral()); }
   uint32_t actualPWM()        { return mActualPWM; }
   uint32_t pwmCounter()       { return mPWMCounter; }
   uint32_t pwmCycle()         { return mPWMCycle; }
+  uint32_t lateSlotCount()    { return mLateSlotCount; }
+  uint32_t lostSlotCount()    { return mLostSlotCount; }
+  /* Duties recomputed in the middle of a cycle by a setpoint change */
+  uint32_t recomputeCount()   { return mRecomputeCount; }
+  /*
+   * Uptime (in s) when the error entered the kSettledError band, once it has
+   * stayed in it kSettledCycles cycles. 0 if not settled.
+   */
+  uint32_t settleTime()       { return mSettleTime; }
+  float commandedDuty();
+  float realisedDuty();
   float meanRoomTemperature() { return tempHistory.mean(); }
-  float derivative()          { return mDerivative; }
+  float derivative()          { return fromFixed(mController.derivative()); }
   float shortTermEnergy()     { return mHistory.shortTermEnergy(); }
+  float recentEnergy(const uint32_t inSlotCount) {
+    return mHistory.recentEnergy(inSlotCount);
+  }
   float averageTermEnergy()   { return mHistory.averageTermEnergy(); }
   float longTermEnergy()      { return mHistory.longTermEnergy(); }
-  const char *const stringState() const;
+  const char *stringState() const;
 };
 
 #endif
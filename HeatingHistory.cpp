@@ -56,6 +56,14 @@ float HeatingHistory::shortTermEnergy() const
   return mShortTermHistory.loadAverage();
 }
 
+/*------------------------------------------------------------------------------
+ * Energy over the inSlotCount last slots
+ */
+float HeatingHistory::recentEnergy(const uint32_t inSlotCount) const
+{
+  return mShortTermHistory.loadAverage(inSlotCount);
+}
+
 float HeatingHistory::averageTermEnergy() 
 {
   if (mAverageTermHistory.isEmpty()) {
@@ -74,3 +82,39 @@ float HeatingHistory::longTermEnergy()
   }
 
 }
+
+/*------------------------------------------------------------------------------
+ * Checkpoint
+ */
+void HeatingHistory::save(Snapshot &outSnapshot)
+{
+  outSnapshot.shortTermHistory = mShortTermHistory;
+  outSnapshot.shortTermCounter = mShortTermCounter;
+  outSnapshot.averageTermCounter = mAverageTermCounter;
+  outSnapshot.averageTermCount = mAverageTermHistory.size();
+  for (uint32_t i = 0; i < outSnapshot.averageTermCount; i++) {
+    outSnapshot.averageTermHistory[i] = mAverageTermHistory[i];
+  }
+  outSnapshot.longTermCount = mLongTermHistory.size();
+  for (uint32_t i = 0; i < outSnapshot.longTermCount; i++) {
+    outSnapshot.longTermHistory[i] = mLongTermHistory[i];
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Must be called on an empty history
+ */
+void HeatingHistory::restore(const Snapshot &inSnapshot)
+{
+  mShortTermHistory = inSnapshot.shortTermHistory;
+  mShortTermCounter = inSnapshot.shortTermCounter % kShortTermSize;
+  mAverageTermCounter = inSnapshot.averageTermCounter % kAverageTermSize;
+  for (uint32_t i = 0; i < inSnapshot.averageTermCount && i < kAverageTermSize; i++) {
+    mAverageTermHistory.push(inSnapshot.averageTermHistory[i]);
+    mAverageTermSum += inSnapshot.averageTermHistory[i];
+  }
+  for (uint32_t i = 0; i < inSnapshot.longTermCount && i < kLongTermSize; i++) {
+    mLongTermHistory.push(inSnapshot.longTermHistory[i]);
+    mLongTermSum += inSnapshot.longTermHistory[i];
+  }
+}
@@ -1,7 +1,7 @@
 #ifndef __HEATINGHISTORY_H__
 #define __HEATINGHISTORY_H__
 
-#include "config.h"
+#include "Config.h"
 #include "BitRingBuf.h"
 #include "RingBuf.h"
 
@@ -29,9 +29,23 @@ class HeatingHistory {
     float mLongTermSum;
 
   public:
+    /* Content of the history for a checkpoint, oldest first */
+    typedef struct {
+      BitRingBuf<kShortTermSize> shortTermHistory;
+      uint32_t shortTermCounter;
+      uint32_t averageTermCounter;
+      uint32_t averageTermCount;
+      uint32_t longTermCount;
+      float averageTermHistory[kAverageTermSize];
+      float longTermHistory[kLongTermSize];
+    } Snapshot;
+
     HeatingHistory();
     void push(const uint32_t inBit);
+    void save(Snapshot &outSnapshot);
+    void restore(const Snapshot &inSnapshot);
     float shortTermEnergy() const;
+    float recentEnergy(const uint32_t inSlotCount) const;
     float averageTermEnergy();
     float longTermEnergy();
 };
@@ -0,0 +1,304 @@
+#include "HistoryStore.h"
+#include "Debug.h"
+#include "Hal.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ * Period (in s) and number of records of each level
+ */
+const uint32_t HistoryStore::kPeriod[kLevelCount] = {60ul, 900ul, 3600ul,
+                                                     86400ul};
+const uint16_t HistoryStore::kCapacity[kLevelCount] = {1440, 1344, 2232, 731};
+
+static const uint32_t kHistoryMagic = 0x31545348; /* "HST1" */
+static const uint8_t kLogModule = Logger::STORAGE; /* of the log messages */
+
+/*------------------------------------------------------------------------------
+ * °C to rounded hundredths of °C
+ */
+static int16_t toCenti(const float inValue) {
+  return (int16_t)(inValue * 100.0 + (inValue < 0 ? -0.5 : 0.5));
+}
+
+/*------------------------------------------------------------------------------
+ */
+HistoryStore::HistoryStore()
+    : mBasePath(""), mReady(false), mPendingCount(0), mQueryActive(false),
+      mQueryLevel(0), mQueryFrom(0), mQueryTo(0), mQueryPosition(0),
+      mFlushCount(0), mWrittenCount(0), mDroppedCount(0) {
+  memset(mAccumulator, 0, sizeof(mAccumulator));
+  memset(mHeader, 0, sizeof(mHeader));
+}
+
+/*------------------------------------------------------------------------------
+ */
+void HistoryStore::fileName(const uint8_t inLevel, char *outName,
+                            const size_t inSize) {
+  snprintf(outName, inSize, "%s/hist%u.bin", mBasePath, inLevel);
+}
+
+/*------------------------------------------------------------------------------
+ * Reads the header of a level file, creates the file if it does not exist
+ * or if it does not match the current layout.
+ */
+bool HistoryStore::openLevel(const uint8_t inLevel) {
+  char name[48];
+  fileName(inLevel, name, sizeof(name));
+  FileHeader &header = mHeader[inLevel];
+
+  FILE *file = fopen(name, "rb");
+  if (file != NULL) {
+    const bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    if (ok && header.magic == kHistoryMagic && header.level == inLevel &&
+        header.capacity == kCapacity[inLevel] &&
+        header.head < header.capacity && header.count <= header.capacity) {
+      return true;
+    }
+  }
+
+  header.magic = kHistoryMagic;
+  header.level = inLevel;
+  header.capacity = kCapacity[inLevel];
+  header.head = 0;
+  header.count = 0;
+  file = fopen(name, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  const bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  fclose(file);
+  return ok;
+}
+
+/*------------------------------------------------------------------------------
+ * inBasePath is the directory of the files, where LittleFS is mounted on the
+ * ESP32.
+ */
+bool HistoryStore::begin(const char *inBasePath) {
+  mBasePath = inBasePath;
+  mReady = true;
+  for (uint8_t level = 0; level < kLevelCount; level++) {
+    mReady = openLevel(level) && mReady;
+  }
+  LOGI;
+  DEBUG_P("Historique : ");
+  DEBUG_PLN(mReady ? "ok" : "echec");
+  return mReady;
+}
+
+/*------------------------------------------------------------------------------
+ * Adds a 1 min sample. inDuty is in %, temperatures in °C.
+ */
+void HistoryStore::add(const uint32_t inDate, const float inDuty,
+                       const float inTemperature, const float inSetpoint) {
+  if (inDate != 0) {
+    feed(0, inDate, inDuty, inTemperature, inSetpoint, 1);
+    if (mPendingCount >= kHistoryFlushThreshold) {
+      flush();
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Accumulates in a level. When the period of the level changes, the
+ * accumulated values are closed into a record.
+ */
+void HistoryStore::feed(const uint8_t inLevel, const uint32_t inDate,
+                        const float inDuty, const float inTemperature,
+                        const float inSetpoint, const uint32_t inCount) {
+  Accumulator &acc = mAccumulator[inLevel];
+  const uint32_t date = inDate - inDate % kPeriod[inLevel];
+  if (acc.count > 0 && date != acc.date) {
+    close(inLevel);
+  }
+  if (acc.count == 0) {
+    acc.date = date;
+  }
+  acc.dutySum += inDuty * inCount;
+  acc.temperatureSum += inTemperature * inCount;
+  acc.setpointSum += inSetpoint * inCount;
+  acc.count += inCount;
+}
+
+/*------------------------------------------------------------------------------
+ * Makes a record from an accumulator, queues it for writing and feeds the
+ * next level with it.
+ */
+void HistoryStore::close(const uint8_t inLevel) {
+  Accumulator &acc = mAccumulator[inLevel];
+  const float duty = acc.dutySum / acc.count;
+  const float temperature = acc.temperatureSum / acc.count;
+  const float setpoint = acc.setpointSum / acc.count;
+
+  if (mPendingCount == kHistoryPendingSize) {
+    /* The flash could not be written, the oldest record is lost */
+    memmove(&mPending[0], &mPending[1],
+            (kHistoryPendingSize - 1) * sizeof(PendingRecord));
+    mPendingCount--;
+    mDroppedCount++;
+  }
+  PendingRecord &pending = mPending[mPendingCount++];
+  pending.level = inLevel;
+  pending.record.date = acc.date;
+  pending.record.duty = (uint16_t)(duty * 10.0 + 0.5);
+  pending.record.temperature = toCenti(temperature);
+  pending.record.setpoint = toCenti(setpoint);
+  pending.record.count = acc.count > UINT16_MAX ? UINT16_MAX : acc.count;
+
+  if ((uint32_t)inLevel + 1 < kLevelCount) {
+    feed(inLevel + 1, acc.date, duty, temperature, setpoint, acc.count);
+  }
+  memset(&acc, 0, sizeof(acc));
+}
+
+/*------------------------------------------------------------------------------
+ * Writes the pending records, one file opening per level. A record written
+ * is marked with an invalid level. The ones that could not be written stay
+ * pending.
+ */
+void HistoryStore::flush() {
+  if (!mReady || mPendingCount == 0) {
+    return;
+  }
+  bool ok = true;
+  for (uint8_t level = 0; level < kLevelCount; level++) {
+    FileHeader &header = mHeader[level];
+    FILE *file = NULL;
+    for (uint32_t i = 0; i < mPendingCount; i++) {
+      if (mPending[i].level != level) {
+        continue;
+      }
+      if (file == NULL) {
+        char name[48];
+        fileName(level, name, sizeof(name));
+        file = fopen(name, "r+b");
+        if (file == NULL) {
+          ok = false;
+          break;
+        }
+      }
+      fseek(file, sizeof(FileHeader) + header.head * sizeof(Record), SEEK_SET);
+      if (fwrite(&mPending[i].record, sizeof(Record), 1, file) != 1) {
+        ok = false;
+        break;
+      }
+      header.head = (header.head + 1) % header.capacity;
+      if (header.count < header.capacity) {
+        header.count++;
+      }
+      mPending[i].level = kLevelCount;
+      mWrittenCount++;
+    }
+    if (file != NULL) {
+      fseek(file, 0, SEEK_SET);
+      ok = fwrite(&header, sizeof(header), 1, file) == 1 && ok;
+      fclose(file);
+    }
+  }
+
+  uint32_t remaining = 0;
+  for (uint32_t i = 0; i < mPendingCount; i++) {
+    if (mPending[i].level < kLevelCount) {
+      mPending[remaining++] = mPending[i];
+    }
+  }
+  mPendingCount = remaining;
+  if (ok) {
+    mFlushCount++;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+void HistoryStore::save(Snapshot &outSnapshot) const {
+  memcpy(outSnapshot.accumulator, mAccumulator, sizeof(mAccumulator));
+}
+
+/*------------------------------------------------------------------------------
+ * An accumulator that is not aligned on the period of its level or whose
+ * sums are not finite is dropped. The period restored is closed by the next
+ * sample if it is over.
+ */
+void HistoryStore::restore(const Snapshot &inSnapshot) {
+  for (uint8_t level = 0; level < kLevelCount; level++) {
+    const Accumulator &acc = inSnapshot.accumulator[level];
+    if (acc.count > 0 && acc.date % kPeriod[level] == 0 &&
+        isfinite(acc.dutySum) && isfinite(acc.temperatureSum) &&
+        isfinite(acc.setpointSum)) {
+      mAccumulator[level] = acc;
+    } else {
+      memset(&mAccumulator[level], 0, sizeof(Accumulator));
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Starts a query of the records of a level whose date is in [inFrom, inTo].
+ * The pending records are written first so that they are included.
+ */
+bool HistoryStore::startQuery(const uint8_t inLevel, const uint32_t inFrom,
+                              const uint32_t inTo) {
+  if (!mReady || inLevel >= kLevelCount) {
+    return false;
+  }
+  flush();
+  mQueryActive = true;
+  mQueryLevel = inLevel;
+  mQueryFrom = inFrom;
+  mQueryTo = inTo;
+  mQueryPosition = 0;
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ * Fills outBuffer with the level followed by the next records of the query.
+ * A chunk with no record ends the query. Returns the size of the chunk or 0
+ * if no query is active or if kHistoryScanLimit records were read without
+ * finding one in the range, the query goes on at the next call.
+ */
+size_t HistoryStore::nextChunk(uint8_t *outBuffer, const size_t inSize) {
+  if (!mQueryActive || inSize < 1 + sizeof(Record)) {
+    return 0;
+  }
+  outBuffer[0] = mQueryLevel;
+  size_t size = 1;
+
+  char name[48];
+  fileName(mQueryLevel, name, sizeof(name));
+  FILE *file = fopen(name, "rb");
+  bool ended = true;
+  if (file != NULL) {
+    const FileHeader &header = mHeader[mQueryLevel];
+    const uint32_t oldest = header.count < header.capacity ? 0 : header.head;
+    uint32_t scanned = 0;
+    while (mQueryPosition < header.count &&
+           size + sizeof(Record) <= inSize && scanned < kHistoryScanLimit) {
+      scanned++;
+      const uint32_t index = (oldest + mQueryPosition) % header.capacity;
+      Record record;
+      fseek(file, sizeof(FileHeader) + index * sizeof(Record), SEEK_SET);
+      if (fread(&record, sizeof(Record), 1, file) != 1) {
+        mQueryPosition = header.count;
+        break;
+      }
+      mQueryPosition++;
+      if (record.date >= mQueryFrom && record.date <= mQueryTo) {
+        memcpy(outBuffer + size, &record, sizeof(Record));
+        size += sizeof(Record);
+      }
+    }
+    fclose(file);
+    ended = mQueryPosition >= header.count;
+  }
+
+  if (size == 1) {
+    if (!ended) {
+      return 0;
+    }
+    mQueryActive = false;
+  }
+  return size;
+}
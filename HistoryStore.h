@@ -0,0 +1,132 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Persistent multi-resolution history of the heater.
+ *
+ * Every minute, the duty, the mean temperature and the setpoint are added
+ * to the store. They are averaged hierarchically in 1 min, 15 min, 1 h and
+ * 1 day records. Each resolution is kept in a fixed-size ring file in flash
+ * (LittleFS on the ESP32), so that the footprint is bounded:
+ *
+ * +-------+------------+----------+----------+
+ * | Level | Resolution | Records  | Span     |
+ * +-------+------------+----------+----------+
+ * |   0   |   1 min    |   1440   | 1 day    |
+ * |   1   |  15 min    |   1344   | 2 weeks  |
+ * |   2   |   1 h      |   2232   | 3 months |
+ * |   3   |   1 day    |    731   | 2 years  |
+ * +-------+------------+----------+----------+
+ *
+ * Records are kept in RAM and written by batches of kHistoryFlushThreshold
+ * so that the flash is written a few times per hour only. LittleFS spreads
+ * the writes over the partition.
+ *
+ * Records are dated in seconds since 1970. Nothing is stored until the time
+ * is known.
+ *
+ * The records being accumulated are saved in a Snapshot by the checkpoint,
+ * so that a restart does not lose the day, hour or quarter in progress. The
+ * records waiting in RAM to be written, at most kHistoryPendingSize, are
+ * lost by a restart.
+ *
+ * A query reads at most kHistoryScanLimit records per chunk, so that a
+ * narrow query on a large level does not block loop().
+ */
+
+#ifndef __HISTORYSTORE_H__
+#define __HISTORYSTORE_H__
+
+#include "Config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+class HistoryStore {
+public:
+  static const uint32_t kLevelCount = 4;
+
+  /*
+   * A record as stored in flash and sent over MQTT, little endian.
+   */
+  typedef struct __attribute__((packed)) {
+    uint32_t date;       /* start of the period, s since 1970 */
+    uint16_t duty;       /* in 0.1 % */
+    int16_t temperature; /* mean room temperature in 0.01 °C */
+    int16_t setpoint;    /* mean setpoint in 0.01 °C */
+    uint16_t count;      /* number of 1 min samples */
+  } Record;
+
+  typedef struct {
+    uint32_t date;
+    float dutySum;
+    float temperatureSum;
+    float setpointSum;
+    uint32_t count;
+  } Accumulator;
+
+  /* State for a checkpoint */
+  typedef struct {
+    Accumulator accumulator[kLevelCount];
+  } Snapshot;
+
+private:
+  typedef struct {
+    uint8_t level;
+    Record record;
+  } PendingRecord;
+
+  typedef struct {
+    uint32_t magic;
+    uint16_t level;
+    uint16_t capacity;
+    uint32_t head; /* index of the next record to write */
+    uint32_t count;
+  } FileHeader;
+
+  static const uint32_t kPeriod[kLevelCount];
+  static const uint16_t kCapacity[kLevelCount];
+
+  const char *mBasePath;
+  bool mReady;
+  Accumulator mAccumulator[kLevelCount];
+  FileHeader mHeader[kLevelCount];
+  PendingRecord mPending[kHistoryPendingSize];
+  uint32_t mPendingCount;
+
+  /* Current query */
+  bool mQueryActive;
+  uint8_t mQueryLevel;
+  uint32_t mQueryFrom;
+  uint32_t mQueryTo;
+  uint32_t mQueryPosition; /* from the oldest record */
+
+  /* Statistics */
+  uint32_t mFlushCount;
+  uint32_t mWrittenCount;
+  uint32_t mDroppedCount;
+
+  void fileName(const uint8_t inLevel, char *outName, const size_t inSize);
+  bool openLevel(const uint8_t inLevel);
+  void feed(const uint8_t inLevel, const uint32_t inDate, const float inDuty,
+            const float inTemperature, const float inSetpoint,
+            const uint32_t inCount);
+  void close(const uint8_t inLevel);
+
+public:
+  HistoryStore();
+  bool begin(const char *inBasePath);
+  void add(const uint32_t inDate, const float inDuty,
+           const float inTemperature, const float inSetpoint);
+  void flush();
+  void save(Snapshot &outSnapshot) const;
+  void restore(const Snapshot &inSnapshot);
+  bool startQuery(const uint8_t inLevel, const uint32_t inFrom,
+                  const uint32_t inTo);
+  size_t nextChunk(uint8_t *outBuffer, const size_t inSize);
+  bool isQueryActive() const { return mQueryActive; }
+  uint32_t pendingCount() const { return mPendingCount; }
+  uint32_t flushCount() const { return mFlushCount; }
+  uint32_t writtenCount() const { return mWrittenCount; }
+  uint32_t droppedCount() const { return mDroppedCount; }
+};
+
+#endif
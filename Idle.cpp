@@ -0,0 +1,80 @@
+#include "Idle.h"
+#include "Config.h"
+#include "Debug.h"
+#include "Hal.h"
+
+#ifdef ARDUINO
+#include <esp_pm.h>
+#endif
+
+static const uint8_t kLogModule = Logger::SYSTEM; /* of the log messages */
+
+/*------------------------------------------------------------------------------
+ * Statistics
+ */
+uint32_t Idle::sStatsStartDate = 0;
+uint64_t Idle::sSleptTime = 0;
+uint32_t Idle::sMaxLateness = 0;
+
+/*------------------------------------------------------------------------------
+ * Enables the automatic light sleep. If the power management is not
+ * available in the ESP-IDF configuration, the idle time is spent in the
+ * FreeRTOS idle task.
+ */
+void Idle::begin() {
+#ifdef ARDUINO
+  esp_pm_config_esp32_t pmConfig;
+  pmConfig.max_freq_mhz = getCpuFrequencyMhz();
+  pmConfig.min_freq_mhz = kMinCpuFrequency;
+  pmConfig.light_sleep_enable = true;
+  const esp_err_t err = esp_pm_configure(&pmConfig);
+  LOGI;
+  if (err == ESP_OK) {
+    DEBUG_PLN("Light sleep actif");
+  } else {
+    DEBUG_P("Light sleep non supporte : ");
+    DEBUG_PLN(err);
+  }
+#endif
+  resetStats();
+}
+
+/*------------------------------------------------------------------------------
+ * Sleeps until inDate (in ms) or until woken up by Hal::wakeUp(). Does
+ * nothing if inDate is already reached. An early wake up is not counted in
+ * the lateness.
+ */
+void Idle::sleepUntil(const uint32_t inDate) {
+  const int32_t delay = (int32_t)(inDate - Hal::millis());
+  if (delay > 0) {
+    const uint32_t sleepStart = Hal::micros();
+    Hal::sleep(delay);
+    sSleptTime += Hal::micros() - sleepStart;
+    const int32_t lateness = (int32_t)(Hal::millis() - inDate);
+    if (lateness > (int32_t)sMaxLateness) {
+      sMaxLateness = lateness;
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * % of the time spent sleeping since the last reset of the statistics. The
+ * elapsed time is in ms so that the statistics may cover up to 49 days, a
+ * single sleep is short enough to be measured in µs.
+ */
+float Idle::idleRatio() {
+  const uint32_t elapsed = Hal::millis() - sStatsStartDate;
+  if (elapsed > 0) {
+    return 0.1 * (float)sSleptTime / (float)elapsed;
+  } else {
+    return 0.0;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+void Idle::resetStats() {
+  sStatsStartDate = Hal::millis();
+  sSleptTime = 0;
+  sMaxLateness = 0;
+}
@@ -0,0 +1,35 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Idle management.
+ *
+ * Instead of busy polling in loop(), the firmware sleeps until the next
+ * TimeObject deadline. The network task wakes it up earlier when a message
+ * is received. When the power management of the ESP32 is available, the core
+ * goes to light sleep during the idle time and the WiFi stays in modem sleep.
+ *
+ * The idle ratio and the wake-up lateness are measured so that the timing of
+ * the PWM slots can be checked.
+ */
+
+#ifndef __IDLE_H__
+#define __IDLE_H__
+
+#include <stdint.h>
+
+class Idle {
+  static uint32_t sStatsStartDate; /* in ms */
+  static uint64_t sSleptTime;      /* in µs, micros() wraps after 71 min */
+  static uint32_t sMaxLateness;    /* in ms */
+
+  Idle() {} /* prevent instanciation */
+
+public:
+  static void begin();
+  static void sleepUntil(const uint32_t inDate);
+  static float idleRatio();
+  static uint32_t maxLateness() { return sMaxLateness; }
+  static void resetStats();
+};
+
+#endif
@@ -0,0 +1,14 @@
+#include "IncomingFilter.h"
+
+/*------------------------------------------------------------------------------
+ * Topic sizes include the terminating null, hence >=.
+ */
+bool IncomingFilter::accept(const size_t inTopicLength,
+                            const size_t inPayloadLength) {
+  if (inPayloadLength > kMaxIncomingPayloadSize ||
+      inTopicLength >= kMaxTopicSize) {
+    mOversizedCount++;
+    return false;
+  }
+  return true;
+}
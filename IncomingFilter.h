@@ -0,0 +1,43 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Size check of the incoming MQTT messages.
+ *
+ * The MQTT client reads a whole PUBLISH packet in its buffer: fixed header
+ * (1 byte), remaining length (2 bytes up to 16383), topic length (2 bytes),
+ * topic and payload. A packet larger than the buffer is dropped by the
+ * client and never reaches the callback. The buffer is sized so that a
+ * packet carrying the longest topic and a payload one byte larger than a
+ * slot still fits: such a message reaches the callback, where accept()
+ * rejects it and counts it.
+ */
+
+#ifndef __INCOMINGFILTER_H__
+#define __INCOMINGFILTER_H__
+
+#include "Config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+class IncomingFilter {
+  uint32_t mOversizedCount;
+
+public:
+  /* Size of a QoS 0 PUBLISH packet in the buffer of the MQTT client */
+  static constexpr size_t packetSize(const size_t inTopicLength,
+                                     const size_t inPayloadLength) {
+    return 5 + inTopicLength + inPayloadLength;
+  }
+
+  IncomingFilter() : mOversizedCount(0) {}
+  /* false, and counted, when the message does not fit in a slot */
+  bool accept(const size_t inTopicLength, const size_t inPayloadLength);
+  uint32_t oversizedCount() const { return mOversizedCount; }
+};
+
+static_assert(IncomingFilter::packetSize(kMaxTopicSize - 1,
+                                         kMaxIncomingPayloadSize + 1) <=
+                  kMQTTBufferSize,
+              "an oversized payload must reach the callback to be counted");
+
+#endif
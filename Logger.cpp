@@ -0,0 +1,459 @@
+#include "Logger.h"
+#include <stdio.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ * Names used by setLevels() and in the lines
+ */
+static const char *const kModuleNames[] = {"main", "heater", "net", "storage",
+                                           "system"};
+static const char *const kLevelNames[] = {"none", "error", "warning", "info",
+                                          "debug"};
+static const char kLevelLetters[] = "-EWID";
+
+/*------------------------------------------------------------------------------
+ * Levels. The debug records are discarded until asked for, nothing is
+ * forwarded on MQTT.
+ */
+Logger::Channel Logger::sChannel[kLogChannelCount];
+uint8_t Logger::sLevel[SYSTEM + 1] = {LOG_INFO, LOG_INFO, LOG_INFO, LOG_INFO,
+                                      LOG_INFO};
+uint8_t Logger::sForwardLevel = LOG_NONE;
+uint32_t Logger::sDrainChannel = 0;
+char Logger::sLine[kLogLineSize];
+size_t Logger::sLineLength = 0;
+size_t Logger::sLinePosition = 0;
+char Logger::sForward[kLogForwardSize];
+size_t Logger::sForwardLength = 0;
+uint32_t Logger::sForwardLostCount = 0;
+
+#ifdef ARDUINO
+static inline void *currentTask() { return xTaskGetCurrentTaskHandle(); }
+#else
+static inline void *currentTask() { return NULL; }
+#endif
+
+/*------------------------------------------------------------------------------
+ * Channel of the calling task. A task logging for the first time takes a
+ * free channel. Returns NULL if there is none left.
+ */
+Logger::Channel *Logger::channel() {
+  void *task = currentTask();
+  for (uint32_t i = 0; i < kLogChannelCount; i++) {
+    if (sChannel[i].used && sChannel[i].task == task) {
+      return &sChannel[i];
+    }
+  }
+  Channel *result = NULL;
+  Hal::enterCritical();
+  for (uint32_t i = 0; i < kLogChannelCount; i++) {
+    if (!sChannel[i].used) {
+      sChannel[i].task = task;
+      sChannel[i].used = true;
+      result = &sChannel[i];
+      break;
+    }
+  }
+  Hal::exitCritical();
+  return result;
+}
+
+/*------------------------------------------------------------------------------
+ * Starts a record. If the level is above the one of the module, the record
+ * is discarded and so are the items added to it.
+ */
+void Logger::open(Channel &ioChannel, const uint8_t inModule,
+                  const uint8_t inLevel, const bool inDated) {
+  ioChannel.open = true;
+  ioChannel.discarded = inModule > SYSTEM || inLevel > sLevel[inModule];
+  if (!ioChannel.discarded) {
+    RecordHeader header;
+    header.size = 0;
+    header.module = inModule;
+    header.level = inLevel;
+    header.dated = inDated;
+    header.date = Hal::millis();
+    memcpy(ioChannel.record, &header, sizeof(header));
+    ioChannel.size = sizeof(header);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Channel of the record an item is added to, NULL if the item is discarded.
+ * An item added without a started record starts an undated debug record,
+ * like a print without LOGT did.
+ */
+Logger::Channel *Logger::prepare(const uint8_t inModule) {
+  Channel *ch = channel();
+  if (ch != NULL) {
+    if (!ch->open) {
+      open(*ch, inModule, LOG_DEBUG, false);
+    }
+    if (ch->discarded) {
+      ch = NULL;
+    }
+  }
+  return ch;
+}
+
+/*------------------------------------------------------------------------------
+ * Appends an item to the record. An item that does not fit is left out.
+ */
+void Logger::put(Channel &ioChannel, const uint8_t inKind, const void *inData,
+                 const size_t inSize) {
+  if (ioChannel.size + 1 + inSize <= kLogRecordSize) {
+    ioChannel.record[ioChannel.size] = inKind;
+    memcpy(&ioChannel.record[ioChannel.size + 1], inData, inSize);
+    ioChannel.size += 1 + inSize;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Pushes the record in the ring buffer. The record is written before head is
+ * moved so that drain() never reads a partial record.
+ */
+void Logger::commit(Channel &ioChannel) {
+  ioChannel.open = false;
+  if (ioChannel.discarded) {
+    return;
+  }
+  const uint32_t size = ioChannel.size;
+  if (kLogBufferSize - (ioChannel.head - ioChannel.tail) < size) {
+    ioChannel.droppedCount++;
+    return;
+  }
+  ioChannel.record[0] = size;
+  const uint32_t position = ioChannel.head % kLogBufferSize;
+  const uint32_t first =
+      size < kLogBufferSize - position ? size : kLogBufferSize - position;
+  memcpy(&ioChannel.buffer[position], ioChannel.record, first);
+  memcpy(ioChannel.buffer, &ioChannel.record[first], size - first);
+  __sync_synchronize();
+  ioChannel.head += size;
+  ioChannel.recordCount++;
+}
+
+/*------------------------------------------------------------------------------
+ * LOGT, LOGI, LOGW and LOGE. A record left open is committed first.
+ */
+void Logger::start(const uint8_t inModule, const uint8_t inLevel) {
+  Channel *ch = channel();
+  if (ch != NULL) {
+    if (ch->open) {
+      commit(*ch);
+    }
+    open(*ch, inModule, inLevel, true);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * DEBUG_P. The strings that are not literals are copied, truncated to what
+ * is left in the record.
+ */
+void Logger::add(const uint8_t inModule, const char *inText) {
+  Channel *ch = prepare(inModule);
+  if (ch == NULL || inText == NULL) {
+    return;
+  }
+  if (Hal::isReadOnly(inText)) {
+    put(*ch, LITERAL, &inText, sizeof(inText));
+  } else if ((size_t)ch->size + 2 < (size_t)kLogRecordSize) {
+    size_t length = strlen(inText);
+    if (length > kLogRecordSize - ch->size - 2) {
+      length = kLogRecordSize - ch->size - 2;
+    }
+    ch->record[ch->size] = TEXT;
+    ch->record[ch->size + 1] = length;
+    memcpy(&ch->record[ch->size + 2], inText, length);
+    ch->size += 2 + length;
+  }
+}
+
+#ifdef ARDUINO
+void Logger::add(const uint8_t inModule, const String &inText) {
+  add(inModule, inText.c_str());
+}
+#endif
+
+void Logger::add(const uint8_t inModule, const char inChar) {
+  Channel *ch = prepare(inModule);
+  if (ch != NULL) {
+    put(*ch, CHARACTER, &inChar, sizeof(inChar));
+  }
+}
+
+void Logger::add(const uint8_t inModule, const int inVal) {
+  add(inModule, (long)inVal);
+}
+
+void Logger::add(const uint8_t inModule, const unsigned int inVal) {
+  add(inModule, (unsigned long)inVal);
+}
+
+void Logger::add(const uint8_t inModule, const long inVal) {
+  Channel *ch = prepare(inModule);
+  if (ch != NULL) {
+    const int32_t value = inVal;
+    put(*ch, SIGNED, &value, sizeof(value));
+  }
+}
+
+void Logger::add(const uint8_t inModule, const unsigned long inVal) {
+  Channel *ch = prepare(inModule);
+  if (ch != NULL) {
+    const uint32_t value = inVal;
+    put(*ch, UNSIGNED, &value, sizeof(value));
+  }
+}
+
+void Logger::add(const uint8_t inModule, const double inVal) {
+  Channel *ch = prepare(inModule);
+  if (ch != NULL) {
+    const float value = inVal;
+    put(*ch, REAL, &value, sizeof(value));
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * DEBUG_PLN. Ends the line and commits the record.
+ */
+void Logger::end(const uint8_t inModule) {
+  Channel *ch = channel();
+  if (ch != NULL) {
+    if (!ch->open) {
+      open(*ch, inModule, LOG_DEBUG, false);
+    }
+    commit(*ch);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Formats a record in sLine:
+ *
+ * HH:MM:SS.mmm L module : items
+ *
+ * The prefix is omitted for an undated record.
+ */
+void Logger::format(const uint8_t *inRecord) {
+  RecordHeader header;
+  memcpy(&header, inRecord, sizeof(header));
+  const size_t capacity = kLogLineSize - 2; /* room for \r\n */
+  size_t length = 0;
+  if (header.dated) {
+    const uint32_t date = header.date;
+    length = snprintf(sLine, capacity, "%02lu:%02lu:%02lu.%03lu %c %s : ",
+                      (unsigned long)(date / 3600000),
+                      (unsigned long)(date / 60000 % 60),
+                      (unsigned long)(date / 1000 % 60),
+                      (unsigned long)(date % 1000),
+                      kLevelLetters[header.level], kModuleNames[header.module]);
+  }
+
+  size_t position = sizeof(header);
+  while (position < header.size && length < capacity) {
+    const uint8_t kind = inRecord[position++];
+    char *out = &sLine[length];
+    const size_t room = capacity - length;
+    int written = 0;
+    switch (kind) {
+    case LITERAL: {
+      const char *text;
+      memcpy(&text, &inRecord[position], sizeof(text));
+      position += sizeof(text);
+      written = snprintf(out, room, "%s", text);
+      break;
+    }
+    case TEXT: {
+      const uint8_t textLength = inRecord[position++];
+      written = textLength < room - 1 ? textLength : room - 1;
+      memcpy(out, &inRecord[position], written);
+      out[written] = '\0';
+      position += textLength;
+      break;
+    }
+    case CHARACTER:
+      written = snprintf(out, room, "%c", (char)inRecord[position++]);
+      break;
+    case SIGNED: {
+      int32_t value;
+      memcpy(&value, &inRecord[position], sizeof(value));
+      position += sizeof(value);
+      written = snprintf(out, room, "%ld", (long)value);
+      break;
+    }
+    case UNSIGNED: {
+      uint32_t value;
+      memcpy(&value, &inRecord[position], sizeof(value));
+      position += sizeof(value);
+      written = snprintf(out, room, "%lu", (unsigned long)value);
+      break;
+    }
+    case REAL: {
+      float value;
+      memcpy(&value, &inRecord[position], sizeof(value));
+      position += sizeof(value);
+      written = snprintf(out, room, "%.2f", value);
+      break;
+    }
+    default:
+      position = header.size;
+      break;
+    }
+    if (written > 0) {
+      length += (size_t)written < room ? written : room - 1;
+    }
+  }
+  sLine[length++] = '\r';
+  sLine[length++] = '\n';
+  sLineLength = length;
+  sLinePosition = 0;
+
+  /* The line without \r is forwarded if there is room left */
+  if (header.level <= sForwardLevel) {
+    if (sForwardLength + length - 1 <= kLogForwardSize) {
+      memcpy(&sForward[sForwardLength], sLine, length - 2);
+      sForwardLength += length - 2;
+      sForward[sForwardLength++] = '\n';
+    } else {
+      sForwardLostCount++;
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * Takes the next record, the channels in turn, and formats it. Returns false
+ * if there is none.
+ */
+bool Logger::nextLine() {
+  for (uint32_t i = 0; i < kLogChannelCount; i++) {
+    Channel &ch = sChannel[sDrainChannel];
+    sDrainChannel = (sDrainChannel + 1) % kLogChannelCount;
+    if (ch.tail != ch.head) {
+      __sync_synchronize();
+      uint8_t record[kLogRecordSize];
+      const uint32_t position = ch.tail % kLogBufferSize;
+      const uint32_t size = ch.buffer[position];
+      const uint32_t first =
+          size < kLogBufferSize - position ? size : kLogBufferSize - position;
+      memcpy(record, &ch.buffer[position], first);
+      memcpy(&record[first], ch.buffer, size - first);
+      __sync_synchronize();
+      ch.tail += size;
+      format(record);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ * Called by loop() when it is about to sleep. Writes the pending lines as
+ * far as the UART accepts them without waiting. The rest is written by the
+ * next calls.
+ */
+void Logger::drain() {
+  while (sLinePosition < sLineLength || nextLine()) {
+    const int room = Serial.availableForWrite();
+    if (room <= 0) {
+      return;
+    }
+    size_t count = sLineLength - sLinePosition;
+    if (count > (size_t)room) {
+      count = room;
+    }
+    Serial.write((const uint8_t *)&sLine[sLinePosition], count);
+    sLinePosition += count;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * True if some lines are not written yet
+ */
+bool Logger::isPending() {
+  if (sLinePosition < sLineLength) {
+    return true;
+  }
+  for (uint32_t i = 0; i < kLogChannelCount; i++) {
+    if (sChannel[i].tail != sChannel[i].head) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ * Index of inName (inLength characters) in inNames, -1 if not found
+ */
+int Logger::find(const char *const *inNames, const uint32_t inCount,
+                 const char *inName, const size_t inLength) {
+  for (uint32_t i = 0; i < inCount; i++) {
+    if (strncmp(inNames[i], inName, inLength) == 0 &&
+        inNames[i][inLength] == '\0') {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*------------------------------------------------------------------------------
+ * Sets levels from a list of <key>=<level> separated by commas, for instance
+ * net=debug,mqtt=warning. The key is a module name, all for all the modules
+ * or mqtt for the lines forwarded on MQTT. The level is none, error,
+ * warning, info or debug. Nothing is changed if an entry is invalid.
+ */
+bool Logger::setLevels(const char *inConfig) {
+  uint8_t level[SYSTEM + 1];
+  memcpy(level, sLevel, sizeof(level));
+  uint8_t forwardLevel = sForwardLevel;
+
+  const char *entry = inConfig;
+  while (*entry != '\0') {
+    const char *separator = strchr(entry, ',');
+    const char *entryEnd = separator != NULL ? separator : entry + strlen(entry);
+    const char *equal = (const char *)memchr(entry, '=', entryEnd - entry);
+    if (equal == NULL) {
+      return false;
+    }
+    const int value = find(kLevelNames, LOG_DEBUG + 1, equal + 1,
+                           entryEnd - equal - 1);
+    if (value < 0) {
+      return false;
+    }
+    const size_t keyLength = equal - entry;
+    if (keyLength == 4 && strncmp(entry, "mqtt", 4) == 0) {
+      forwardLevel = value;
+    } else if (keyLength == 3 && strncmp(entry, "all", 3) == 0) {
+      memset(level, value, sizeof(level));
+    } else {
+      const int module = find(kModuleNames, SYSTEM + 1, entry, keyLength);
+      if (module < 0) {
+        return false;
+      }
+      level[module] = value;
+    }
+    entry = separator != NULL ? separator + 1 : entryEnd;
+  }
+
+  memcpy(sLevel, level, sizeof(sLevel));
+  sForwardLevel = forwardLevel;
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ * Statistics
+ */
+uint32_t Logger::recordCount() {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < kLogChannelCount; i++) {
+    count += sChannel[i].recordCount;
+  }
+  return count;
+}
+
+uint32_t Logger::droppedCount() {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < kLogChannelCount; i++) {
+    count += sChannel[i].droppedCount;
+  }
+  return count;
+}
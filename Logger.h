@@ -0,0 +1,121 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Asynchronous logger behind the debug macros of Debug.h.
+ *
+ * A log line does not print anything. It is built as a binary record: the
+ * date, the module, the level and the arguments. A string in read-only
+ * memory (a literal) is stored as its address, which identifies the format,
+ * other strings are copied. The record is then pushed in a ring buffer. Each
+ * task logging has its own ring buffer, written by the task only and read by
+ * loop() only, so that no lock is needed.
+ *
+ * loop() calls drain() before sleeping. The records are formatted and written
+ * to Serial as far as the UART accepts them without waiting. The lines at or
+ * below the forward level are also gathered to be published on MQTT.
+ *
+ * Each module has its level, set at runtime by setLevels(). A record above
+ * the level of its module is discarded at once. A record that does not fit
+ * in its ring buffer is lost and counted.
+ */
+
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include "Config.h"
+#include "Hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+class Logger {
+public:
+  enum Level { LOG_NONE, LOG_ERROR, LOG_WARNING, LOG_INFO, LOG_DEBUG };
+  enum Module { MAIN, HEATER, NETWORK, STORAGE, SYSTEM };
+
+private:
+  enum ItemKind { LITERAL, TEXT, CHARACTER, SIGNED, UNSIGNED, REAL };
+
+  typedef struct {
+    uint8_t size; /* of the record, header included */
+    uint8_t module;
+    uint8_t level;
+    uint8_t dated; /* started by LOGT, LOGI, ... */
+    uint32_t date; /* ms */
+  } RecordHeader;
+
+  /*
+   * The ring buffer of a task. head and tail are free running, head is
+   * written by the task and tail by drain().
+   */
+  typedef struct {
+    void *task;
+    volatile bool used;
+    bool open;      /* a record is being built */
+    bool discarded; /* the record being built is above the level */
+    uint8_t size;   /* of the record being built */
+    uint8_t record[kLogRecordSize];
+    uint8_t buffer[kLogBufferSize];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t recordCount;
+    uint32_t droppedCount;
+  } Channel;
+
+  static Channel sChannel[kLogChannelCount];
+  static uint8_t sLevel[SYSTEM + 1];
+  static uint8_t sForwardLevel;
+  static uint32_t sDrainChannel;
+  static char sLine[kLogLineSize];
+  static size_t sLineLength;
+  static size_t sLinePosition;
+  static char sForward[kLogForwardSize];
+  static size_t sForwardLength;
+  static uint32_t sForwardLostCount;
+
+  Logger() {} /* prevent instanciation */
+
+  static Channel *channel();
+  static Channel *prepare(const uint8_t inModule);
+  static void open(Channel &ioChannel, const uint8_t inModule,
+                   const uint8_t inLevel, const bool inDated);
+  static void put(Channel &ioChannel, const uint8_t inKind,
+                  const void *inData, const size_t inSize);
+  static void commit(Channel &ioChannel);
+  static bool nextLine();
+  static void format(const uint8_t *inRecord);
+  static int find(const char *const *inNames, const uint32_t inCount,
+                  const char *inName, const size_t inLength);
+
+public:
+  static void start(const uint8_t inModule, const uint8_t inLevel);
+  static void add(const uint8_t inModule, const char *inText);
+#ifdef ARDUINO
+  static void add(const uint8_t inModule, const String &inText);
+#endif
+  static void add(const uint8_t inModule, const char inChar);
+  static void add(const uint8_t inModule, const int inVal);
+  static void add(const uint8_t inModule, const unsigned int inVal);
+  static void add(const uint8_t inModule, const long inVal);
+  static void add(const uint8_t inModule, const unsigned long inVal);
+  static void add(const uint8_t inModule, const double inVal);
+  static void end(const uint8_t inModule);
+  template <typename T> static void end(const uint8_t inModule, const T &inVal) {
+    add(inModule, inVal);
+    end(inModule);
+  }
+
+  static void drain();
+  static bool isPending();
+  static bool setLevels(const char *inConfig);
+
+  /* Lines to publish on MQTT, cleared once published */
+  static const char *forwardBuffer() { return sForward; }
+  static size_t forwardLength() { return sForwardLength; }
+  static void clearForward() { sForwardLength = 0; }
+
+  static uint32_t recordCount();
+  static uint32_t droppedCount();
+  static uint32_t forwardLostCount() { return sForwardLostCount; }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "OfflineQueue.h"
+#include "Hal.h"
+
+/*------------------------------------------------------------------------------
+ */
+OfflineQueue::OfflineQueue()
+    : mMaxDepth(0), mDroppedCount(0), mReplayedCount(0), mDraining(false),
+      mDrainStartDate(0), mLastDrainTime(0) {}
+
+/*------------------------------------------------------------------------------
+ */
+void OfflineQueue::push(const Telemetry::Status &inStatus) {
+  if (mSamples.isFull()) {
+    Sample dropped;
+    mSamples.pop(dropped);
+    mDroppedCount++;
+  }
+  Sample sample;
+  sample.uptime = Hal::millis();
+  sample.status = inStatus;
+  mSamples.push(sample);
+  if (mSamples.size() > mMaxDepth) {
+    mMaxDepth = mSamples.size();
+  }
+}
+
+/*------------------------------------------------------------------------------
+ * The first call of a replay starts the measurement of the drain time
+ */
+bool OfflineQueue::front(Telemetry::TimedStatus &outStatus) {
+  if (mSamples.isEmpty()) {
+    return false;
+  }
+  if (!mDraining) {
+    mDraining = true;
+    mDrainStartDate = Hal::millis();
+  }
+  const Sample &sample = mSamples[0];
+  const uint32_t now = Hal::epoch();
+  const uint32_t age = (Hal::millis() - sample.uptime) / 1000;
+  outStatus.date = now > age ? now - age : 0;
+  outStatus.status = sample.status;
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ */
+void OfflineQueue::pop() {
+  Sample sample;
+  if (mSamples.pop(sample)) {
+    mReplayedCount++;
+    if (mSamples.isEmpty() && mDraining) {
+      mDraining = false;
+      mLastDrainTime = Hal::millis() - mDrainStartDate;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Queue of the statuses sampled while the connection is down.
+ *
+ * While offline, a status is pushed every kOfflineSamplePeriod ms. When the
+ * queue is full, the oldest status is dropped. Once online again, the
+ * statuses are replayed one at a time every kReplayPeriod ms so that the
+ * heaters reconnecting together do not flood the broker.
+ *
+ * A sample is dated with the uptime. The date in s since 1970 is computed
+ * at replay so that the samples taken before SNTP answered are dated too.
+ *
+ * The queue is in RAM and lost on restart. The 1 min history of the duty and
+ * temperatures is kept in flash anyway, see HistoryStore.
+ */
+
+#ifndef __OFFLINEQUEUE_H__
+#define __OFFLINEQUEUE_H__
+
+#include "Config.h"
+#include "RingBuf.h"
+#include "Telemetry.h"
+
+class OfflineQueue {
+  typedef struct {
+    uint32_t uptime; /* ms */
+    Telemetry::Status status;
+  } Sample;
+
+  RingBuf<Sample, kOfflineQueueSize> mSamples;
+  uint32_t mMaxDepth;
+  uint32_t mDroppedCount;
+  uint32_t mReplayedCount;
+  bool mDraining;
+  uint32_t mDrainStartDate;
+  uint32_t mLastDrainTime;
+
+public:
+  OfflineQueue();
+  void push(const Telemetry::Status &inStatus);
+  /* Oldest sample, returns false if the queue is empty */
+  bool front(Telemetry::TimedStatus &outStatus);
+  void pop();
+  uint32_t depth() const { return mSamples.size(); }
+  uint32_t maxDepth() const { return mMaxDepth; }
+  uint32_t droppedCount() const { return mDroppedCount; }
+  uint32_t replayedCount() const { return mReplayedCount; }
+  /* Duration (in ms) of the last complete replay */
+  uint32_t lastDrainTime() const { return mLastDrainTime; }
+};
+
+#endif
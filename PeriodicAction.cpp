@@ -3,25 +3,53 @@
 */
 
 #include "PeriodicAction.h"
-#include <Arduino.h>
+#include <stddef.h>
 
 /*------------------------------------------------------------------------------
+  Le retard est celui de l'échéance courante. Avec COALESCE et SKIP_ALIGNED,
+  la prochaine échéance est la première de la grille des périodes qui est
+  après la date courante.
 */
 void PeriodicAction::execute()
 {
-  if (mAction != NULL) mAction();
+  const uint32_t missed = mPeriod > 0 ? lateness() / mPeriod : 0;
   mNextDelay = mPeriod;
+  if (missed > 0) {
+    if (mPolicy == CATCH_UP) {
+      countOverrun(0);
+    } else {
+      countOverrun(missed);
+      mNextDelay = mPeriod * (missed + 1);
+    }
+  }
+  if (mPolicy == COALESCE) {
+    if (mCoalescedAction != NULL) mCoalescedAction(missed);
+  } else {
+    if (mAction != NULL) mAction();
+  }
 }
 
 /*------------------------------------------------------------------------------
 */
-PeriodicAction::PeriodicAction(const uint32_t inOffset, const uint32_t inPeriod)
-  : TimeObject(inOffset), mPeriod(inPeriod), mAction(NULL)
+PeriodicAction::PeriodicAction(const uint32_t inOffset, const uint32_t inPeriod,
+                               const OverrunPolicy inPolicy)
+  : TimeObject(inOffset), mPeriod(inPeriod), mPolicy(inPolicy), mAction(NULL),
+    mCoalescedAction(NULL)
 {}
 
 /*------------------------------------------------------------------------------
 */
-void PeriodicAction::begin(void (*inAction)())
+void PeriodicAction::begin(void (*inAction)(), const char *inName)
 {
   mAction = inAction;
+  setName(inName);
+}
+
+/*------------------------------------------------------------------------------
+*/
+void PeriodicAction::begin(void (*inAction)(const uint32_t inMissed),
+                           const char *inName)
+{
+  mCoalescedAction = inAction;
+  setName(inName);
 }
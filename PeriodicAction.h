@@ -2,22 +2,41 @@
   Classe PeriodicAction
 
   permet d'appeler une fonction à intervalles réguliers et après un offset
+
+  Lorsqu'une exécution est en retard d'une période ou plus (appel bloquant),
+  la politique de dépassement décide du sort des échéances manquées :
+  - CATCH_UP : chacune est exécutée, l'une après l'autre ;
+  - COALESCE : une seule exécution, l'action reçoit le nombre d'échéances
+    manquées, puis reprise sur l'échéance alignée suivante ;
+  - SKIP_ALIGNED : les échéances manquées sont comptées mais pas rejouées,
+    une seule exécution puis reprise sur l'échéance alignée suivante.
 */
 
 #ifndef __PERIODICACTION_H__
 #define __PERIODICACTION_H__
 
 #include "TimeObject.h"
+#include <stddef.h>
 
 class PeriodicAction : public TimeObject
 {
+  public:
+    typedef enum { CATCH_UP, COALESCE, SKIP_ALIGNED } OverrunPolicy;
+
+  private:
     uint32_t mPeriod;
+    OverrunPolicy mPolicy;
     void (*mAction)();
+    void (*mCoalescedAction)(const uint32_t inMissed);
     virtual void execute();
 
   public:
-    PeriodicAction(const uint32_t inOffset, const uint32_t inPeriod);
-    void begin(void (*inAction)());
+    PeriodicAction(const uint32_t inOffset, const uint32_t inPeriod,
+                   const OverrunPolicy inPolicy = CATCH_UP);
+    void begin(void (*inAction)(), const char *inName = NULL);
+    /* For the COALESCE policy */
+    void begin(void (*inAction)(const uint32_t inMissed),
+               const char *inName = NULL);
 };
 
 #endif
@@ -3,7 +3,7 @@
 */
 
 #include "PeriodicLED.h"
-#include <Arduino.h>
+#include "Hal.h"
 
 /*------------------------------------------------------------------------------
  */
@@ -14,7 +14,7 @@ void PeriodicLED::execute() {
     mNextDelay = mPeriod - mDuty;
   }
   mLEDState = !mLEDState;
-  digitalWrite(mLEDPin, mLEDState);
+  Hal::digitalWrite(mLEDPin, mLEDState);
 }
 
 /*------------------------------------------------------------------------------
@@ -30,8 +30,8 @@ PeriodicLED::PeriodicLED(const uint8_t inLEDPin, const uint32_t inPeriod,
 void PeriodicLED::begin(const uint8_t inInitialLEDState) {
   mInitialLEDState = inInitialLEDState != 0 ? HIGH : LOW;
   mLEDState = mInitialLEDState;
-  pinMode(mLEDPin, OUTPUT);
-  digitalWrite(mLEDPin, mLEDState);
+  Hal::pinMode(mLEDPin, OUTPUT);
+  Hal::digitalWrite(mLEDPin, mLEDState);
 }
 
 /*------------------------------------------------------------------------------
@@ -0,0 +1,55 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Runtime profile of a piece of code.
+ */
+
+#include "Profile.h"
+#include "Hal.h"
+
+static const uint32_t kCostMeasurementCount = 1000;
+
+/*------------------------------------------------------------------------------
+ */
+void Profile::record(const uint32_t inTime, const uint32_t inLateness) {
+  mCount++;
+  mTotalTime += inTime;
+  if (inTime > mMaxTime) {
+    mMaxTime = inTime;
+  }
+  if (inLateness > mMaxLateness) {
+    mMaxLateness = inLateness;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+void Profile::reset() {
+  mCount = 0;
+  mTotalTime = 0;
+  mMaxTime = 0;
+  mMaxLateness = 0;
+}
+
+/*------------------------------------------------------------------------------
+ */
+uint32_t Profile::meanTime() const {
+  return mCount > 0 ? (uint32_t)(mTotalTime / mCount) : 0;
+}
+
+/*------------------------------------------------------------------------------
+ * The records are done the way TimeObject::loop() does them. With 1000
+ * records, the time in µs is the cost in ns.
+ */
+uint32_t Profile::measureCost() {
+  Profile profile;
+  const uint32_t startDate = Hal::micros();
+  uint32_t date = startDate;
+  for (uint32_t i = 0; i < kCostMeasurementCount; i++) {
+    const uint32_t endDate = Hal::micros();
+    profile.record(endDate - date);
+    date = endDate;
+  }
+  return (uint64_t)(Hal::micros() - startDate) * 1000ull /
+         kCostMeasurementCount;
+}
@@ -0,0 +1,39 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Runtime profile of a piece of code: number of runs, mean and maximum
+ * execution time (in µs) and maximum lateness (in ms) relative to its
+ * deadline. The statistics accumulate until reset().
+ *
+ * Recording costs a Hal::micros() and a few additions. measureCost() gives
+ * this cost on the target so that the overhead of the profiling can be
+ * published with the profiles. A profile written by a task and read by
+ * another may give a torn value now and then, which is harmless for
+ * statistics.
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+
+class Profile {
+  uint32_t mCount;
+  uint64_t mTotalTime;
+  uint32_t mMaxTime;
+  uint32_t mMaxLateness;
+
+public:
+  Profile() { reset(); }
+  void record(const uint32_t inTime, const uint32_t inLateness = 0);
+  void reset();
+  uint32_t count() const { return mCount; }
+  uint64_t totalTime() const { return mTotalTime; }
+  uint32_t meanTime() const;
+  uint32_t maxTime() const { return mMaxTime; }
+  uint32_t maxLateness() const { return mMaxLateness; }
+  /* Cost of a Hal::micros() and a record(), in ns */
+  static uint32_t measureCost();
+};
+
+#endif
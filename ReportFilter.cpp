@@ -0,0 +1,55 @@
+#include "ReportFilter.h"
+#include "Hal.h"
+
+/*------------------------------------------------------------------------------
+ */
+ReportFilter::ReportFilter(const uint32_t inHeartbeat)
+    : mFieldCount(0), mEnabled(true), mHasReported(false),
+      mHeartbeat(inHeartbeat), mLastReportDate(0), mSentCount(0),
+      mSuppressedCount(0) {}
+
+/*------------------------------------------------------------------------------
+ * Fields beyond kMaxFields share the last one
+ */
+uint8_t ReportFilter::addField(const float inDeadband) {
+  if (mFieldCount < kMaxFields) {
+    mDeadband[mFieldCount] = inDeadband;
+    mCurrent[mFieldCount] = 0.0;
+    mReported[mFieldCount] = 0.0;
+    mFieldCount++;
+  }
+  return mFieldCount - 1;
+}
+
+/*------------------------------------------------------------------------------
+ */
+void ReportFilter::set(const uint8_t inField, const float inValue) {
+  if (inField < mFieldCount) {
+    mCurrent[inField] = inValue;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool ReportFilter::isDue() {
+  bool due = !mEnabled || !mHasReported ||
+             Hal::millis() - mLastReportDate >= mHeartbeat;
+  for (uint8_t field = 0; field < mFieldCount && !due; field++) {
+    due = fabsf(mCurrent[field] - mReported[field]) >= mDeadband[field];
+  }
+  if (!due) {
+    mSuppressedCount++;
+  }
+  return due;
+}
+
+/*------------------------------------------------------------------------------
+ */
+void ReportFilter::reported() {
+  for (uint8_t field = 0; field < mFieldCount; field++) {
+    mReported[field] = mCurrent[field];
+  }
+  mHasReported = true;
+  mLastReportDate = Hal::millis();
+  mSentCount++;
+}
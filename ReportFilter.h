@@ -0,0 +1,49 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Report by exception.
+ *
+ * A ReportFilter decides whether a message has to be published. The values
+ * of the fields of the message are given with set(). The message is due
+ * when a field has moved by its deadband or more since the last report, or
+ * when the last report is older than the heartbeat period. The fields with
+ * discrete values (state, flags) use a deadband of 0.5 so that any change
+ * is reported.
+ *
+ * When the filter is disabled, every message is due, as before.
+ */
+
+#ifndef __REPORTFILTER_H__
+#define __REPORTFILTER_H__
+
+#include <stdint.h>
+
+class ReportFilter {
+  static const uint8_t kMaxFields = 8;
+
+  float mDeadband[kMaxFields];
+  float mCurrent[kMaxFields];
+  float mReported[kMaxFields];
+  uint8_t mFieldCount;
+  bool mEnabled;
+  bool mHasReported;
+  uint32_t mHeartbeat;
+  uint32_t mLastReportDate;
+  uint32_t mSentCount;
+  uint32_t mSuppressedCount;
+
+public:
+  ReportFilter(const uint32_t inHeartbeat);
+  /* Returns the index of the field, to be given to set() */
+  uint8_t addField(const float inDeadband);
+  void set(const uint8_t inField, const float inValue);
+  void setEnabled(const bool inEnabled) { mEnabled = inEnabled; }
+  /* Counts the message as suppressed if it is not due */
+  bool isDue();
+  /* To call once the message has been published */
+  void reported();
+  uint32_t sentCount() const { return mSentCount; }
+  uint32_t suppressedCount() const { return mSuppressedCount; }
+};
+
+#endif
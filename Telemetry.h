@@ -0,0 +1,100 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Binary encoding of the status.
+ *
+ * The text status (heater<num>/status) is meant to be read by a human. When
+ * the binary format is selected (heater<num>/format set to "bin"), the same
+ * fields are published in a Telemetry::Status record on
+ * heater<num>/status/bin instead. The record is about 4 times smaller than
+ * the text and is decoded by a copy, see tools/telemetry.
+ *
+ * The record is packed and little endian, like the ESP32 and the usual
+ * hosts. It starts with a version. A new field is added at the end and the
+ * version is incremented, so that a decoder can read the older records.
+ *
+ * The statuses sampled while the connection was down are replayed later on
+ * heater<num>/status/replay as TimedStatus records: the date of the sample
+ * followed by the Status.
+ *
+ * This file does not depend on Arduino so that it is shared with the host
+ * decoder.
+ */
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Telemetry {
+public:
+  static const uint8_t kVersion = 3;
+
+  /* Scales of the fixed point fields */
+  static const int32_t kTemperatureScale = 100; /* 0.01 °C */
+  static const int32_t kDerivativeScale = 1000; /* 0.001 °C */
+  static const int32_t kRatioScale = 100;       /* 0.01 %, ratios in % */
+
+  typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t state;           /* Heater::HeaterState */
+    uint8_t ventilation;     /* 0 or 1 */
+    uint8_t checkpoint;      /* Checkpoint::Source */
+    int16_t temperature;     /* corrected room temperature */
+    uint16_t humidity;       /* in kRatioScale */
+    int16_t heatIndex;
+    uint16_t shortTermEnergy;   /* in kRatioScale since version 3 */
+    uint16_t averageTermEnergy; /* in kRatioScale since version 3 */
+    uint16_t longTermEnergy;    /* in kRatioScale since version 3 */
+    int16_t setpoint;        /* setpoint + setpoint offset */
+    int16_t meanTemperature;
+    int16_t derivative;      /* in kDerivativeScale */
+    int16_t integralComponent; /* in kTemperatureScale */
+    uint16_t pwm;            /* in kRatioScale */
+    uint8_t pwmCounter;
+    uint8_t reserved;
+    uint16_t idleRatio;      /* in kRatioScale */
+    uint16_t maxLateness;    /* ms */
+    uint32_t lateSlotCount;
+    uint16_t commandedDuty;  /* in kRatioScale */
+    uint16_t realisedDuty;   /* in kRatioScale */
+    uint32_t checksumErrorCount;
+    uint32_t formatErrorCount;
+    uint32_t settleTime;     /* s */
+    /* Version 2 */
+    uint32_t commandSequence; /* of the last heater<num>/cmd applied */
+    /* Version 3: same layout, the energies are in % */
+  } Status;
+
+  typedef struct __attribute__((packed)) {
+    uint32_t date; /* s since 1970, 0 if the time was not known */
+    Status status;
+  } TimedStatus;
+
+  /*
+   * Conversion to the fixed point fields, rounded to nearest and saturated
+   */
+  static int16_t toInt16(const float inValue, const int32_t inScale) {
+    const float scaled = inValue * inScale + (inValue < 0 ? -0.5f : 0.5f);
+    if (!(scaled > -32768.0f)) {
+      return scaled < 0 ? INT16_MIN : 0; /* NaN gives 0 */
+    }
+    return scaled >= 32767.0f ? INT16_MAX : (int16_t)scaled;
+  }
+
+  static uint16_t toUInt16(const float inValue, const int32_t inScale) {
+    const float scaled = inValue * inScale + 0.5f;
+    if (!(scaled > 0.0f)) {
+      return 0;
+    }
+    return scaled >= 65535.0f ? UINT16_MAX : (uint16_t)scaled;
+  }
+
+private:
+  Telemetry() {} /* prevent instanciation */
+};
+
+static_assert(sizeof(Telemetry::Status) == 56, "layout of version 3 changed");
+
+#endif
@@ -20,3 +20,21 @@ void TemperatureHistory::add(const float inTemp)
   mTemperatureBuffer.push(inTemp);
   mSum += inTemp;
 }
+
+void TemperatureHistory::save(Snapshot &outSnapshot)
+{
+  outSnapshot.count = mTemperatureBuffer.size();
+  for (uint32_t i = 0; i < outSnapshot.count; i++) {
+    outSnapshot.temperatures[i] = mTemperatureBuffer[i];
+  }
+}
+
+/*
+ * Must be called on an empty history
+ */
+void TemperatureHistory::restore(const Snapshot &inSnapshot)
+{
+  for (uint32_t i = 0; i < inSnapshot.count && i < kTemperatureMeasurementSlots; i++) {
+    add(inSnapshot.temperatures[i]);
+  }
+}
@@ -10,9 +10,17 @@ class TemperatureHistory
   float mSum;
 
 public:
+  /* Content of the history for a checkpoint, oldest first */
+  typedef struct {
+    uint32_t count;
+    float temperatures[kTemperatureMeasurementSlots];
+  } Snapshot;
+
   TemperatureHistory() : mSum(0.0) {}
   float mean();
   void add(const float inTemp);
+  void save(Snapshot &outSnapshot);
+  void restore(const Snapshot &inSnapshot);
 };
 
 #endif
@@ -3,39 +3,66 @@
 */
 
 #include "TimeObject.h"
-#include <Arduino.h>
+#include "Hal.h"
 
 /*------------------------------------------------------------------------------
+  La liste des TimeObject est triée par échéance croissante. À échéance égale,
+  l'objet construit en dernier est en tête, comme lorsque la liste était
+  parcourue en entier.
 */
 TimeObject *TimeObject::sTimeObjectList = NULL;
+uint32_t TimeObject::sObjectCount = 0;
+
+/*------------------------------------------------------------------------------
+  Tous les objets dans l'ordre de construction, pour les profils.
+*/
+TimeObject *TimeObject::sFirstObject = NULL;
+TimeObject **TimeObject::sLastObjectLink = &TimeObject::sFirstObject;
 
 
 /*------------------------------------------------------------------------------
 */
 TimeObject::TimeObject(const uint32_t inNextDelay)
-  : mLastDate(0), mNextDelay(inNextDelay)
+  : mLastDate(0), mLateness(0), mRank(UINT32_MAX - sObjectCount++), mNext(NULL),
+    mNextObject(NULL), mName(NULL), mOverrunCount(0), mMissedCount(0),
+    mNextDelay(inNextDelay)
+{
+  insert();
+  *sLastObjectLink = this;
+  sLastObjectLink = &mNextObject;
+}
+
+/*------------------------------------------------------------------------------
+  Compare les échéances en relatif afin de supporter le débordement de
+  millis() tous les 49 jours.
+*/
+bool TimeObject::isBefore(const TimeObject *inObject) const
 {
-  mNext = sTimeObjectList;
-  sTimeObjectList = this;
+  const int32_t diff = (int32_t)(deadline() - inObject->deadline());
+  return diff < 0 || (diff == 0 && mRank < inObject->mRank);
 }
 
 /*------------------------------------------------------------------------------
+  Insère l'objet dans la liste à sa place selon son échéance.
 */
-void TimeObject::objectLoop(const uint32_t inDate)
+void TimeObject::insert()
 {
-  if ((inDate - mLastDate) >= mNextDelay) {
-    mLastDate += mNextDelay;
-    execute();
+  TimeObject **link = &sTimeObjectList;
+  while (*link != NULL && !isBefore(*link)) {
+    link = &(*link)->mNext;
   }
+  mNext = *link;
+  *link = this;
 }
 
 /*------------------------------------------------------------------------------
   setup doit être appeler à la fin du setup du sketch Arduino afin de marquer
-  l'instant initial des TimeObject. 
+  l'instant initial des TimeObject. Toutes les dates sont décalées de la même
+  quantité, l'ordre de la liste est donc conservé.
 */
 void TimeObject::setup()
 {
-  const uint32_t currentDate = millis();
+  const uint32_t currentDate = Hal::millis();
   TimeObject *obj = sTimeObjectList;
   while (obj != NULL) {
     obj->mLastDate = currentDate;
@@ -46,13 +73,66 @@ void TimeObject::setup()
 /*------------------------------------------------------------------------------
   loop doit être appelé aussi souvent que possible dans le loop du sketch
   Arduino afin d'exécuter les TimeObject de la manière la plus précise possible.
+  Seule la tête de liste est examinée lorsque rien n'est échu. Les objets
+  échus sont d'abord retirés de la liste puis exécutés et réinsérés, chacun
+  n'est donc exécuté qu'une fois par appel. La durée de chaque exécution et
+  son retard sont enregistrés dans le profil de l'objet. La date de fin d'une
+  exécution sert de date de début à la suivante, un seul appel à micros()
+  par objet exécuté suffit.
 */
 void TimeObject::loop()
 {
-  const uint32_t currentDate = millis();
-  TimeObject *obj = sTimeObjectList;
-  while (obj != NULL) {
-    obj->objectLoop(currentDate);
-    obj = obj->mNext;
+  const uint32_t currentDate = Hal::millis();
+  if (sTimeObjectList == NULL || !sTimeObjectList->isDue(currentDate)) {
+    return;
+  }
+
+  TimeObject *dueList = sTimeObjectList;
+  TimeObject *lastDue = dueList;
+  while (lastDue->mNext != NULL && lastDue->mNext->isDue(currentDate)) {
+    lastDue = lastDue->mNext;
+  }
+  sTimeObjectList = lastDue->mNext;
+  lastDue->mNext = NULL;
+
+  uint32_t startDate = Hal::micros();
+  while (dueList != NULL) {
+    TimeObject *obj = dueList;
+    dueList = obj->mNext;
+    obj->mLateness = currentDate - obj->deadline();
+    obj->mLastDate += obj->mNextDelay;
+    obj->execute();
+    obj->insert();
+    const uint32_t endDate = Hal::micros();
+    obj->mProfile.record(endDate - startDate, obj->mLateness);
+    startDate = endDate;
+  }
+}
+
+/*------------------------------------------------------------------------------
+  nextDeadline retourne la date à laquelle le prochain TimeObject doit être
+  exécuté. Permet à une horloge virtuelle de sauter directement à cette date
+  ou à l'appelant de savoir combien de temps il peut rester inactif.
+  S'il n'y a aucun TimeObject, la date retournée est aussi lointaine que
+  possible.
+*/
+uint32_t TimeObject::nextDeadline()
+{
+  if (sTimeObjectList == NULL) {
+    return Hal::millis() + INT32_MAX;
+  } else {
+    return sTimeObjectList->deadline();
+  }
+}
+
+/*------------------------------------------------------------------------------
+  Remet à zéro les profils et les compteurs de retard de tous les objets.
+*/
+void TimeObject::resetProfiles()
+{
+  for (TimeObject *obj = sFirstObject; obj != NULL; obj = obj->mNextObject) {
+    obj->mProfile.reset();
+    obj->mOverrunCount = 0;
+    obj->mMissedCount = 0;
   }
 }
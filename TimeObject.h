@@ -5,23 +5,58 @@
 #ifndef __TIMEOBJECT_H__
 #define __TIMEOBJECT_H__
 
+#include "Profile.h"
 #include <stdint.h>
 
 class TimeObject {
     uint32_t mLastDate;
+    uint32_t mLateness;
+    uint32_t mRank;
     TimeObject *mNext;
+    TimeObject *mNextObject; /* all the objects, in construction order */
+    const char *mName;
+    Profile mProfile;
+    uint32_t mOverrunCount;
+    uint32_t mMissedCount;
     static TimeObject *sTimeObjectList;
-
-    void objectLoop(const uint32_t inDate);
+    static TimeObject *sFirstObject;
+    static TimeObject **sLastObjectLink;
+    static uint32_t sObjectCount;
+
+    uint32_t deadline() const { return mLastDate + mNextDelay; }
+    bool isDue(const uint32_t inDate) const { return (inDate - mLastDate) >= mNextDelay; }
+    bool isBefore(const TimeObject *inObject) const;
+    void insert();
     virtual void execute() {}
 
   protected:
     uint32_t mNextDelay;
 
+    /* An execution late by inMissed periods or more, see PeriodicAction */
+    void countOverrun(const uint32_t inMissed)
+    {
+      mOverrunCount++;
+      mMissedCount += inMissed;
+    }
+
   public:
     TimeObject(const uint32_t inNextDelay);
     static void setup();
     static void loop();
+    static uint32_t nextDeadline();
+    /* Lateness (in ms) of the last execution relative to its deadline */
+    uint32_t lateness() const { return mLateness; }
+    /* Profile of the executions, published under the name if any */
+    void setName(const char *inName) { mName = inName; }
+    const char *name() const { return mName; }
+    const Profile &profile() const { return mProfile; }
+    /* Executions late by a period or more, deadlines not executed */
+    uint32_t overrunCount() const { return mOverrunCount; }
+    uint32_t missedCount() const { return mMissedCount; }
+    /* Iteration over all the objects, in construction order */
+    static TimeObject *first() { return sFirstObject; }
+    TimeObject *next() const { return mNextObject; }
+    static void resetProfiles();
 };
 
 #endif
@@ -3,9 +3,10 @@
  */
 
 #include "Timeout.h"
+#include "Hal.h"
 
-void Timeout::timestamp() { mTimestamp = millis(); }
+void Timeout::timestamp() { mTimestamp = Hal::millis(); }
 
-bool Timeout::isTimedout() { return (millis() - mTimestamp) > mInterval; }
+bool Timeout::isTimedout() { return (Hal::millis() - mTimestamp) > mInterval; }
 
-bool Timeout::isNotTimedout() { return (millis() - mTimestamp) <= mInterval; }
+bool Timeout::isNotTimedout() { return (Hal::millis() - mTimestamp) <= mInterval; }
@@ -4,7 +4,7 @@
 #ifndef __TIMEOUT_H__
 #define __TIMEOUT_H__
 
-#include <Arduino.h>
+#include <stdint.h>
 
 class Timeout {
   uint32_t mInterval;
@@ -0,0 +1,98 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Float control laws, for the comparisons with the fixed point Controller.
+ *
+ * OldFloatController is the former law of Heater::computeDuty() and
+ * Heater::pwmFor(): the integral is limited but not frozen while the duty
+ * is saturated. FloatController is the law of Controller computed in
+ * single precision floats, anti-windup included.
+ */
+
+#ifndef __FLOATCONTROLLER_H__
+#define __FLOATCONTROLLER_H__
+
+#include "Config.h"
+#include <math.h>
+#include <stdint.h>
+
+class OldFloatController {
+  float mIntegralComponent;
+  float mDerivative;
+  float mLastMeanTemperature;
+  bool mHasLastMean;
+
+public:
+  OldFloatController()
+      : mIntegralComponent(0.0), mDerivative(0.0),
+        mLastMeanTemperature(kDefaultTemperature), mHasLastMean(false) {}
+
+  uint32_t update(const float inSetpoint, const float inMean) {
+    const float offset = (float)kHeatingSlots / 2.0;
+    const float error = inSetpoint - inMean;
+    mIntegralComponent += error;
+    mDerivative = mHasLastMean ? inMean - mLastMeanTemperature : 0.0;
+    mLastMeanTemperature = inMean;
+    mHasLastMean = true;
+    if (fabsf(mIntegralComponent * kIntegralParameter) > offset) {
+      if (mIntegralComponent > 0) {
+        mIntegralComponent = offset / kIntegralParameter;
+      } else {
+        mIntegralComponent = -offset / kIntegralParameter;
+      }
+    }
+    const float duty = (error * kProportionalParameter) +
+                       (mIntegralComponent * kIntegralParameter) -
+                       (mDerivative * kDerivativeParameter) + offset + 0.5;
+    int32_t pwm = duty;
+    if (pwm < 0) {
+      pwm = 0;
+    } else if (pwm > (int32_t)kHeatingSlots) {
+      pwm = kHeatingSlots;
+    }
+    return pwm;
+  }
+};
+
+class FloatController {
+  float mIntegral;
+  float mLastMean;
+  bool mHasLastMean;
+  float mDerivative;
+
+  float dutyFor(const float inError, const float inIntegral) const {
+    return inError * kProportionalParameter + inIntegral * kIntegralParameter -
+           mDerivative * kDerivativeParameter + (float)kHeatingSlots / 2.0f;
+  }
+
+  static int32_t slots(const float inDuty) {
+    return (int32_t)floorf(inDuty + 0.5f);
+  }
+
+public:
+  FloatController()
+      : mIntegral(0.0), mLastMean(kDefaultTemperature), mHasLastMean(false),
+        mDerivative(0.0) {}
+
+  uint32_t update(const float inSetpoint, const float inMean) {
+    const float limit = (float)kHeatingSlots / 2.0f / kIntegralParameter;
+    const float error = inSetpoint - inMean;
+    mDerivative = mHasLastMean ? inMean - mLastMean : 0.0f;
+    mLastMean = inMean;
+    mHasLastMean = true;
+
+    float integral = mIntegral + error;
+    integral = integral > limit ? limit : integral < -limit ? -limit : integral;
+    const int32_t wanted = slots(dutyFor(error, integral));
+    if (!((wanted > (int32_t)kHeatingSlots && error > 0) ||
+          (wanted < 0 && error < 0))) {
+      mIntegral = integral;
+    }
+    const int32_t pwm = slots(dutyFor(error, mIntegral));
+    return pwm < 0 ? 0 : pwm > (int32_t)kHeatingSlots ? kHeatingSlots : pwm;
+  }
+
+  float integral() const { return mIntegral; }
+};
+
+#endif
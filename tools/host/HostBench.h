@@ -0,0 +1,48 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Timing of the host benchmarks.
+ *
+ * nsPerCall() runs a function inIterations times, kRepeat times over, and
+ * returns the best mean duration of a call in ns: the best run is the one
+ * the least disturbed by the rest of the machine. The figures are those of
+ * the host, they give the ratios between implementations, not the cost on
+ * the ESP32.
+ */
+
+#ifndef __HOSTBENCH_H__
+#define __HOSTBENCH_H__
+
+#include <stdint.h>
+#include <time.h>
+
+static const uint32_t kRepeat = 5;
+
+static inline uint64_t nanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/* Keeps a value the compiler would otherwise drop */
+template <typename T> static inline void keep(const T &inValue) {
+  asm volatile("" : : "g"(&inValue) : "memory");
+}
+
+template <typename F>
+static double nsPerCall(F inFunction, const uint32_t inIterations) {
+  double best = 0;
+  for (uint32_t run = 0; run < kRepeat; run++) {
+    const uint64_t start = nanoseconds();
+    for (uint32_t i = 0; i < inIterations; i++) {
+      inFunction(i);
+    }
+    const double mean = (double)(nanoseconds() - start) / inIterations;
+    if (run == 0 || mean < best) {
+      best = mean;
+    }
+  }
+  return best;
+}
+
+#endif
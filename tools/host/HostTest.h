@@ -0,0 +1,45 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Checks of the host tests.
+ *
+ * CHECK() reports a failed condition with its line and goes on, so that a
+ * run lists all the failures. A test program ends with
+ * return testResult("name"), which prints the outcome and gives the exit
+ * status of make check.
+ */
+
+#ifndef __HOSTTEST_H__
+#define __HOSTTEST_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t sCheckCount = 0;
+static uint32_t sFailureCount = 0;
+
+static inline void check(const bool inCondition, const char *inText,
+                         const char *inFile, const int inLine) {
+  sCheckCount++;
+  if (!inCondition) {
+    sFailureCount++;
+    fprintf(stderr, "%s:%d: failed: %s\n", inFile, inLine, inText);
+  }
+}
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(value, expected, tolerance)                                 \
+  check(fabs((double)(value) - (double)(expected)) <= (tolerance),             \
+        #value " near " #expected, __FILE__, __LINE__)
+
+static inline int testResult(const char *inName) {
+  if (sFailureCount == 0) {
+    printf("%s: %u checks ok\n", inName, sCheckCount);
+    return 0;
+  }
+  printf("%s: %u of %u checks failed\n", inName, sFailureCount, sCheckCount);
+  return 1;
+}
+
+#endif
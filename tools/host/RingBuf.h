@@ -0,0 +1,70 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Host stand-in for the RingBuf library of the Arduino IDE.
+ *
+ * Same interface as the library for the part used by the firmware: push(),
+ * pop(), operator[] from the oldest element, isEmpty(), isFull(), size(),
+ * maxSize() and clear(). The host build is single threaded, the locked
+ * variants are the plain ones.
+ */
+
+#ifndef __RINGBUF_H__
+#define __RINGBUF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename ET, size_t S, typename IT = uint16_t> class RingBuf {
+  static_assert(S > 0 && S <= 65535, "RingBuf size out of range");
+
+  ET mBuffer[S];
+  IT mOldest;
+  IT mCount;
+
+  IT index(const IT inIndex) const {
+    return (IT)(((size_t)mOldest + inIndex) % S);
+  }
+
+public:
+  RingBuf() : mOldest(0), mCount(0) {}
+
+  bool push(const ET &inElement) {
+    if (isFull()) {
+      return false;
+    }
+    mBuffer[index(mCount)] = inElement;
+    mCount++;
+    return true;
+  }
+
+  bool lockedPush(const ET &inElement) { return push(inElement); }
+
+  bool pop(ET &outElement) {
+    if (isEmpty()) {
+      return false;
+    }
+    outElement = mBuffer[mOldest];
+    mOldest = index(1);
+    mCount--;
+    return true;
+  }
+
+  bool lockedPop(ET &outElement) { return pop(outElement); }
+
+  ET &operator[](const IT inIndex) { return mBuffer[index(inIndex)]; }
+  const ET &operator[](const IT inIndex) const {
+    return mBuffer[index(inIndex)];
+  }
+
+  bool isEmpty() const { return mCount == 0; }
+  bool isFull() const { return mCount == S; }
+  IT size() const { return mCount; }
+  size_t maxSize() const { return S; }
+  void clear() {
+    mOldest = 0;
+    mCount = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,42 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * First order thermal model of a room, for the host simulations.
+ *
+ * The room loses heat to the outside with a time constant and gains a
+ * fixed rate while the pilot wire is in comfort, that is while both pins
+ * of the heater are LOW (see Config.h).
+ */
+
+#ifndef __ROOM_H__
+#define __ROOM_H__
+
+#include "Config.h"
+#include "Hal.h"
+
+class Room {
+  float mTemperature;
+  float mHeatingRate;  /* °C per hour in comfort */
+  float mTimeConstant; /* hours */
+
+public:
+  Room(const float inTemperature, const float inHeatingRate = 4.0,
+       const float inTimeConstant = 10.0)
+      : mTemperature(inTemperature), mHeatingRate(inHeatingRate),
+        mTimeConstant(inTimeConstant) {}
+
+  static bool isHeating() {
+    return Hal::pinLevel(pinStop) == LOW && Hal::pinLevel(pinAntifreeze) == LOW;
+  }
+
+  /* The pilot wire and the outside are constant during inDelay ms */
+  void advance(const uint32_t inDelay, const float inOutside) {
+    const float hours = (float)inDelay / 3600000.0;
+    const float loss = (mTemperature - inOutside) / mTimeConstant;
+    mTemperature += hours * ((isHeating() ? mHeatingRate : 0) - loss);
+  }
+
+  float temperature() const { return mTemperature; }
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Cost of the BitRingBuf load from 600 to 100000 bits.
+ *
+ * The former loadAverage() recounted the whole buffer, bit by bit, at each
+ * call. It is reproduced here by RecountBitRingBuf. The current one keeps
+ * the count up to date in push(). Each call pushes a bit and reads the
+ * load, as the heater does at each slot. The windowed load over the last
+ * tenth of the buffer is measured too.
+ */
+
+#include "BitRingBuf.h"
+#include "HostBench.h"
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------
+ * The former count
+ */
+template <size_t S> class RecountBitRingBuf {
+  static const uint32_t kWordCount = S / 32 + ((S % 32) != 0);
+
+  uint32_t mBits[kWordCount];
+  uint32_t mSize;
+  uint32_t mWriteIndex;
+
+  static uint32_t onBitCount(uint32_t inWord) {
+    uint32_t count = 0;
+    if (inWord != 0) {
+      for (uint32_t i = 0; i < 32; i++) {
+        count += inWord & 1;
+        inWord >>= 1;
+      }
+    }
+    return count;
+  }
+
+public:
+  RecountBitRingBuf() : mSize(0), mWriteIndex(0) {
+    for (uint32_t i = 0; i < kWordCount; i++) {
+      mBits[i] = 0;
+    }
+  }
+
+  void push(const uint32_t inBit) {
+    if (mSize < S) {
+      mSize++;
+    }
+    mBits[mWriteIndex / 32] &= ~(1ul << (mWriteIndex % 32));
+    mBits[mWriteIndex / 32] |= (inBit & 1ul) << (mWriteIndex % 32);
+    mWriteIndex = mWriteIndex + 1 == S ? 0 : mWriteIndex + 1;
+  }
+
+  float loadAverage() const {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < kWordCount; i++) {
+      count += onBitCount(mBits[i]);
+    }
+    return mSize > 0 ? 100.0 * (float)count / (float)mSize : 0;
+  }
+};
+
+/* Same pseudo random bits for every buffer, about 40 % of ones */
+static uint32_t bitAt(const uint32_t inIndex) {
+  return ((inIndex * 2654435761u) >> 16) % 10 < 4;
+}
+
+template <size_t S> static void measure() {
+  static RecountBitRingBuf<S> recount;
+  static BitRingBuf<S> incremental;
+  for (uint32_t i = 0; i < S; i++) {
+    recount.push(bitAt(i));
+    incremental.push(bitAt(i));
+  }
+  const uint32_t iterations = 20000000 / S + 1000;
+  const double before = nsPerCall(
+      [](uint32_t i) {
+        recount.push(bitAt(i));
+        keep(recount.loadAverage());
+      },
+      iterations);
+  const double after = nsPerCall(
+      [](uint32_t i) {
+        incremental.push(bitAt(i));
+        keep(incremental.loadAverage());
+      },
+      iterations);
+  const double window = nsPerCall(
+      [](uint32_t i) {
+        incremental.push(bitAt(i));
+        keep(incremental.loadAverage(S / 10));
+      },
+      iterations);
+  printf("%u,%.1f,%.1f,%.1f\n", (uint32_t)S, before, after, window);
+}
+
+int main() {
+  printf("bits,recount (ns),incremental (ns),last tenth (ns)\n");
+  measure<600>();
+  measure<1000>();
+  measure<10000>();
+  measure<100000>();
+  return 0;
+}
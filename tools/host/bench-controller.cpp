@@ -0,0 +1,117 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Closed loop start of the fixed point controller against the former float
+ * law, and cost of an update.
+ *
+ * A cold room at 12 °C is heated to 20 °C for a day, one PWM cycle of 30 s
+ * at a time, by a slow and by a fast heater. The room exchanges with its
+ * walls, which lag behind it, and the walls with the outside at 5 °C. The
+ * mean temperature given to the law is that of 5 DHT22 readings quantised
+ * to 0.1 °C with noise. For each law and heater, the overshoot and the time
+ * to first come within 0.2 °C of the setpoint are the means over 20 runs.
+ *
+ * The cost is that of update() on a cycling mean, see FloatController.h
+ * for the former law.
+ */
+
+#include "Config.h"
+#include "FloatController.h"
+#include "Heater.h"
+#include "HostBench.h"
+#include <stdio.h>
+
+static const uint32_t kRunCount = 20;
+static const uint32_t kCycleCount = 24ul * 3600ul * 1000ul / kHeatingPeriod;
+static const float kSetpoint = 20.0;
+static const float kSettledBand = 0.2;
+
+static uint32_t sRandom = 1;
+
+static uint32_t nextRandom() {
+  sRandom ^= sRandom << 13;
+  sRandom ^= sRandom >> 17;
+  sRandom ^= sRandom << 5;
+  return sRandom;
+}
+
+/*------------------------------------------------------------------------------
+ * The two laws behind the same interface
+ */
+class FixedLaw {
+  HeaterController mController;
+
+public:
+  FixedLaw() : mController(toFixed(kDefaultTemperature)) {}
+  uint32_t update(const float inSetpoint, const float inMean) {
+    return mController.update(toFixed(inSetpoint), toFixed(inMean));
+  }
+};
+
+/*------------------------------------------------------------------------------
+ * inHeating is the rise of the room in °C per slot on
+ */
+template <typename L>
+static void coldStart(const char *inName, const double inHeating) {
+  double overshoot = 0;
+  double settleTime = 0;
+  for (uint32_t run = 1; run <= kRunCount; run++) {
+    L law;
+    sRandom = run * 2654435761u;
+    double room = 12.0;
+    double wall = 12.0;
+    double maxRoom = room;
+    int32_t settledCycle = -1;
+    for (uint32_t cycle = 0; cycle < kCycleCount; cycle++) {
+      float mean = 0;
+      for (uint32_t i = 0; i < kTemperatureMeasurementSlots; i++) {
+        const double noise = ((int32_t)(nextRandom() % 7) - 3) * 0.05;
+        mean += roundf((room + noise) * 10.0) / 10.0;
+      }
+      mean /= kTemperatureMeasurementSlots;
+      const uint32_t pwm = law.update(kSetpoint, mean);
+      for (uint32_t slot = 0; slot < kHeatingSlots; slot++) {
+        room += (slot < pwm ? inHeating : 0) - 0.0004 * (room - wall);
+        wall += 0.00005 * (room - wall) - 0.00002 * (wall - 5.0);
+      }
+      if (room > maxRoom) {
+        maxRoom = room;
+      }
+      if (settledCycle < 0 && cycle > 10 &&
+          fabs(room - kSetpoint) < kSettledBand) {
+        settledCycle = cycle;
+      }
+    }
+    overshoot += maxRoom - kSetpoint;
+    settleTime += settledCycle * (kHeatingPeriod / 1000) / 60.0;
+  }
+  printf("%s,%.3f,%.2f,%.0f\n", inName, inHeating, overshoot / kRunCount,
+         settleTime / kRunCount);
+}
+
+int main() {
+  printf("law,heating (C per slot),overshoot (C),within %.1f C after (min)\n",
+         kSettledBand);
+  coldStart<OldFloatController>("former float", 0.004);
+  coldStart<FixedLaw>("fixed point", 0.004);
+  coldStart<OldFloatController>("former float", 0.008);
+  coldStart<FixedLaw>("fixed point", 0.008);
+
+  static HeaterController fixedController(toFixed(kDefaultTemperature));
+  static OldFloatController oldController;
+  const uint32_t iterations = 10000000;
+  const double fixedCost = nsPerCall(
+      [](uint32_t i) {
+        const float mean = 19.0f + (i % 40) * 0.05f;
+        keep(fixedController.update(toFixed(kSetpoint), toFixed(mean)));
+      },
+      iterations);
+  const double oldCost = nsPerCall(
+      [](uint32_t i) {
+        keep(oldController.update(kSetpoint, 19.0f + (i % 40) * 0.05f));
+      },
+      iterations);
+  printf("# update: fixed point %.1f ns, former float %.1f ns\n", fixedCost,
+         oldCost);
+  return 0;
+}
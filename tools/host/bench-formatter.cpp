@@ -0,0 +1,228 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Cost of the status line with the Formatter and with String.
+ *
+ * The status line of publishData() is built as in FirmwareRadiateur.ino,
+ * in a FixedFormatter and, as before, by String concatenations. String is
+ * replaced by StringLine, a std::string that converts the numbers into a
+ * temporary as String(float) does. operator new is counted to give the
+ * allocations per line. std::string keeps short strings inline, so the
+ * count of the String version is a lower bound of the one on the ESP32.
+ *
+ * The floats are then compared with "%.2f" on random values. A difference
+ * is expected on the values that lie on a half at float precision, the
+ * Formatter rounds them up as Print does. Any other difference is
+ * reported and makes the bench fail.
+ */
+
+#include "Formatter.h"
+#include "HostBench.h"
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static uint32_t sAllocationCount = 0;
+
+void *operator new(size_t inSize) {
+  sAllocationCount++;
+  void *block = malloc(inSize);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void operator delete(void *inBlock) noexcept { free(inBlock); }
+void operator delete(void *inBlock, size_t) noexcept { free(inBlock); }
+
+/*------------------------------------------------------------------------------
+ * The former String concatenations
+ */
+class StringLine : public std::string {
+public:
+  StringLine(const char *inString) : std::string(inString) {}
+  StringLine &operator+=(const char *inString) {
+    append(inString);
+    return *this;
+  }
+  StringLine &operator+=(const char inChar) {
+    push_back(inChar);
+    return *this;
+  }
+  StringLine &operator+=(const uint32_t inValue) {
+    append(std::to_string(inValue));
+    return *this;
+  }
+  StringLine &operator+=(const float inValue) {
+    char digits[33];
+    snprintf(digits, sizeof(digits), "%.2f", inValue);
+    append(std::string(digits));
+    return *this;
+  }
+};
+
+/* Values of a running heater, they change a little at each call */
+struct Status {
+  float temperature;
+  float humidity;
+  float heatIndex;
+  float energy[3];
+  float setpoint;
+  bool ventilation;
+  float mean;
+  float derivative;
+  float integral;
+  float pwm;
+  uint32_t counter;
+  float idle;
+  uint32_t lateness;
+  uint32_t lateSlots;
+  float duty[2];
+  uint32_t dhtErrors[2];
+  uint32_t settle;
+};
+
+static Status statusAt(const uint32_t inIndex) {
+  const float step = (float)(inIndex % 100) * 0.01f;
+  Status status = {20.1f + step, 45.3f, 19.8f + step, {0.53f, 0.41f, 0.38f},
+                   19.0f, false, 19.94f + step, -0.012f, -3.21f + step,
+                   50.0f, inIndex % 60, 95.17f, 3, 0, {50.0f, 49.87f}, {0, 1},
+                   1234};
+  return status;
+}
+
+static void formatStatus(Formatter &ioLine, const Status &inStatus) {
+  ioLine.clear();
+  ioLine << "auto" << ',' << inStatus.temperature << ',' << inStatus.humidity
+         << ',' << inStatus.heatIndex << ',' << inStatus.energy[0] << '/'
+         << inStatus.energy[1] << '/' << inStatus.energy[2]
+         << ", CON=" << inStatus.setpoint << ", VENT=" << inStatus.ventilation
+         << ", MEAN=" << inStatus.mean << ", DRV=" << inStatus.derivative
+         << ", CI=" << inStatus.integral << ", PWM=" << inStatus.pwm
+         << "%, CNT=" << inStatus.counter << ", IDLE=" << inStatus.idle
+         << "%, LATE=" << inStatus.lateness << ", LATESLOT=" << inStatus.lateSlots
+         << ", DUTY=" << inStatus.duty[0] << '/' << inStatus.duty[1]
+         << ", DHTERR=" << inStatus.dhtErrors[0] << '/' << inStatus.dhtErrors[1]
+         << ", SETTLE=" << inStatus.settle << ", CKPT=" << "rtc";
+}
+
+static size_t concatenateStatus(const Status &inStatus) {
+  StringLine data("auto");
+  data += ',';
+  data += inStatus.temperature;
+  data += ',';
+  data += inStatus.humidity;
+  data += ',';
+  data += inStatus.heatIndex;
+  data += ',';
+  data += inStatus.energy[0];
+  data += '/';
+  data += inStatus.energy[1];
+  data += '/';
+  data += inStatus.energy[2];
+  data += ", CON=";
+  data += inStatus.setpoint;
+  data += ", VENT=";
+  data += (uint32_t)inStatus.ventilation;
+  data += ", MEAN=";
+  data += inStatus.mean;
+  data += ", DRV=";
+  data += inStatus.derivative;
+  data += ", CI=";
+  data += inStatus.integral;
+  data += ", PWM=";
+  data += inStatus.pwm;
+  data += "%, CNT=";
+  data += inStatus.counter;
+  data += ", IDLE=";
+  data += inStatus.idle;
+  data += "%, LATE=";
+  data += inStatus.lateness;
+  data += ", LATESLOT=";
+  data += inStatus.lateSlots;
+  data += ", DUTY=";
+  data += inStatus.duty[0];
+  data += '/';
+  data += inStatus.duty[1];
+  data += ", DHTERR=";
+  data += inStatus.dhtErrors[0];
+  data += '/';
+  data += inStatus.dhtErrors[1];
+  data += ", SETTLE=";
+  data += inStatus.settle;
+  data += ", CKPT=";
+  data += "rtc";
+  return data.length();
+}
+
+/*------------------------------------------------------------------------------
+ * Returns the number of differences with "%.2f" that are not on a half
+ */
+static uint32_t compareWithPrintf(const uint32_t inCount) {
+  FixedFormatter<32> line;
+  char expected[32];
+  char above[32];
+  uint32_t halves = 0;
+  uint32_t others = 0;
+  srand(1);
+  for (uint32_t i = 0; i < inCount; i++) {
+    const float scale = i % 3 == 0 ? 0.01f : 1.0f;
+    const float value = (float)(rand() % 2000000 - 1000000) / 1000.0f * scale;
+    line.clear();
+    line << value;
+    snprintf(expected, sizeof(expected), "%.2f", value);
+    /* "-0.00" is written "0.00" */
+    if (strcmp(expected, line.c_str()) == 0 ||
+        strcmp(expected, "-0.00") == 0) {
+      continue;
+    }
+    /* On a half, the next float away from 0 gives the rounding up */
+    snprintf(above, sizeof(above), "%.2f",
+             nextafterf(value, value < 0 ? -INFINITY : INFINITY));
+    if (strcmp(above, line.c_str()) == 0) {
+      halves++;
+    } else {
+      if (others < 5) {
+        printf("# %.9g: %s, printf %s\n", value, line.c_str(), expected);
+      }
+      others++;
+    }
+  }
+  printf("# %u values, %u differences on a half, %u others\n", inCount, halves,
+         others);
+  return others;
+}
+
+int main() {
+  const uint32_t iterations = 100000;
+  static FixedFormatter<257> line;
+  formatStatus(line, statusAt(0));
+  const size_t length = line.length();
+
+  uint32_t start = sAllocationCount;
+  const double formatter = nsPerCall(
+      [](uint32_t i) {
+        formatStatus(line, statusAt(i));
+        keep(line);
+      },
+      iterations);
+  const double formatterAllocations =
+      (double)(sAllocationCount - start) / (kRepeat * iterations);
+
+  start = sAllocationCount;
+  const double concatenation = nsPerCall(
+      [](uint32_t i) { keep(concatenateStatus(statusAt(i))); }, iterations);
+  const double concatenationAllocations =
+      (double)(sAllocationCount - start) / (kRepeat * iterations);
+
+  printf("line,bytes,ns per line,allocations per line\n");
+  printf("Formatter,%u,%.0f,%.1f\n", (uint32_t)length, formatter,
+         formatterAllocations);
+  printf("String,%u,%.0f,%.1f\n", (uint32_t)concatenateStatus(statusAt(0)),
+         concatenation, concatenationAllocations);
+  return compareWithPrintf(200000) == 0 ? 0 : 1;
+}
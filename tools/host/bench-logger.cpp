@@ -0,0 +1,132 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Cost of a debug line, LOGT; DEBUG_P("PWM="); DEBUG_PLN(pwm), as in
+ * Heater::computeDuty().
+ *
+ * The former macros printed to Serial at once, the date being formatted by
+ * logTime(). They are reproduced here by DirectLog and print to the Serial
+ * stand-in. On the ESP32, the UART wait (about 87 us per character once
+ * its FIFO is full) comes on top. The current macros build a record in the
+ * Logger, it is formatted later by drain(). The line is measured recorded,
+ * filtered out by the level, and drained. The output goes to /dev/null.
+ */
+
+#include "Debug.h"
+#include "Hal.h"
+#include "HostBench.h"
+#include <stdio.h>
+#include <unistd.h>
+
+static const uint8_t kLogModule = Logger::HEATER;
+static const uint32_t kIterations = 200000;
+/* Lines recorded between two drains, they fit in a channel */
+static const uint32_t kBatch = 32;
+
+static VirtualClock sClock;
+static const float sPWM = 12.5;
+
+/*------------------------------------------------------------------------------
+ * The former macros of Debug.h and Debug.cpp
+ */
+class DirectLog {
+  DirectLog() {} /* prevent instanciation */
+
+  static void fmtPrint(const uint32_t inVal, const uint8_t inFieldSize) {
+    uint32_t tmp = inVal / 10;
+    uint8_t s = 1;
+    while (tmp > 0) {
+      s++;
+      tmp /= 10;
+    }
+    for (uint8_t i = 0; i < (inFieldSize - s); i++) {
+      Serial.print('0');
+    }
+    Serial.print((unsigned int)inVal);
+  }
+
+public:
+  static void logTime() {
+    const uint32_t date = Hal::millis();
+    fmtPrint(date / 3600000, 2);
+    Serial.print(':');
+    fmtPrint((date / 60000) % 60, 2);
+    Serial.print(':');
+    fmtPrint((date / 1000) % 60, 2);
+    Serial.print('.');
+    fmtPrint(date % 1000, 3);
+    Serial.print(" : ");
+  }
+};
+
+static void drainAll() {
+  while (Logger::isPending()) {
+    Logger::drain();
+  }
+}
+
+int main() {
+  Hal::setClock(sClock);
+  sClock.set(3723456);
+  /* The results go to the original standard output */
+  FILE *results = fdopen(dup(fileno(stdout)), "w");
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    perror("/dev/null");
+    return 1;
+  }
+
+  const double direct = nsPerCall(
+      [](uint32_t) {
+        DirectLog::logTime();
+        Serial.print("PWM=");
+        Serial.println((double)sPWM);
+      },
+      kIterations);
+
+  /* Recorded then drained every kBatch lines, both timed apart */
+  Logger::setLevels("all=debug");
+  double recorded = 0;
+  double drained = 0;
+  for (uint32_t run = 0; run < kRepeat; run++) {
+    uint64_t recordTime = 0;
+    uint64_t drainTime = 0;
+    for (uint32_t batch = 0; batch < kIterations / kBatch; batch++) {
+      const uint64_t start = nanoseconds();
+      for (uint32_t i = 0; i < kBatch; i++) {
+        LOGT;
+        DEBUG_P("PWM=");
+        DEBUG_PLN(sPWM);
+      }
+      const uint64_t middle = nanoseconds();
+      drainAll();
+      recordTime += middle - start;
+      drainTime += nanoseconds() - middle;
+    }
+    const uint32_t lineCount = kIterations / kBatch * kBatch;
+    if (run == 0 || (double)recordTime / lineCount < recorded) {
+      recorded = (double)recordTime / lineCount;
+    }
+    if (run == 0 || (double)drainTime / lineCount < drained) {
+      drained = (double)drainTime / lineCount;
+    }
+  }
+
+  Logger::setLevels("all=info");
+  const double filtered = nsPerCall(
+      [](uint32_t) {
+        LOGT;
+        DEBUG_P("PWM=");
+        DEBUG_PLN(sPWM);
+      },
+      kIterations);
+
+  fprintf(results, "line,ns\n");
+  fprintf(results, "direct Serial,%.0f\n", direct);
+  fprintf(results, "Logger recorded,%.0f\n", recorded);
+  fprintf(results, "Logger filtered,%.0f\n", filtered);
+  fprintf(results, "Logger drain,%.0f\n", drained);
+  fprintf(results, "# %u lines recorded, %u dropped\n", Logger::recordCount(),
+          Logger::droppedCount());
+  fclose(results);
+  return 0;
+}
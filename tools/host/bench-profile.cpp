@@ -0,0 +1,56 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Cost of the profiling of the actions.
+ *
+ * Profile::measureCost() is run as at boot, on a clock that reads the
+ * monotonic time of the host instead of the VirtualClock. Its parts are
+ * measured apart: a Hal::micros() alone and a Profile::record() alone. The
+ * overhead published in prof= is the cost of measureCost() times the number
+ * of records.
+ */
+
+#include "Hal.h"
+#include "HostBench.h"
+#include "Profile.h"
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------
+ * Clock of the host
+ */
+class MonotonicClock : public Clock {
+public:
+  virtual uint32_t millis() { return nanoseconds() / 1000000ull; }
+  virtual uint32_t micros() { return nanoseconds() / 1000ull; }
+  virtual void sleep(const uint32_t /* inDelay */) {}
+};
+
+static MonotonicClock sClock;
+static const uint32_t kIterations = 1000000;
+
+int main() {
+  Hal::setClock(sClock);
+
+  uint32_t cost = 0;
+  for (uint32_t run = 0; run < kRepeat; run++) {
+    const uint32_t measured = Profile::measureCost();
+    if (run == 0 || measured < cost) {
+      cost = measured;
+    }
+  }
+  const double clock =
+      nsPerCall([](uint32_t) { keep(Hal::micros()); }, kIterations);
+  static Profile profile;
+  const double record = nsPerCall(
+      [](uint32_t i) {
+        profile.record(i & 1023, i & 7);
+        keep(profile);
+      },
+      kIterations);
+
+  printf("measure,ns\n");
+  printf("Profile::measureCost,%u\n", cost);
+  printf("Hal::micros,%.1f\n", clock);
+  printf("Profile::record,%.1f\n", record);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Cost of a TimeObject::loop() pass with nothing due and of nextDeadline()
+ * against the number of objects.
+ *
+ * The former implementation walked the whole list and compared every
+ * object with the date on each pass, nextDeadline() did the same. It is
+ * reproduced here by LinearObject. The current list is sorted by deadline,
+ * a pass with nothing due only looks at its head.
+ */
+
+#include "HostBench.h"
+#include "Hal.h"
+#include "TimeObject.h"
+#include <stdio.h>
+
+static const uint32_t kPeriod = 60000;
+static const uint32_t kIterations = 200000;
+
+/*------------------------------------------------------------------------------
+ * An object that is never due during the benchmark
+ */
+class IdleObject : public TimeObject {
+  virtual void execute() { mNextDelay = kPeriod; }
+
+public:
+  IdleObject(const uint32_t inDelay) : TimeObject(inDelay) {}
+};
+
+/*------------------------------------------------------------------------------
+ * The former list, in construction order
+ */
+class LinearObject {
+  uint32_t mLastDate;
+  uint32_t mNextDelay;
+  LinearObject *mNext;
+  static LinearObject *sList;
+
+public:
+  LinearObject(const uint32_t inDelay)
+      : mLastDate(0), mNextDelay(inDelay), mNext(sList) {
+    sList = this;
+  }
+
+  static void loop() {
+    const uint32_t currentDate = Hal::millis();
+    for (LinearObject *obj = sList; obj != NULL; obj = obj->mNext) {
+      if ((currentDate - obj->mLastDate) >= obj->mNextDelay) {
+        obj->mLastDate += obj->mNextDelay;
+        obj->mNextDelay = kPeriod;
+      }
+    }
+  }
+
+  static uint32_t nextDeadline() {
+    const uint32_t currentDate = Hal::millis();
+    uint32_t nearestDelay = UINT32_MAX;
+    for (LinearObject *obj = sList; obj != NULL; obj = obj->mNext) {
+      const uint32_t elapsed = currentDate - obj->mLastDate;
+      const uint32_t delay =
+          elapsed >= obj->mNextDelay ? 0 : obj->mNextDelay - elapsed;
+      if (delay < nearestDelay) {
+        nearestDelay = delay;
+      }
+    }
+    return currentDate + nearestDelay;
+  }
+};
+
+LinearObject *LinearObject::sList = NULL;
+
+/*------------------------------------------------------------------------------
+ */
+int main() {
+  static const uint32_t kCounts[] = {1, 4, 16, 64, 256, 1024};
+  VirtualClock clock(1);
+  Hal::setClock(clock);
+
+  printf("objects,linear loop (ns),sorted loop (ns),"
+         "linear nextDeadline (ns),sorted nextDeadline (ns)\n");
+  uint32_t count = 0;
+  for (const uint32_t target : kCounts) {
+    for (; count < target; count++) {
+      /* Deadlines spread over the period, none before the date */
+      const uint32_t delay = kPeriod / 2 + (count * 7919) % (kPeriod / 2);
+      new IdleObject(delay);
+      new LinearObject(delay);
+    }
+    const double linearLoop =
+        nsPerCall([](uint32_t) { LinearObject::loop(); }, kIterations);
+    const double sortedLoop =
+        nsPerCall([](uint32_t) { TimeObject::loop(); }, kIterations);
+    const double linearNext = nsPerCall(
+        [](uint32_t) { keep(LinearObject::nextDeadline()); }, kIterations);
+    const double sortedNext = nsPerCall(
+        [](uint32_t) { keep(TimeObject::nextDeadline()); }, kIterations);
+    printf("%u,%.1f,%.1f,%.1f,%.1f\n", count, linearLoop, sortedLoop,
+           linearNext, sortedNext);
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Simulation of a heater in a room on the host.
+ *
+ * The objects of the firmware run on a VirtualClock that jumps from one
+ * TimeObject deadline to the next, so that days of heating are simulated in
+ * a few seconds. The room is a first order thermal model, see Room.h, and
+ * the outside temperature follows a daily sine. The DHT22 reads the room
+ * temperature. The setpoint is kDefaultTemperature from 6 h to 22 h and
+ * kNightTemperature at night.
+ *
+ * The controller state is checkpointed as on the ESP32 and the history is
+ * written in a temporary directory. Half way through, a software restart is
+ * simulated: the heater and the history are rebuilt and restored from the
+ * checkpoint.
+ *
+ * Writes one CSV line per hour on stdout and a summary on stderr. Returns
+ * 1 if the room did not follow the setpoint.
+ *
+ * Build: make, see the Makefile
+ * Usage: simulation [days], 7 days by default, at most 45 since millis()
+ *        wraps after 49 days
+ */
+
+#include "Checkpoint.h"
+#include "Config.h"
+#include "DHTReader.h"
+#include "Hal.h"
+#include "Heater.h"
+#include "HistoryStore.h"
+#include "Logger.h"
+#include "PeriodicAction.h"
+#include "Room.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*------------------------------------------------------------------------------
+ * Room and schedule
+ */
+static const float kNightTemperature = 16.0;
+static const float kOutsideMean = 5.0;
+static const float kOutsideSwing = 4.0;    /* amplitude of the daily sine */
+static const uint32_t kStartEpoch = 1700006400ul; /* a midnight UTC */
+static const uint32_t kMaxDays = 45;
+
+/* Mean error to the setpoint tolerated once settled, in °C */
+static const float kMaxMeanError = 0.3;
+
+static const uint32_t kHour = 3600ul * 1000ul;
+static const uint32_t kDay = 24ul * kHour;
+
+static VirtualClock sClock;
+static Heater *sHeater = NULL;
+static HistoryStore *sHistory = NULL;
+static char sHistoryPath[] = "/tmp/heater-simulation-XXXXXX";
+static Room sRoom(12.0);
+
+DHTReader dhtReader(pinDHT22, 1000, kHeatingPeriod / kTemperatureMeasurementSlots);
+PeriodicAction heaterCommandAction(1000, kHeatingPeriod / kTemperatureMeasurementSlots);
+PeriodicAction heaterControlAction(1000, kHeatingSlotDuration, PeriodicAction::SKIP_ALIGNED);
+PeriodicAction historyAction(kHistorySamplePeriod, kHistorySamplePeriod);
+PeriodicAction checkpointAction(kCheckpointPeriod, kCheckpointPeriod);
+PeriodicAction persistentCheckpointAction(kPersistentCheckpointPeriod,
+                                          kPersistentCheckpointPeriod);
+
+/*------------------------------------------------------------------------------
+ * Schedule and outside temperature
+ */
+static float setpointAt(const uint32_t inDate) {
+  const uint32_t hour = (inDate % kDay) / kHour;
+  return hour >= 6 && hour < 22 ? kDefaultTemperature : kNightTemperature;
+}
+
+static float outsideAt(const uint32_t inDate) {
+  /* Coldest at 4 h, warmest at 16 h */
+  const float phase = 2.0 * M_PI * ((float)(inDate % kDay) / kDay - 16.0 / 24.0);
+  return kOutsideMean + kOutsideSwing * cosf(phase);
+}
+
+/*------------------------------------------------------------------------------
+ * The pilot wire is constant during inDelay ms
+ */
+static void updateRoom(const uint32_t inDate, const uint32_t inDelay) {
+  sRoom.advance(inDelay, outsideAt(inDate));
+  dhtReader.simulate(sRoom.temperature(), 50.0);
+}
+
+/*------------------------------------------------------------------------------
+ * The actions of the firmware, see FirmwareRadiateur.ino
+ */
+static void commandHeater() {
+  float t;
+  float h;
+  if (dhtReader.sample(t, h)) {
+    sHeater->setRoomTemperature(t);
+  }
+  sHeater->setSetpoint(setpointAt(Hal::millis()));
+  sHeater->setAuto();
+}
+
+static void controlHeater() { sHeater->loop(); }
+
+static void heaterSlotTick() { sHeater->slotTick(); }
+
+static void recordHistory() {
+  sHistory->add(Hal::epoch(),
+                sHeater->recentEnergy(kHistorySamplePeriod / kHeatingSlotDuration),
+                sHeater->meanRoomTemperature(), sHeater->setpoint());
+}
+
+static void fillCheckpoint(Checkpoint::Data &outData) {
+  sHeater->save(outData.heater);
+  outData.setpointTemperature = sHeater->setpoint();
+  outData.setpointOffset = 0;
+  outData.functioningMode = Heater::AUTO;
+  sHistory->save(outData.history);
+}
+
+static void saveCheckpoint() {
+  Checkpoint::Data data;
+  fillCheckpoint(data);
+  Checkpoint::save(data);
+}
+
+static void savePersistentCheckpoint() {
+  Checkpoint::Data data;
+  fillCheckpoint(data);
+  Checkpoint::savePersistent(data);
+}
+
+/*------------------------------------------------------------------------------
+ * Builds the heater and the history, restored from the checkpoint if any
+ */
+static void start() {
+  sHeater = new Heater(pinAddr, pinStop, pinAntifreeze);
+  sHeater->begin(kDefaultTemperature);
+  sHistory = new HistoryStore();
+  Checkpoint::Data data;
+  if (Checkpoint::restore(data)) {
+    sHeater->restore(data.heater);
+    sHistory->restore(data.history);
+  }
+  sHistory->begin(sHistoryPath);
+}
+
+static void restart() {
+  sHistory->flush();
+  delete sHistory;
+  delete sHeater;
+  start();
+}
+
+static void removeHistory() {
+  for (uint32_t level = 0; level < HistoryStore::kLevelCount; level++) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/hist%u.bin", sHistoryPath, level);
+    unlink(name);
+  }
+  rmdir(sHistoryPath);
+}
+
+/*------------------------------------------------------------------------------
+ */
+int main(int argc, char *argv[]) {
+  const uint32_t days = argc > 1 ? strtoul(argv[1], NULL, 10) : 7;
+  if (days == 0 || days > kMaxDays) {
+    fprintf(stderr, "usage: %s [days], 1 to %u days\n", argv[0], kMaxDays);
+    return 1;
+  }
+  if (mkdtemp(sHistoryPath) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  Hal::setClock(sClock);
+  Hal::setEpoch(kStartEpoch);
+  Logger::setLevels("all=warning");
+  start();
+  dhtReader.begin();
+  dhtReader.simulate(sRoom.temperature(), 50.0);
+  heaterCommandAction.begin(commandHeater, "cmd");
+  heaterControlAction.begin(controlHeater, "ctl");
+  historyAction.begin(recordHistory, "hist");
+  checkpointAction.begin(saveCheckpoint, "ckpt");
+  persistentCheckpointAction.begin(savePersistentCheckpoint, "nvs");
+  Hal::startTimer(kHeatingSlotDuration, heaterSlotTick);
+  TimeObject::setup();
+
+  puts("hour,outside,room,setpoint,duty,energy");
+  const uint32_t end = days * kDay;
+  const uint32_t restartDate = end / 2 + kHour / 2;
+  bool restarted = false;
+  uint32_t nextReport = kHour;
+  double errorSum = 0;
+  uint32_t errorCount = 0;
+  float maxOvershoot = 0;
+
+  while (sClock.millis() < end) {
+    TimeObject::loop();
+    Logger::drain();
+    const uint32_t now = sClock.millis();
+    if (!restarted && now >= restartDate) {
+      restarted = true;
+      restart();
+    }
+    if (now >= nextReport) {
+      printf("%u,%.2f,%.2f,%.1f,%.1f,%.2f\n", now / kHour, outsideAt(now),
+             sRoom.temperature(), sHeater->setpoint(), sHeater->realisedDuty(),
+             sHeater->longTermEnergy());
+      nextReport += kHour;
+    }
+    /* The first day and the 2 h after a change of setpoint are transients */
+    const uint32_t hour = (now % kDay) / kHour;
+    if (now >= kDay && hour >= 8 && hour < 22) {
+      const float error = sRoom.temperature() - sHeater->setpoint();
+      errorSum += error < 0 ? -error : error;
+      errorCount++;
+      if (error > maxOvershoot) {
+        maxOvershoot = error;
+      }
+    }
+
+    uint32_t next = TimeObject::nextDeadline();
+    if ((int32_t)(next - now) < 0) {
+      next = now;
+    }
+    updateRoom(now, next - now);
+    sClock.set(next);
+  }
+  sHistory->flush();
+
+  const float meanError = errorCount > 0 ? errorSum / errorCount : 0;
+  fprintf(stderr,
+          "days=%u meanError=%.3f maxOvershoot=%.2f late=%u lost=%u "
+          "history=%u/%u restarts=%u checkpoint=%s\n",
+          days, meanError, maxOvershoot, sHeater->lateSlotCount(),
+          sHeater->lostSlotCount(), sHistory->writtenCount(),
+          sHistory->droppedCount(), Hal::restartCount(),
+          Checkpoint::stringSource());
+  removeHistory();
+  return days > 1 && meanError > kMaxMeanError ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the reconnection backoff and of the reconnection storm.
+ *
+ * The first part checks the rules of Backoff: first retry after a loss in
+ * [0, base], delays bounded by min(cap, base * 2^n), end of a series after
+ * kBackoffStableTime and restart past the budget.
+ *
+ * The second part simulates 64 heaters connected to a broker that goes down
+ * for 90 s and then accepts 8 connections per second. Connection::update()
+ * runs every second on every heater. The heaters either retry at each
+ * update and restart after 60 failures, as the former Retryer did, or wait
+ * for their broker Backoff seeded with their MAC address. It prints the
+ * attempts, the date at which all the heaters are online and the restarts.
+ */
+
+#include "Backoff.h"
+#include "Config.h"
+#include "Crc.h"
+#include "Hal.h"
+#include "HostTest.h"
+
+static const uint32_t kNodeCount = 64;
+static const uint32_t kBrokerDownTime = 90ul * 1000ul;
+static const uint32_t kBrokerAcceptRate = 8; /* connections per second */
+static const uint32_t kUpdatePeriod = 1000ul;
+static const uint32_t kStormDuration = 10ul * 60ul * 1000ul;
+static const uint32_t kRetryerCountLimit = 60; /* former brokerMQTTRetryCount */
+
+static VirtualClock sClock;
+
+static void checkRules() {
+  Backoff backoff(kBrokerBackoffBase, kBrokerBackoffCap, kConnectionRestartBudget);
+  backoff.seed(0x12345678);
+  sClock.set(1000000);
+  backoff.succeeded();
+  CHECK(backoff.delay() <= kBrokerBackoffBase);
+
+  /* The first retry is counted from the first isDue() after the loss */
+  sClock.advance(kBackoffStableTime);
+  CHECK(backoff.isDue() == (backoff.delay() == 0));
+  sClock.advance(kBrokerBackoffBase);
+  CHECK(backoff.isDue());
+
+  /* Delays bounded by min(cap, base * 2^n) */
+  bool bounded = true;
+  for (uint32_t n = 0; n < 10; n++) {
+    backoff.attempted();
+    const uint32_t ceiling = kBrokerBackoffBase << n;
+    const uint32_t limit = ceiling < kBrokerBackoffCap ? ceiling : kBrokerBackoffCap;
+    bounded = bounded && backoff.delay() <= limit;
+    CHECK(backoff.count() == n + 1);
+    sClock.advance(backoff.delay());
+    bounded = bounded && backoff.isDue();
+  }
+  CHECK(bounded);
+
+  /* A short connection continues the series, a stable one ends it */
+  backoff.succeeded();
+  sClock.advance(kBackoffStableTime - 1);
+  backoff.attempted();
+  CHECK(backoff.count() == 11);
+  backoff.succeeded();
+  sClock.advance(kBackoffStableTime);
+  backoff.attempted();
+  CHECK(backoff.count() == 1);
+
+  /* Restart past the budget */
+  const uint32_t restarts = Hal::restartCount();
+  sClock.advance(kConnectionRestartBudget);
+  backoff.attempted();
+  CHECK(Hal::restartCount() == restarts);
+  sClock.advance(1);
+  backoff.attempted();
+  CHECK(Hal::restartCount() == restarts + 1);
+}
+
+/*------------------------------------------------------------------------------
+ * Reconnection storm of the heaters, with or without the backoff
+ */
+typedef struct {
+  uint32_t attemptCount;
+  uint32_t onlineTime; /* ms after the loss of the broker, all the heaters */
+  uint32_t restartCount;
+} StormResult;
+
+static StormResult storm(const bool inBackoff) {
+  static Backoff *backoff[kNodeCount];
+  bool online[kNodeCount];
+  uint32_t failures[kNodeCount];
+  const uint32_t lossDate = 2000000;
+  StormResult result = {0, 0, 0};
+
+  /* Connected for long when the broker goes down */
+  sClock.set(lossDate - kBackoffStableTime - 1000);
+  for (uint32_t node = 0; node < kNodeCount; node++) {
+    const uint8_t mac[6] = {0x24, 0x6F, 0x28, 0x1A, 0x00, (uint8_t)node};
+    delete backoff[node];
+    backoff[node] = new Backoff(kBrokerBackoffBase, kBrokerBackoffCap,
+                                kConnectionRestartBudget);
+    backoff[node]->seed(crc32(mac, sizeof(mac)) ^ 0x5A5A5A5A);
+    backoff[node]->succeeded();
+    online[node] = false;
+    failures[node] = 0;
+  }
+
+  const uint32_t restarts = Hal::restartCount();
+  for (uint32_t date = lossDate;
+       date < lossDate + kStormDuration && result.onlineTime == 0;
+       date += kUpdatePeriod) {
+    sClock.set(date);
+    const bool brokerUp = date - lossDate >= kBrokerDownTime;
+    uint32_t accepted = 0;
+    uint32_t onlineCount = 0;
+    for (uint32_t node = 0; node < kNodeCount; node++) {
+      if (!online[node] && (!inBackoff || backoff[node]->isDue())) {
+        result.attemptCount++;
+        if (brokerUp && accepted < kBrokerAcceptRate) {
+          accepted++;
+          online[node] = true;
+          failures[node] = 0;
+          backoff[node]->succeeded();
+        } else if (inBackoff) {
+          backoff[node]->attempted();
+        } else if (++failures[node] > kRetryerCountLimit) {
+          failures[node] = 0;
+          result.restartCount++;
+        }
+      }
+      onlineCount += online[node];
+    }
+    if (onlineCount == kNodeCount) {
+      result.onlineTime = date - lossDate;
+    }
+  }
+  result.restartCount += Hal::restartCount() - restarts;
+  return result;
+}
+
+int main() {
+  Hal::setClock(sClock);
+  checkRules();
+
+  const StormResult lockstep = storm(false);
+  const StormResult backoff = storm(true);
+  printf("lockstep: %u attempts, all online after %u s, %u restarts\n",
+         lockstep.attemptCount, lockstep.onlineTime / 1000, lockstep.restartCount);
+  printf("backoff: %u attempts, all online after %u s, %u restarts\n",
+         backoff.attemptCount, backoff.onlineTime / 1000, backoff.restartCount);
+  CHECK(lockstep.restartCount >= kNodeCount);
+  CHECK(backoff.onlineTime > 0);
+  CHECK(backoff.restartCount == 0);
+  CHECK(backoff.attemptCount * 4 < lockstep.attemptCount);
+  return testResult("test-backoff");
+}
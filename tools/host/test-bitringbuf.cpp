@@ -0,0 +1,75 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the BitRingBuf counts against a reference deque.
+ *
+ * The incremental count, the full recount and the windowed counts are
+ * compared after each push, before and after the buffer is full, for
+ * sizes that are and are not multiples of 32. The windows cover the ones
+ * that wrap around the end of the buffer.
+ */
+
+#include "BitRingBuf.h"
+#include "HostTest.h"
+#include <deque>
+
+template <size_t S> static void checkSize(const uint32_t inPushCount) {
+  BitRingBuf<S> buffer;
+  std::deque<uint32_t> reference;
+  uint32_t random = 12345;
+  bool ok = true;
+
+  for (uint32_t i = 0; i < inPushCount && ok; i++) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    const uint32_t bit = random % 3 == 0;
+    buffer.push(bit);
+    reference.push_back(bit);
+    if (reference.size() > S) {
+      reference.pop_front();
+    }
+
+    uint32_t total = 0;
+    for (const uint32_t b : reference) {
+      total += b;
+    }
+    ok = buffer.size() == reference.size() && buffer.onCount() == total &&
+         fabsf(buffer.loadAverage() - 100.0f * total / reference.size()) <
+             1e-3f;
+
+    /* A few windows, the last bits are at the back of the deque */
+    const uint32_t lengths[] = {1, 31, 32, 33, (uint32_t)S / 2, (uint32_t)S,
+                                (uint32_t)S + 5};
+    for (const uint32_t length : lengths) {
+      uint32_t count = 0;
+      uint32_t taken = 0;
+      for (auto b = reference.rbegin(); b != reference.rend() && taken < length;
+           ++b, ++taken) {
+        count += *b;
+      }
+      ok = ok && buffer.onCount(length) == count;
+    }
+  }
+  CHECK(ok);
+}
+
+int main() {
+  checkSize<37>(200);
+  checkSize<64>(300);
+  checkSize<600>(2000);
+  checkSize<1000>(3000);
+
+  /* Empty buffer and bit 31 */
+  BitRingBuf<64> buffer;
+  CHECK(buffer.loadAverage() == 0);
+  CHECK(buffer.loadAverage(10) == 0);
+  for (uint32_t i = 0; i < 32; i++) {
+    buffer.push(i == 31);
+  }
+  CHECK(buffer.readBit(31) == 1);
+  CHECK(buffer.onCount() == 1);
+  CHECK(buffer.onCount(1) == 1);
+  CHECK(buffer.onCount(2) == 1);
+  return testResult("test-bitringbuf");
+}
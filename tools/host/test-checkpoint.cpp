@@ -0,0 +1,164 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the checkpoint and of its effect on a restart.
+ *
+ * The first part checks the copies: nothing to restore at first, a saved
+ * state comes back from the RTC copy and a copy older than
+ * kCheckpointMaxAge is not restored.
+ *
+ * The second part heats a room (see Room.h) at kDefaultTemperature for
+ * kWarmUp, then restarts the firmware: the clock goes back to 0 and the
+ * heater is rebuilt, once without the checkpoint and once restored from
+ * it. It prints the time to steady state (SETTLE of the status) and the
+ * largest excursion of the room in the kObservation after the restart.
+ */
+
+#include "Checkpoint.h"
+#include "Config.h"
+#include "Hal.h"
+#include "Heater.h"
+#include "HostTest.h"
+#include "Logger.h"
+#include "PeriodicAction.h"
+#include "Room.h"
+
+static const uint32_t kStartEpoch = 1700006400ul;
+static const uint32_t kWarmUp = 6ul * 3600ul * 1000ul;
+static const uint32_t kObservation = 3ul * 3600ul * 1000ul;
+static const float kOutside = 5.0;
+
+static VirtualClock sClock;
+static Heater *sHeater = NULL;
+static Room *sRoom = NULL;
+
+PeriodicAction heaterCommandAction(1000, kHeatingPeriod / kTemperatureMeasurementSlots);
+PeriodicAction heaterControlAction(1000, kHeatingSlotDuration, PeriodicAction::SKIP_ALIGNED);
+PeriodicAction checkpointAction(kCheckpointPeriod, kCheckpointPeriod);
+
+static void commandHeater() {
+  sHeater->setRoomTemperature(sRoom->temperature());
+  sHeater->setSetpoint(kDefaultTemperature);
+  sHeater->setAuto();
+}
+
+static void controlHeater() { sHeater->loop(); }
+
+static void heaterSlotTick() { sHeater->slotTick(); }
+
+static void fillCheckpoint(Checkpoint::Data &outData) {
+  sHeater->save(outData.heater);
+  outData.setpointTemperature = sHeater->setpoint();
+  outData.setpointOffset = 0;
+  outData.functioningMode = sHeater->state();
+}
+
+static void saveCheckpoint() {
+  Checkpoint::Data data;
+  fillCheckpoint(data);
+  Checkpoint::save(data);
+}
+
+/*------------------------------------------------------------------------------
+ * Boot at inEpoch with a new heater, restored from the checkpoint or not
+ */
+static void boot(const uint32_t inEpoch, const bool inRestore) {
+  delete sHeater;
+  sClock.set(0);
+  Hal::setEpoch(inEpoch);
+  sHeater = new Heater(pinAddr, pinStop, pinAntifreeze);
+  sHeater->begin(kDefaultTemperature);
+  Checkpoint::Data data;
+  if (inRestore && Checkpoint::restore(data)) {
+    sHeater->restore(data.heater);
+  }
+  TimeObject::setup();
+}
+
+/*------------------------------------------------------------------------------
+ * Runs inDuration ms, returns the largest excursion of the room from the
+ * setpoint
+ */
+static float run(const uint32_t inDuration) {
+  float excursion = 0;
+  const uint32_t end = sClock.millis() + inDuration;
+  while (sClock.millis() < end) {
+    TimeObject::loop();
+    Logger::drain();
+    const float error = fabsf(sRoom->temperature() - kDefaultTemperature);
+    if (error > excursion) {
+      excursion = error;
+    }
+    const uint32_t next = TimeObject::nextDeadline();
+    const uint32_t delay = (int32_t)(next - sClock.millis()) > 0
+                               ? next - sClock.millis()
+                               : 0;
+    sRoom->advance(delay, kOutside);
+    sClock.set(sClock.millis() + delay);
+  }
+  return excursion;
+}
+
+/*------------------------------------------------------------------------------
+ * Warm up then restart, returns SETTLE and the excursion after the restart
+ */
+static void restartScenario(const bool inRestore, uint32_t &outSettle,
+                            float &outExcursion) {
+  delete sRoom;
+  sRoom = new Room(kDefaultTemperature - 2.0);
+  boot(kStartEpoch, false);
+  run(kWarmUp);
+  boot(kStartEpoch + kWarmUp / 1000, inRestore);
+  outExcursion = run(kObservation);
+  outSettle = sHeater->settleTime();
+}
+
+int main() {
+  Hal::setClock(sClock);
+  Logger::setLevels("all=warning");
+  heaterCommandAction.begin(commandHeater);
+  heaterControlAction.begin(controlHeater);
+  checkpointAction.begin(saveCheckpoint);
+  Hal::startTimer(kHeatingSlotDuration, heaterSlotTick);
+
+  /* Copies */
+  Hal::setEpoch(kStartEpoch);
+  Checkpoint::Data data;
+  CHECK(!Checkpoint::restore(data));
+  CHECK(Checkpoint::source() == Checkpoint::NONE);
+
+  sHeater = new Heater(pinAddr, pinStop, pinAntifreeze);
+  sHeater->begin(kDefaultTemperature);
+  sHeater->setSetpoint(20.5);
+  sHeater->setAuto();
+  sHeater->setRoomTemperature(18.25);
+  Checkpoint::Data saved;
+  fillCheckpoint(saved);
+  Checkpoint::save(saved);
+  CHECK(Checkpoint::restore(data));
+  CHECK(Checkpoint::source() == Checkpoint::RTC);
+  CHECK(data.setpointTemperature == 20.5f);
+  CHECK(data.functioningMode == Heater::AUTO);
+  CHECK(data.heater.temperatureHistory.count == 1);
+  CHECK(data.heater.temperatureHistory.temperatures[0] == 18.25f);
+
+  Hal::setEpoch(kStartEpoch + kCheckpointMaxAge + 10);
+  CHECK(!Checkpoint::restore(data));
+  CHECK(Checkpoint::source() == Checkpoint::NONE);
+
+  /* Restart */
+  uint32_t coldSettle;
+  float coldExcursion;
+  restartScenario(false, coldSettle, coldExcursion);
+  uint32_t warmSettle;
+  float warmExcursion;
+  restartScenario(true, warmSettle, warmExcursion);
+  printf("restart without checkpoint: SETTLE=%u s, excursion %.3f °C\n",
+         coldSettle, coldExcursion);
+  printf("restart with checkpoint: SETTLE=%u s, excursion %.3f °C\n",
+         warmSettle, warmExcursion);
+  CHECK(Checkpoint::source() == Checkpoint::RTC);
+  CHECK(warmSettle > 0 && warmSettle < coldSettle);
+  CHECK(warmExcursion < coldExcursion);
+  return testResult("test-checkpoint");
+}
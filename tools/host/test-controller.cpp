@@ -0,0 +1,149 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the fixed point controller on traces of a heated room.
+ *
+ * The traces are 20 runs of a week, one PWM cycle of 30 s per step, on a
+ * room model: heating, losses to an outside that varies over the day,
+ * DHT22 readings quantised to 0.1 °C with noise, averaged over the 5
+ * readings of a cycle, and a setpoint changing every 8 h. The room is
+ * computed in integers and driven by the Controller itself, so that the
+ * traces and the outputs are the same bits whatever the compiler and its
+ * options.
+ *
+ * On each cycle, the mean and the setpoint are given to the Controller, to
+ * the same law in floats and to the former float law (see
+ * FloatController.h). The Controller must give the same duty as the float
+ * law but for rounding, at most one slot apart. The former law is only
+ * reported, its integral winds up during the climbs. A hash of the
+ * outputs and of the state of the Controller is compared with the one
+ * computed on the host with -O2: it must be the same with any other
+ * options, e.g. make clean && CXXFLAGS=-O0 make check, or this test alone
+ * built with -O3 -ffast-math or -mfpmath=387.
+ */
+
+#include "Config.h"
+#include "FloatController.h"
+#include "Heater.h"
+#include "HostTest.h"
+
+static const uint32_t kRunCount = 20;
+static const uint32_t kCyclesPerDay = 24ul * 3600ul * 1000ul / kHeatingPeriod;
+static const uint32_t kCyclesPerRun = 7 * kCyclesPerDay;
+static const uint32_t kSetpointPeriod = kCyclesPerDay / 3; /* 8 h */
+static const uint64_t kReferenceHash = 0xbd27af8c61f5e7aeull;
+
+/* Temperatures of the room model in µ°C */
+static const int32_t kHeatPerSlot = 2200;     /* 0.0022 °C per slot on */
+static const int32_t kLossPerMille = 3;       /* per cycle, of room - outside */
+static const int32_t kOutsideMean = 5000000;
+static const int32_t kOutsideSwing = 4000000;
+static const int32_t kReadingStep = 100000;   /* DHT22, 0.1 °C */
+static const int32_t kNoiseStep = 50000;
+
+static uint32_t sRandom = 1;
+
+static uint32_t nextRandom() {
+  sRandom ^= sRandom << 13;
+  sRandom ^= sRandom >> 17;
+  sRandom ^= sRandom << 5;
+  return sRandom;
+}
+
+/* Coldest at the start of the day, warmest at noon */
+static int32_t outsideAt(const uint32_t inCycle) {
+  const int32_t phase = inCycle % kCyclesPerDay;
+  const int32_t half = kCyclesPerDay / 2;
+  const int32_t distance = phase > half ? phase - half : half - phase;
+  return kOutsideMean + kOutsideSwing -
+         2 * kOutsideSwing / half * (half - distance);
+}
+
+/* Setpoint in halves of °C */
+static int32_t setpointAt(const uint32_t inRun, const uint32_t inCycle) {
+  if (inCycle < kSetpointPeriod) {
+    return 40;
+  }
+  return ((inCycle / kSetpointPeriod) % 2 ? 34 : 40) + inRun % 3;
+}
+
+/* Mean of the 5 readings of a cycle */
+static Fixed meanReading(const int32_t inRoom) {
+  int64_t tenths = 0;
+  for (uint32_t i = 0; i < kTemperatureMeasurementSlots; i++) {
+    const int32_t noise = ((int32_t)(nextRandom() % 7) - 3) * kNoiseStep;
+    tenths += (inRoom + noise + kReadingStep / 2) / kReadingStep;
+  }
+  const int64_t count = 10 * kTemperatureMeasurementSlots;
+  return (Fixed)((tenths * kFixedOne + count / 2) / count);
+}
+
+static uint64_t hash(const uint64_t inHash, const uint32_t inValue) {
+  return (inHash ^ inValue) * 1099511628211ull;
+}
+
+int main() {
+  uint32_t cycleCount = 0;
+  uint32_t sameAsFloat = 0;
+  uint32_t maxFloatDifference = 0;
+  uint32_t sameAsOld = 0;
+  uint32_t maxOldDifference = 0;
+  float maxIntegralDifference = 0;
+  uint64_t outputHash = 1469598103934665603ull;
+
+  for (uint32_t run = 1; run <= kRunCount; run++) {
+    HeaterController controller(toFixed(kDefaultTemperature));
+    FloatController floatController;
+    OldFloatController oldController;
+    sRandom = run * 2654435761u;
+    int32_t room = (12 + run % 5) * 1000000;
+
+    for (uint32_t cycle = 0; cycle < kCyclesPerRun; cycle++) {
+      const Fixed setpoint = setpointAt(run, cycle) * (kFixedOne / 2);
+      const Fixed mean = meanReading(room);
+      const uint32_t pwm = controller.update(setpoint, mean);
+      const uint32_t floatPWM =
+          floatController.update(fromFixed(setpoint), fromFixed(mean));
+      const uint32_t oldPWM =
+          oldController.update(fromFixed(setpoint), fromFixed(mean));
+
+      cycleCount++;
+      sameAsFloat += pwm == floatPWM;
+      const uint32_t floatDifference =
+          pwm > floatPWM ? pwm - floatPWM : floatPWM - pwm;
+      if (floatDifference > maxFloatDifference) {
+        maxFloatDifference = floatDifference;
+      }
+      sameAsOld += pwm == oldPWM;
+      const uint32_t oldDifference =
+          pwm > oldPWM ? pwm - oldPWM : oldPWM - pwm;
+      if (oldDifference > maxOldDifference) {
+        maxOldDifference = oldDifference;
+      }
+      const float integralDifference =
+          fabsf(fromFixed(controller.integral()) - floatController.integral());
+      if (integralDifference > maxIntegralDifference) {
+        maxIntegralDifference = integralDifference;
+      }
+      outputHash = hash(outputHash, pwm);
+      outputHash = hash(outputHash, (uint32_t)controller.integral());
+      outputHash = hash(outputHash, (uint32_t)controller.duty());
+
+      room += (int32_t)pwm * kHeatPerSlot -
+              (room - outsideAt(cycle)) / 1000 * kLossPerMille;
+    }
+  }
+
+  printf("%u cycles\n", cycleCount);
+  printf("same law in floats: %.2f %% identical, at most %u slot apart, "
+         "integral within %.5f\n",
+         100.0 * sameAsFloat / cycleCount, maxFloatDifference,
+         maxIntegralDifference);
+  printf("former float law: %.2f %% identical, at most %u slots apart\n",
+         100.0 * sameAsOld / cycleCount, maxOldDifference);
+  printf("hash %016llx\n", (unsigned long long)outputHash);
+  CHECK(maxFloatDifference <= 1);
+  CHECK(sameAsFloat >= cycleCount / 100 * 98);
+  CHECK(outputHash == kReferenceHash);
+  return testResult("test-controller");
+}
@@ -0,0 +1,118 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of DHT22Decoder on pulse trains.
+ *
+ * The trains are the durations (in µs) of the high pulses in the order the
+ * RMT gives them: the release of the line by the ESP32, the 80µs response
+ * of the sensor and the 40 bits, with the jitter of a real line (±3µs).
+ * They carry the two frames given as examples by the AM2302 datasheet:
+ * 65.2 %, 35.1 °C and a negative temperature, 50.0 %, -10.1 °C.
+ */
+
+#include "DHT22Decoder.h"
+#include "DHTReader.h"
+#include "Hal.h"
+#include "HostTest.h"
+#include <string.h>
+
+/* 0x02 0x8C 0x01 0x5F 0xEE */
+static const uint16_t kPositiveTrain[] = {
+    22, 79, 23, 27, 26, 24, 28, 23, 73, 28, 70, 29, 23, 24, 70, 68, 25, 27,
+    24, 27, 28, 28, 26, 28, 23, 72, 23, 72, 25, 70, 71, 69, 69, 68, 72, 72,
+    73, 29, 72, 68, 73, 25};
+
+/* 0x01 0xF4 0x80 0x65 0xDA */
+static const uint16_t kNegativeTrain[] = {
+    29, 80, 25, 24, 26, 25, 29, 29, 28, 72, 69, 70, 70, 73, 28, 69, 26, 23,
+    70, 27, 23, 26, 25, 27, 25, 27, 26, 71, 73, 24, 25, 72, 25, 71, 72, 68,
+    25, 72, 72, 27, 72, 27};
+
+static const size_t kTrainLength = sizeof(kPositiveTrain) / sizeof(uint16_t);
+
+static DHT22Decoder::Status decode(const uint16_t *inTrain,
+                                   const size_t inCount, float &outTemperature,
+                                   float &outHumidity) {
+  return DHT22Decoder::decode(inTrain, inCount, outTemperature, outHumidity);
+}
+
+/*------------------------------------------------------------------------------
+ * Runs the TimeObjects until inDate
+ */
+static void runUntil(VirtualClock &ioClock, const uint32_t inDate) {
+  while ((int32_t)(TimeObject::nextDeadline() - inDate) <= 0) {
+    ioClock.set(TimeObject::nextDeadline());
+    TimeObject::loop();
+  }
+  ioClock.set(inDate);
+}
+
+int main() {
+  float t = 0;
+  float h = 0;
+
+  /* Frames of the datasheet */
+  CHECK(decode(kPositiveTrain, kTrainLength, t, h) == DHT22Decoder::OK);
+  CHECK_NEAR(t, 35.1, 0.001);
+  CHECK_NEAR(h, 65.2, 0.001);
+  CHECK(decode(kNegativeTrain, kTrainLength, t, h) == DHT22Decoder::OK);
+  CHECK_NEAR(t, -10.1, 0.001);
+  CHECK_NEAR(h, 50.0, 0.001);
+
+  /* The bits alone, without the release and the response */
+  CHECK(decode(kPositiveTrain + 2, kTrainLength - 2, t, h) ==
+        DHT22Decoder::OK);
+  CHECK_NEAR(t, 35.1, 0.001);
+
+  /* A bit read wrong, the checksum catches it */
+  uint16_t train[kTrainLength];
+  memcpy(train, kPositiveTrain, sizeof(train));
+  train[2 + 20] = 70;
+  CHECK(decode(train, kTrainLength, t, h) == DHT22Decoder::CHECKSUM_ERROR);
+
+  /* A bit missing */
+  CHECK(decode(kPositiveTrain + 3, DHT22Decoder::kBitCount - 1, t, h) ==
+        DHT22Decoder::FORMAT_ERROR);
+
+  /* A line stuck high during a bit */
+  memcpy(train, kNegativeTrain, sizeof(train));
+  train[2 + 30] = 150;
+  CHECK(decode(train, kTrainLength, t, h) == DHT22Decoder::FORMAT_ERROR);
+
+  /* The values are not changed by a failed decoding */
+  t = 1.0;
+  h = 2.0;
+  CHECK(decode(train, kTrainLength, t, h) != DHT22Decoder::OK);
+  CHECK(t == 1.0 && h == 2.0);
+
+  /* Threshold between 0 and 1 */
+  memcpy(train, kPositiveTrain, sizeof(train));
+  for (size_t i = 2; i < kTrainLength; i++) {
+    train[i] = train[i] > DHT22Decoder::kOneThreshold
+                   ? DHT22Decoder::kOneThreshold + 1
+                   : DHT22Decoder::kOneThreshold;
+  }
+  CHECK(decode(train, kTrainLength, t, h) == DHT22Decoder::OK);
+  CHECK_NEAR(h, 65.2, 0.001);
+
+  /* Heat index, below 79 °F the simple formula applies */
+  CHECK_NEAR(DHT22Decoder::heatIndex(20.0, 50.0), 19.36, 0.01);
+  CHECK(DHT22Decoder::heatIndex(32.0, 70.0) > 32.0);
+
+  /* The reader on the host gives the simulated values, NAN is a failure */
+  VirtualClock clock;
+  Hal::setClock(clock);
+  DHTReader reader(4, 1000, 6000);
+  reader.begin();
+  reader.simulate(21.5, 40.0);
+  TimeObject::setup();
+  CHECK(!reader.sample(t, h));
+  runUntil(clock, 1000);
+  CHECK(reader.sample(t, h));
+  CHECK(t == 21.5f && h == 40.0f);
+  reader.simulate(NAN, 40.0);
+  runUntil(clock, 7000);
+  CHECK(!reader.sample(t, h));
+  CHECK(reader.readCount() == 2);
+  return testResult("test-dht22decoder");
+}
@@ -0,0 +1,94 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the recompute of the duty on a setpoint change.
+ *
+ * The heater runs in AUTO with the slots ticked by hand, the room at the
+ * setpoint so that the duty is half of the cycle. At slot 15, the setpoint
+ * is raised by 2 °C as a command received on heater<num>/setpoint would do.
+ * The duty of the current cycle is recomputed at once: the slots already
+ * elapsed are kept and the pilot wire is in comfort from the next slot. A
+ * change smaller than kSetpointRecomputeStep, or out of AUTO, waits for the
+ * next cycle.
+ */
+
+#include "Config.h"
+#include "Hal.h"
+#include "Heater.h"
+#include "HostTest.h"
+#include "Logger.h"
+#include "Room.h"
+
+static const uint32_t kStepSlot = 15;
+
+static VirtualClock sClock;
+
+/* Ticks one slot, returns true if the pilot wire is in comfort */
+static bool tick(Heater &ioHeater) {
+  sClock.advance(kHeatingSlotDuration);
+  ioHeater.slotTick();
+  ioHeater.loop();
+  return Room::isHeating();
+}
+
+/* Ticks up to the start of the next cycle */
+static void endCycle(Heater &ioHeater) {
+  while (ioHeater.pwmCounter() != 0) {
+    tick(ioHeater);
+  }
+}
+
+int main() {
+  Hal::setClock(sClock);
+  Logger::setLevels("all=warning");
+  sClock.set(1000);
+
+  Heater heater(pinAddr, pinStop, pinAntifreeze);
+  heater.begin(kDefaultTemperature);
+  heater.setSetpoint(19.0);
+  heater.setRoomTemperature(19.0);
+  heater.setAuto();
+  tick(heater);
+  endCycle(heater);
+
+  /* A cycle with the setpoint step at slot 15 */
+  const uint32_t before = heater.actualPWM();
+  uint32_t onSlots = 0;
+  bool comfortAfterStep = true;
+  for (uint32_t slot = 0; slot < kHeatingSlots; slot++) {
+    if (slot == kStepSlot) {
+      heater.setSetpoint(21.0);
+    }
+    const bool on = tick(heater);
+    onSlots += on;
+    if (slot >= kStepSlot) {
+      comfortAfterStep = comfortAfterStep && on;
+    }
+  }
+  printf("setpoint +2 °C at slot %u: duty %u -> %u slots, %u slots on in the "
+         "cycle\n",
+         kStepSlot, before, heater.actualPWM(), onSlots);
+  CHECK(before == kHeatingSlots / 2);
+  CHECK(heater.actualPWM() == kHeatingSlots);
+  CHECK(heater.recomputeCount() == 1);
+  CHECK(comfortAfterStep);
+  CHECK(onSlots == before + kHeatingSlots - kStepSlot);
+
+  /* A small change waits for the end of the cycle */
+  endCycle(heater);
+  const uint32_t duty = heater.actualPWM();
+  for (uint32_t slot = 0; slot < kStepSlot; slot++) {
+    tick(heater);
+  }
+  heater.setSetpoint(21.0 + kSetpointRecomputeStep / 2);
+  CHECK(heater.actualPWM() == duty);
+  CHECK(heater.recomputeCount() == 1);
+
+  /* Out of AUTO, the setpoint is only stored */
+  heater.setEco();
+  heater.setSetpoint(17.0);
+  CHECK(heater.recomputeCount() == 1);
+  CHECK(heater.setpoint() == 17.0f);
+  CHECK(!tick(heater));
+  return testResult("test-heater");
+}
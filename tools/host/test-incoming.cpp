@@ -0,0 +1,106 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the size check of the incoming messages.
+ *
+ * The PUBLISH packets are built as the broker sends them and read as
+ * PubSubClient::readPacket() does: a packet larger than the buffer of the
+ * client is dropped before the callback. The others are given to an
+ * IncomingFilter, as Connection::callback() does. A payload one byte too
+ * large for a slot, with the longest topic, must reach the filter and be
+ * counted with kMQTTBufferSize. With a buffer as large as a slot, as before,
+ * it was dropped by the client and the counter stayed at 0.
+ */
+
+#include "Config.h"
+#include "HostTest.h"
+#include "IncomingFilter.h"
+#include <string.h>
+
+static const size_t kMaxPacketSize = 4 * kMaxIncomingPayloadSize;
+
+static uint8_t sPacket[kMaxPacketSize];
+static uint32_t sCallbackCount = 0;
+
+/*------------------------------------------------------------------------------
+ * QoS 0 PUBLISH packet, returns its size
+ */
+static size_t buildPacket(const size_t inTopicLength,
+                          const size_t inPayloadLength) {
+  const size_t remaining = 2 + inTopicLength + inPayloadLength;
+  size_t size = 0;
+  sPacket[size++] = 0x30;
+  sPacket[size++] = 0x80 | (remaining & 0x7f);
+  sPacket[size++] = remaining >> 7;
+  sPacket[size++] = inTopicLength >> 8;
+  sPacket[size++] = inTopicLength & 0xff;
+  memset(sPacket + size, 't', inTopicLength);
+  size += inTopicLength;
+  memset(sPacket + size, 'p', inPayloadLength);
+  return size + inPayloadLength;
+}
+
+/*------------------------------------------------------------------------------
+ * Reads the packet in a buffer of inBufferSize bytes, as the MQTT client
+ * does, and gives the topic and payload lengths to ioFilter.
+ */
+static void receive(const size_t inSize, const size_t inBufferSize,
+                    IncomingFilter &ioFilter) {
+  size_t lengthLength = 0;
+  size_t remaining = 0;
+  uint32_t multiplier = 1;
+  uint8_t digit;
+  do {
+    digit = sPacket[1 + lengthLength++];
+    remaining += (digit & 127) * multiplier;
+    multiplier <<= 7;
+  } while ((digit & 128) != 0);
+  if (1 + lengthLength + remaining > inBufferSize) {
+    return;
+  }
+  const size_t topicLength =
+      (sPacket[1 + lengthLength] << 8) + sPacket[2 + lengthLength];
+  sCallbackCount++;
+  ioFilter.accept(topicLength, inSize - 3 - lengthLength - topicLength);
+}
+
+int main() {
+  const size_t longestTopic = kMaxTopicSize - 1;
+  IncomingFilter filter;
+
+  /* Messages that fit */
+  receive(buildPacket(20, 100), kMQTTBufferSize, filter);
+  receive(buildPacket(longestTopic, kMaxIncomingPayloadSize), kMQTTBufferSize,
+          filter);
+  CHECK(sCallbackCount == 2);
+  CHECK(filter.oversizedCount() == 0);
+  CHECK(IncomingFilter::packetSize(longestTopic, kMaxIncomingPayloadSize) ==
+        buildPacket(longestTopic, kMaxIncomingPayloadSize));
+
+  /* One byte too many, with a buffer as large as a slot */
+  IncomingFilter formerFilter;
+  receive(buildPacket(longestTopic, kMaxIncomingPayloadSize + 1),
+          kMaxIncomingPayloadSize, formerFilter);
+  CHECK(formerFilter.oversizedCount() == 0);
+
+  /* Counted now */
+  receive(buildPacket(longestTopic, kMaxIncomingPayloadSize + 1),
+          kMQTTBufferSize, filter);
+  CHECK(filter.oversizedCount() == 1);
+  receive(buildPacket(10, kMQTTBufferSize - 5 - 10), kMQTTBufferSize, filter);
+  CHECK(filter.oversizedCount() == 2);
+
+  /* A topic too long for a slot */
+  receive(buildPacket(kMaxTopicSize, 10), kMQTTBufferSize, filter);
+  CHECK(filter.oversizedCount() == 3);
+
+  /* Beyond the buffer, dropped by the client */
+  const uint32_t callbackCount = sCallbackCount;
+  receive(buildPacket(10, kMQTTBufferSize), kMQTTBufferSize, filter);
+  CHECK(sCallbackCount == callbackCount);
+  CHECK(filter.oversizedCount() == 3);
+  printf("payloads from %u to %u bytes counted\n",
+         (unsigned)kMaxIncomingPayloadSize + 1,
+         (unsigned)(kMQTTBufferSize - IncomingFilter::packetSize(0, 0)));
+  return testResult("test-incoming");
+}
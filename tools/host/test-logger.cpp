@@ -0,0 +1,118 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the asynchronous logger.
+ *
+ * The lines are drained with the standard output redirected to a temporary
+ * file, so that the text written to Serial is checked. The test covers the
+ * formatting of the items, the copy of a string that is not a literal, the
+ * levels, the lines forwarded on MQTT and the drops: 200 lines logged
+ * without draining overflow the kLogBufferSize channel, the lines kept are
+ * written in order and the others are counted.
+ */
+
+#include "Debug.h"
+#include "Hal.h"
+#include "HostTest.h"
+#include <string.h>
+#include <unistd.h>
+
+static const uint8_t kLogModule = Logger::HEATER;
+static const uint32_t kFloodCount = 200;
+
+static VirtualClock sClock;
+static char sOutput[32768];
+
+/*------------------------------------------------------------------------------
+ * Drains the logger, the text written is in sOutput
+ */
+static size_t drainOutput() {
+  fflush(stdout);
+  FILE *capture = tmpfile();
+  const int savedOutput = dup(fileno(stdout));
+  dup2(fileno(capture), fileno(stdout));
+  while (Logger::isPending()) {
+    Logger::drain();
+  }
+  fflush(stdout);
+  dup2(savedOutput, fileno(stdout));
+  close(savedOutput);
+  rewind(capture);
+  const size_t length = fread(sOutput, 1, sizeof(sOutput) - 1, capture);
+  sOutput[length] = '\0';
+  fclose(capture);
+  return length;
+}
+
+int main() {
+  Hal::setClock(sClock);
+  sClock.set(3723456);
+
+  /* Items, and a buffer changed before the drain */
+  char text[16];
+  strcpy(text, "copie");
+  LOGI;
+  DEBUG_P("PWM=");
+  DEBUG_P(12);
+  DEBUG_P(' ');
+  DEBUG_P(-3L);
+  DEBUG_P(" f=");
+  DEBUG_P(19.456f);
+  DEBUG_P(" ");
+  DEBUG_PLN(text);
+  strcpy(text, "modifie");
+  LOGT;
+  DEBUG_PLN("filtre");
+  LOGE;
+  DEBUG_PLN(4000000000ul);
+  drainOutput();
+  CHECK(strcmp(sOutput, "01:02:03.456 I heater : PWM=12 -3 f=19.46 copie\r\n"
+                        "01:02:03.456 E heater : 4000000000\r\n") == 0);
+  CHECK(Logger::recordCount() == 2);
+
+  /* Levels and forward */
+  CHECK(!Logger::setLevels("heater=debug,foo=info"));
+  CHECK(Logger::setLevels("heater=debug,mqtt=warning"));
+  LOGT;
+  DEBUG_PLN("debug");
+  LOGW;
+  DEBUG_PLN("transmis");
+  drainOutput();
+  CHECK(strcmp(sOutput, "01:02:03.456 D heater : debug\r\n"
+                        "01:02:03.456 W heater : transmis\r\n") == 0);
+  const char *forwarded = "01:02:03.456 W heater : transmis\n";
+  CHECK(Logger::forwardLength() == strlen(forwarded));
+  CHECK(strncmp(Logger::forwardBuffer(), forwarded, strlen(forwarded)) == 0);
+  Logger::clearForward();
+
+  /* A flood without draining */
+  CHECK(Logger::setLevels("all=info,mqtt=none"));
+  const uint32_t records = Logger::recordCount();
+  const uint32_t dropped = Logger::droppedCount();
+  for (uint32_t i = 0; i < kFloodCount; i++) {
+    LOGI;
+    DEBUG_P("ligne ");
+    DEBUG_PLN(i);
+  }
+  const uint32_t kept = Logger::recordCount() - records;
+  const uint32_t lost = Logger::droppedCount() - dropped;
+  drainOutput();
+  uint32_t lineCount = 0;
+  bool inOrder = true;
+  for (const char *line = sOutput; *line != '\0';
+       line = strchr(line, '\n') + 1) {
+    char expected[32];
+    snprintf(expected, sizeof(expected), "ligne %u\r\n", lineCount);
+    const char *message = strstr(line, ": ") + 2;
+    inOrder = inOrder && strncmp(message, expected, strlen(expected)) == 0;
+    lineCount++;
+  }
+  printf("%u lines without draining: %u kept, %u dropped\n", kFloodCount, kept,
+         lost);
+  CHECK(lost > 0);
+  CHECK(kept + lost <= kFloodCount);
+  CHECK(lineCount == kept);
+  CHECK(inOrder);
+  CHECK(!Logger::isPending());
+  return testResult("test-logger");
+}
@@ -0,0 +1,79 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the queue of the statuses sampled while offline.
+ *
+ * The connection is down from the boot, before SNTP answered, and a status
+ * is queued every kOfflineSamplePeriod for 200 min, more than the queue
+ * holds. The time is then known and the statuses are replayed one every
+ * kReplayPeriod, as replayStatus() does, with one publish out of 7 failing.
+ * It prints the drop count, the replay count and the drain time, and checks
+ * that the replayed statuses are the most recent ones, in order, with the
+ * date at which they were sampled.
+ */
+
+#include "Config.h"
+#include "Hal.h"
+#include "HostTest.h"
+#include "OfflineQueue.h"
+
+static const uint32_t kSampleCount = 200;
+static const uint32_t kFirstSampleDate = 12000; /* ms of uptime */
+static const uint32_t kEpochAtBoot = 1700006400ul;
+
+static VirtualClock sClock;
+
+int main() {
+  Hal::setClock(sClock);
+  static OfflineQueue queue;
+  Telemetry::TimedStatus replayed;
+  CHECK(!queue.front(replayed));
+
+  sClock.set(kFirstSampleDate);
+  for (uint32_t i = 0; i < kSampleCount; i++) {
+    Telemetry::Status status = {};
+    status.commandSequence = i;
+    queue.push(status);
+    sClock.advance(kOfflineSamplePeriod);
+  }
+  CHECK(queue.depth() == kOfflineQueueSize);
+  CHECK(queue.maxDepth() == kOfflineQueueSize);
+  CHECK(queue.droppedCount() == kSampleCount - kOfflineQueueSize);
+
+  /* SNTP answers once online */
+  Hal::setEpoch(kEpochAtBoot + sClock.millis() / 1000);
+  uint32_t expected = kSampleCount - kOfflineQueueSize;
+  uint32_t attempts = 0;
+  bool inOrder = true;
+  bool dated = true;
+  while (queue.front(replayed)) {
+    inOrder = inOrder && replayed.status.commandSequence == expected;
+    dated = dated && replayed.date == kEpochAtBoot + kFirstSampleDate / 1000 +
+                                          expected * kOfflineSamplePeriod / 1000;
+    if (++attempts % 7 != 0) {
+      queue.pop();
+      expected++;
+    }
+    if (queue.depth() > 0) {
+      sClock.advance(kReplayPeriod);
+    }
+  }
+  printf("%u statuses queued, %u dropped, %u replayed in %u attempts, "
+         "drain %.1f s\n",
+         kSampleCount, queue.droppedCount(), queue.replayedCount(), attempts,
+         queue.lastDrainTime() / 1000.0);
+  CHECK(inOrder);
+  CHECK(dated);
+  CHECK(expected == kSampleCount);
+  CHECK(queue.replayedCount() == kOfflineQueueSize);
+  CHECK(queue.depth() == 0);
+  CHECK(queue.lastDrainTime() == (attempts - 1) * kReplayPeriod);
+
+  /* A sample taken once the time is known */
+  Telemetry::Status status = {};
+  queue.push(status);
+  sClock.advance(5 * kReplayPeriod);
+  CHECK(queue.front(replayed));
+  CHECK(replayed.date == Hal::epoch() - 2);
+  return testResult("test-offlinequeue");
+}
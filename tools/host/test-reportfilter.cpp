@@ -0,0 +1,116 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Test of the report by exception.
+ *
+ * The first part checks the rules of ReportFilter: first message, deadband,
+ * discrete fields, heartbeat, retry of a message that was not published and
+ * disabled filter.
+ *
+ * The second part feeds a status filter with a temperature doing a random
+ * walk of ±0.02 °C every 6 s, the period of publishData(), for a day, with
+ * the deadbands of Config.h. It prints the sent and suppressed counts and
+ * checks that no report is missed: each change of a deadband and each
+ * heartbeat is published.
+ */
+
+#include "Config.h"
+#include "Hal.h"
+#include "HostTest.h"
+#include "ReportFilter.h"
+
+static const uint32_t kPublishPeriod = kHeatingPeriod / kTemperatureMeasurementSlots;
+
+static VirtualClock sClock;
+
+static void checkRules() {
+  ReportFilter filter(kReportHeartbeat);
+  const uint8_t temperature = filter.addField(kTemperatureDeadband);
+  const uint8_t state = filter.addField(kDiscreteDeadband);
+
+  /* The first message is always due */
+  filter.set(temperature, 19.0);
+  filter.set(state, 1);
+  CHECK(filter.isDue());
+  filter.reported();
+
+  /* Below the deadband, then at the deadband */
+  sClock.advance(kPublishPeriod);
+  filter.set(temperature, 19.05);
+  CHECK(!filter.isDue());
+  filter.set(temperature, 18.85);
+  CHECK(filter.isDue());
+  filter.reported();
+
+  /* Any change of a discrete field */
+  filter.set(state, 2);
+  CHECK(filter.isDue());
+  filter.reported();
+
+  /* A message not published stays due */
+  filter.set(temperature, 19.0);
+  CHECK(filter.isDue());
+  CHECK(filter.isDue());
+  filter.reported();
+
+  /* Heartbeat */
+  sClock.advance(kReportHeartbeat - 1);
+  CHECK(!filter.isDue());
+  sClock.advance(1);
+  CHECK(filter.isDue());
+  filter.reported();
+
+  CHECK(filter.sentCount() == 5);
+  CHECK(filter.suppressedCount() == 2);
+
+  /* Disabled, every message is due */
+  filter.setEnabled(false);
+  CHECK(filter.isDue());
+}
+
+static void checkRandomWalk() {
+  ReportFilter filter(kReportHeartbeat);
+  const uint8_t temperature = filter.addField(kTemperatureDeadband);
+  const uint8_t state = filter.addField(kDiscreteDeadband);
+  const uint32_t samples = 24ul * 3600ul * 1000ul / kPublishPeriod;
+  uint32_t random = 12345;
+  float value = 19.0;
+  float reported = 0;
+  uint32_t lastReport = 0;
+  bool missed = false;
+
+  for (uint32_t i = 0; i < samples; i++) {
+    sClock.advance(kPublishPeriod);
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    value += (float)((int32_t)(random % 3) - 1) * 0.02f;
+    filter.set(temperature, value);
+    filter.set(state, 1);
+    const bool due = i == 0 ||
+                     fabsf(value - reported) >= kTemperatureDeadband ||
+                     sClock.millis() - lastReport >= kReportHeartbeat;
+    if (filter.isDue()) {
+      filter.reported();
+      reported = value;
+      lastReport = sClock.millis();
+    } else if (due) {
+      missed = true;
+    }
+  }
+  printf("random walk of a day: %u sent, %u suppressed, %.1f times fewer "
+         "messages\n",
+         filter.sentCount(), filter.suppressedCount(),
+         (float)samples / filter.sentCount());
+  CHECK(!missed);
+  CHECK(filter.sentCount() + filter.suppressedCount() == samples);
+  CHECK(filter.sentCount() >= samples * kPublishPeriod / kReportHeartbeat);
+  CHECK(filter.suppressedCount() > 4 * filter.sentCount());
+}
+
+int main() {
+  Hal::setClock(sClock);
+  checkRules();
+  checkRandomWalk();
+  return testResult("test-reportfilter");
+}
@@ -0,0 +1,131 @@
+#include "TelemetryDecoder.h"
+#include <stdio.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ * Size of the version 1 record. A shorter payload is not a status.
+ */
+static const size_t kVersion1Size = 52;
+
+/*------------------------------------------------------------------------------
+ * Before version 3, the energies in % were scaled by 10000 and saturated
+ * above 6.55 %.
+ */
+static const float kVersion2EnergyScale = 10000;
+
+static float energyScale(const Telemetry::Status &inStatus) {
+  return inStatus.version < 3 ? kVersion2EnergyScale
+                              : (float)Telemetry::kRatioScale;
+}
+
+static const char *stateName(const uint8_t inState) {
+  static const char *const kNames[] = {"stop", "auto", "anti", "eco"};
+  return inState < 4 ? kNames[inState] : "?";
+}
+
+static const char *checkpointName(const uint8_t inSource) {
+  static const char *const kNames[] = {"none", "rtc", "nvs"};
+  return inSource < 3 ? kNames[inSource] : "?";
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool TelemetryDecoder::decode(const uint8_t *inPayload, const size_t inLength,
+                              Telemetry::Status &outStatus) {
+  static_assert(sizeof(Telemetry::Status) >= kVersion1Size,
+                "Telemetry::Status shorter than version 1");
+  if (inLength < kVersion1Size || inPayload[0] == 0) {
+    return false;
+  }
+  memset(&outStatus, 0, sizeof(outStatus));
+  memcpy(&outStatus, inPayload,
+         inLength < sizeof(outStatus) ? inLength : sizeof(outStatus));
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ */
+bool TelemetryDecoder::decodeTimed(const uint8_t *inPayload,
+                                   const size_t inLength, uint32_t &outDate,
+                                   Telemetry::Status &outStatus) {
+  if (inLength < sizeof(uint32_t)) {
+    return false;
+  }
+  memcpy(&outDate, inPayload, sizeof(uint32_t));
+  return decode(inPayload + sizeof(uint32_t), inLength - sizeof(uint32_t),
+                outStatus);
+}
+
+/*------------------------------------------------------------------------------
+ */
+const char *TelemetryDecoder::csvHeader() {
+  return "heater,date,version,state,temperature,humidity,heatIndex,"
+         "shortTermEnergy,averageTermEnergy,longTermEnergy,setpoint,"
+         "ventilation,meanTemperature,derivative,integralComponent,pwm,"
+         "pwmCounter,idleRatio,maxLateness,lateSlotCount,commandedDuty,"
+         "realisedDuty,checksumErrorCount,formatErrorCount,settleTime,"
+         "checkpoint,commandSequence";
+}
+
+/*------------------------------------------------------------------------------
+ */
+int TelemetryDecoder::toCSV(const char *inHeater, const uint32_t inDate,
+                            const Telemetry::Status &inStatus,
+                            char *outBuffer, const size_t inSize) {
+  const float t = Telemetry::kTemperatureScale;
+  const float r = Telemetry::kRatioScale;
+  const float e = energyScale(inStatus);
+  return snprintf(
+      outBuffer, inSize,
+      "%s,%u,%u,%s,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%u,%.2f,%.3f,%.2f,%.2f,"
+      "%u,%.2f,%u,%u,%.2f,%.2f,%u,%u,%u,%s,%u",
+      inHeater, (unsigned)inDate, inStatus.version, stateName(inStatus.state),
+      inStatus.temperature / t, inStatus.humidity / r, inStatus.heatIndex / t,
+      inStatus.shortTermEnergy / e, inStatus.averageTermEnergy / e,
+      inStatus.longTermEnergy / e, inStatus.setpoint / t,
+      inStatus.ventilation, inStatus.meanTemperature / t,
+      inStatus.derivative / (float)Telemetry::kDerivativeScale,
+      inStatus.integralComponent / t, inStatus.pwm / r, inStatus.pwmCounter,
+      inStatus.idleRatio / r, inStatus.maxLateness,
+      (unsigned)inStatus.lateSlotCount, inStatus.commandedDuty / r,
+      inStatus.realisedDuty / r, (unsigned)inStatus.checksumErrorCount,
+      (unsigned)inStatus.formatErrorCount, (unsigned)inStatus.settleTime,
+      checkpointName(inStatus.checkpoint),
+      (unsigned)inStatus.commandSequence);
+}
+
+/*------------------------------------------------------------------------------
+ */
+int TelemetryDecoder::toJSON(const char *inHeater, const uint32_t inDate,
+                             const Telemetry::Status &inStatus,
+                             char *outBuffer, const size_t inSize) {
+  const float t = Telemetry::kTemperatureScale;
+  const float r = Telemetry::kRatioScale;
+  const float e = energyScale(inStatus);
+  return snprintf(
+      outBuffer, inSize,
+      "{\"heater\":\"%s\",\"date\":%u,\"version\":%u,\"state\":\"%s\","
+      "\"temperature\":%.2f,\"humidity\":%.2f,\"heatIndex\":%.2f,"
+      "\"shortTermEnergy\":%.2f,\"averageTermEnergy\":%.2f,"
+      "\"longTermEnergy\":%.2f,\"setpoint\":%.2f,\"ventilation\":%u,"
+      "\"meanTemperature\":%.2f,\"derivative\":%.3f,"
+      "\"integralComponent\":%.2f,\"pwm\":%.2f,\"pwmCounter\":%u,"
+      "\"idleRatio\":%.2f,\"maxLateness\":%u,\"lateSlotCount\":%u,"
+      "\"commandedDuty\":%.2f,\"realisedDuty\":%.2f,"
+      "\"checksumErrorCount\":%u,\"formatErrorCount\":%u,"
+      "\"settleTime\":%u,\"checkpoint\":\"%s\","
+      "\"commandSequence\":%u}",
+      inHeater, (unsigned)inDate, inStatus.version, stateName(inStatus.state),
+      inStatus.temperature / t, inStatus.humidity / r, inStatus.heatIndex / t,
+      inStatus.shortTermEnergy / e, inStatus.averageTermEnergy / e,
+      inStatus.longTermEnergy / e, inStatus.setpoint / t,
+      inStatus.ventilation, inStatus.meanTemperature / t,
+      inStatus.derivative / (float)Telemetry::kDerivativeScale,
+      inStatus.integralComponent / t, inStatus.pwm / r, inStatus.pwmCounter,
+      inStatus.idleRatio / r, inStatus.maxLateness,
+      (unsigned)inStatus.lateSlotCount, inStatus.commandedDuty / r,
+      inStatus.realisedDuty / r, (unsigned)inStatus.checksumErrorCount,
+      (unsigned)inStatus.formatErrorCount, (unsigned)inStatus.settleTime,
+      checkpointName(inStatus.checkpoint),
+      (unsigned)inStatus.commandSequence);
+}
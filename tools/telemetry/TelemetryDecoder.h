@@ -0,0 +1,35 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Host side decoder of the binary status, see Telemetry.h.
+ *
+ * decode() accepts a record of any version: the fields that the record does
+ * not have are set to 0, the fields it has beyond the ones known here are
+ * ignored. The conversions write the values in the units of the text
+ * status. The date is the one of a replayed status, 0 for a live one.
+ */
+
+#ifndef __TELEMETRYDECODER_H__
+#define __TELEMETRYDECODER_H__
+
+#include "../../Telemetry.h"
+
+class TelemetryDecoder {
+  TelemetryDecoder() {} /* prevent instanciation */
+
+public:
+  static bool decode(const uint8_t *inPayload, const size_t inLength,
+                     Telemetry::Status &outStatus);
+  /* Replayed status: the date then the status */
+  static bool decodeTimed(const uint8_t *inPayload, const size_t inLength,
+                          uint32_t &outDate, Telemetry::Status &outStatus);
+  static const char *csvHeader();
+  static int toCSV(const char *inHeater, const uint32_t inDate,
+                   const Telemetry::Status &inStatus, char *outBuffer,
+                   const size_t inSize);
+  static int toJSON(const char *inHeater, const uint32_t inDate,
+                    const Telemetry::Status &inStatus, char *outBuffer,
+                    const size_t inSize);
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*==============================================================================
+ * FirmwareRadiateur
+ *
+ * Converts the binary statuses to CSV or JSON.
+ *
+ * Reads on its standard input one status per line, as printed by
+ *
+ *   mosquitto_sub -t 'heater+/status/bin' -t 'heater+/status/replay' \
+ *                 -F '%t %x'
+ *
+ * that is the topic, a space and the payload in hexadecimal. The topic may
+ * be omitted. A topic ending with /replay carries a dated status. Writes one
+ * CSV line (with a header) or one JSON object per status. Lines that are not
+ * a status are reported on stderr.
+ *
+ * Build: g++ -O2 -o telemetry-decode telemetry-decode.cpp TelemetryDecoder.cpp
+ * Usage: telemetry-decode [--csv | --json]
+ */
+
+#include "TelemetryDecoder.h"
+#include <stdio.h>
+#include <string.h>
+
+static const size_t kMaxLine = 1024;
+
+/*------------------------------------------------------------------------------
+ * Converts the hexadecimal payload. Returns the number of bytes or -1.
+ */
+static int fromHex(const char *inHex, uint8_t *outBytes, const size_t inSize) {
+  size_t count = 0;
+  while (inHex[0] != '\0' && inHex[0] != '\n' && inHex[0] != '\r') {
+    unsigned int byte;
+    if (count == inSize || sscanf(inHex, "%2x", &byte) != 1 ||
+        inHex[1] == '\0') {
+      return -1;
+    }
+    outBytes[count++] = byte;
+    inHex += 2;
+  }
+  return count;
+}
+
+int main(int argc, char *argv[]) {
+  bool json = false;
+  if (argc > 1) {
+    if (strcmp(argv[1], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[1], "--csv") != 0) {
+      fprintf(stderr, "usage: %s [--csv | --json]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (!json) {
+    puts(TelemetryDecoder::csvHeader());
+  }
+
+  char line[kMaxLine];
+  char output[kMaxLine];
+  unsigned long lineNumber = 0;
+  while (fgets(line, sizeof(line), stdin) != NULL) {
+    lineNumber++;
+    /* heater<num>/status/bin <hex>, the heater is the first topic level */
+    char heater[64] = "";
+    const char *hex = line;
+    const char *space = strchr(line, ' ');
+    bool replay = false;
+    if (space != NULL) {
+      replay = space - line >= 7 && strncmp(space - 7, "/replay", 7) == 0;
+      size_t length = strcspn(line, "/ ");
+      if (length >= sizeof(heater)) {
+        length = sizeof(heater) - 1;
+      }
+      memcpy(heater, line, length);
+      heater[length] = '\0';
+      hex = space + 1;
+    }
+
+    uint8_t payload[kMaxLine / 2];
+    const int length = fromHex(hex, payload, sizeof(payload));
+    Telemetry::Status status;
+    uint32_t date = 0;
+    const bool ok =
+        length >= 0 &&
+        (replay ? TelemetryDecoder::decodeTimed(payload, length, date, status)
+                : TelemetryDecoder::decode(payload, length, status));
+    if (!ok) {
+      fprintf(stderr, "line %lu: not a status\n", lineNumber);
+      continue;
+    }
+    if (json) {
+      TelemetryDecoder::toJSON(heater, date, status, output, sizeof(output));
+    } else {
+      TelemetryDecoder::toCSV(heater, date, status, output, sizeof(output));
+    }
+    puts(output);
+  }
+  return 0;
+}